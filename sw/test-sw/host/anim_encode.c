@@ -0,0 +1,266 @@
+// anim_encode.c
+// Builds an RPAN animation (rphub75_anim.h) from binary PPM frames, encoded
+// the way the player sends them. The file can be flashed to a data partition
+// as it is.
+//
+//   rphub75_anim_encode [-f packed|raw|rgb565|planes] [-d depth] [-r fps]
+//                       [-k key_interval] [-l] out.rpan frame.ppm...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rphub75.h"
+#include "rphub75_anim.h"
+#include "fbcodec.h"
+#include "rgb565.h"
+#include "bitplane.h"
+
+typedef struct
+{
+    uint8_t kind;
+    uint8_t depth;
+    uint32_t duration_us;
+    uint32_t key_interval; // packed frames between key frames, 0 for the first only
+    bool loop;
+} encode_config_t;
+
+static int ppm_skip(FILE *f)
+{
+    int c = fgetc(f);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+                c = fgetc(f);
+        }
+        c = fgetc(f);
+    }
+    return c == EOF ? -1 : ungetc(c, f);
+}
+
+/* Reads a P6 file with maxval 255 into *frame, which is allocated on the
+ * first call and must keep the same size afterwards. */
+static bool ppm_read(const char *path, rpio_rgb_t **frame, unsigned *w, unsigned *h)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+    unsigned fw, fh, maxval;
+    bool ok = fgetc(f) == 'P' && fgetc(f) == '6' && ppm_skip(f) >= 0 && fscanf(f, "%u", &fw) == 1 &&
+              ppm_skip(f) >= 0 && fscanf(f, "%u", &fh) == 1 && ppm_skip(f) >= 0 &&
+              fscanf(f, "%u", &maxval) == 1 && maxval == 255 && fgetc(f) != EOF;
+    if (ok && *frame == NULL)
+    {
+        *w = fw;
+        *h = fh;
+        *frame = malloc((size_t)fw * fh * sizeof(rpio_rgb_t));
+    }
+    ok = ok && *frame != NULL && fw == *w && fh == *h &&
+         fread(*frame, sizeof(rpio_rgb_t), (size_t)fw * fh, f) == (size_t)fw * fh;
+    fclose(f);
+    if (!ok)
+        fprintf(stderr, "%s: not a %s8-bit P6 image\n", path, *frame != NULL ? "same size " : "");
+    return ok;
+}
+
+static bool write_at(FILE *f, long offset, const void *data, size_t size)
+{
+    return fseek(f, offset, SEEK_SET) == 0 && fwrite(data, 1, size, f) == size;
+}
+
+static int encode(const encode_config_t *config, const char *out, char **paths, int count)
+{
+    FILE *f = fopen(out, "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "%s: cannot create\n", out);
+        return 1;
+    }
+
+    rphub75_anim_frame_t *index = calloc((size_t)count, sizeof(*index));
+    rpio_rgb_t *frame = NULL, *prev = NULL;
+    uint8_t *payload = NULL;
+    unsigned w = 0, h = 0;
+    bitplane_layout_t layout = {0};
+    uint32_t offset = sizeof(rphub75_anim_header_t);
+    uint64_t raw_total = 0;
+    int ret = index != NULL ? 0 : 1;
+
+    for (int i = 0; i < count && ret == 0; i++)
+    {
+        if (!ppm_read(paths[i], &frame, &w, &h))
+        {
+            ret = 1;
+            break;
+        }
+        if (payload == NULL)
+        {
+            rpio_hub75_init_t init;
+            display_get_init(&init);
+            init.width = (uint16_t)w;
+            init.height = (uint16_t)h;
+            if (w > UINT16_MAX || h > UINT16_MAX ||
+                (config->kind == RPHUB75_ANIM_PLANES && bitplane_layout_init(&layout, &init, config->depth) != ESP_OK))
+            {
+                fprintf(stderr, "%ux%u frames cannot be packed into %u bit planes\n", w, h, config->depth);
+                ret = 1;
+                break;
+            }
+            prev = malloc((size_t)w * h * sizeof(rpio_rgb_t));
+            payload = malloc(FBCODEC_MAX_SIZE(w, h) + bitplane_size(&layout, layout.scan) + 4); // + padding
+            if (prev == NULL || payload == NULL)
+            {
+                ret = 1;
+                break;
+            }
+        }
+
+        rphub75_anim_frame_t *e = &index[i];
+        e->kind = config->kind;
+        e->flags = RPHUB75_ANIM_KEY;
+        e->duration_us = config->duration_us;
+        size_t pixels = (size_t)w * h;
+        switch (config->kind)
+        {
+        case RPHUB75_ANIM_RAW:
+            memcpy(payload, frame, pixels * sizeof(rpio_rgb_t));
+            e->size = (uint32_t)(pixels * sizeof(rpio_rgb_t));
+            break;
+        case RPHUB75_ANIM_RGB565:
+            rgb565_pack((uint16_t *)payload, frame, pixels);
+            e->size = (uint32_t)(pixels * sizeof(uint16_t));
+            break;
+        case RPHUB75_ANIM_PLANES:
+            bitplane_pack(&layout, payload, frame, w, 0, layout.scan);
+            e->size = (uint32_t)bitplane_size(&layout, layout.scan);
+            break;
+        default:
+        {
+            /* deltas against the previous frame, which is what the board
+             * holds in the other framebuffer */
+            bool key = i == 0 || (config->key_interval != 0 && i % config->key_interval == 0);
+            e->size = (uint32_t)fbcodec_encode(payload, FBCODEC_MAX_SIZE(w, h), frame, w,
+                                               key ? NULL : prev, w, (uint16_t)w, (uint16_t)h);
+            if (!key)
+                e->flags = 0;
+            break;
+        }
+        }
+
+        e->offset = offset;
+        uint32_t padded = (e->size + 3) & ~3u;
+        memset(payload + e->size, 0, padded - e->size);
+        if (!write_at(f, offset, payload, padded))
+        {
+            ret = 1;
+            break;
+        }
+        offset += padded;
+        raw_total += pixels * sizeof(rpio_rgb_t);
+        rpio_rgb_t *t = prev;
+        prev = frame;
+        frame = t;
+    }
+
+    if (ret == 0)
+    {
+        rphub75_anim_header_t header = {
+            .magic = RPHUB75_ANIM_MAGIC,
+            .version = RPHUB75_ANIM_VERSION,
+            .width = (uint16_t)w,
+            .height = (uint16_t)h,
+            .depth = layout.depth,
+            .flags = config->loop ? RPHUB75_ANIM_LOOP : 0,
+            .frame_count = (uint32_t)count,
+            .index_offset = offset,
+        };
+        if (!write_at(f, offset, index, (size_t)count * sizeof(*index)) || !write_at(f, 0, &header, sizeof(header)))
+            ret = 1;
+        offset += (uint32_t)(count * sizeof(*index));
+    }
+    if (fclose(f) != 0)
+        ret = 1;
+    if (ret == 0)
+        printf("%s: %d frames %ux%u, %lu bytes (%.1f%% of RGB888)\n", out, count, w, h, (unsigned long)offset,
+               raw_total ? 100.0 * offset / raw_total : 0.0);
+    else
+        fprintf(stderr, "%s: encoding failed\n", out);
+
+    free(index);
+    free(frame);
+    free(prev);
+    free(payload);
+    return ret;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: rphub75_anim_encode [-f packed|raw|rgb565|planes] [-d depth] [-r fps]\n"
+                    "                           [-k key_interval] [-l] out.rpan frame.ppm...\n");
+}
+
+int main(int argc, char **argv)
+{
+    encode_config_t config = {
+        .kind = RPHUB75_ANIM_PACKED,
+        .depth = 6,
+        .duration_us = 1000000 / 30,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "f:d:r:k:l")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f':
+            if (strcmp(optarg, "raw") == 0)
+                config.kind = RPHUB75_ANIM_RAW;
+            else if (strcmp(optarg, "rgb565") == 0)
+                config.kind = RPHUB75_ANIM_RGB565;
+            else if (strcmp(optarg, "planes") == 0)
+                config.kind = RPHUB75_ANIM_PLANES;
+            else if (strcmp(optarg, "packed") == 0)
+                config.kind = RPHUB75_ANIM_PACKED;
+            else
+            {
+                usage();
+                return 2;
+            }
+            break;
+        case 'd':
+            config.depth = (uint8_t)atoi(optarg);
+            break;
+        case 'r':
+        {
+            double fps = atof(optarg);
+            if (fps <= 0)
+            {
+                usage();
+                return 2;
+            }
+            config.duration_us = (uint32_t)(1000000.0 / fps + 0.5);
+            break;
+        }
+        case 'k':
+            config.key_interval = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            config.loop = true;
+            break;
+        default:
+            usage();
+            return 2;
+        }
+    }
+    if (argc - optind < 2)
+    {
+        usage();
+        return 2;
+    }
+    return encode(&config, argv[optind], argv + optind + 1, argc - optind - 1);
+}
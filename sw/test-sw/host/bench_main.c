@@ -0,0 +1,41 @@
+// bench_main.c
+// Runs the benchmark suite against the simulated board.
+//
+//   rphub75_bench [spi_clock_hz] [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rphub75.h"
+#include "rphub75_bench.h"
+#include "mock_device.h"
+
+int main(int argc, char **argv)
+{
+    rphub75_bench_config_t config = RPHUB75_BENCH_CONFIG_DEFAULT();
+    if (argc > 1)
+        config.spi_clock_hz = (uint32_t)strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        config.frames = (uint32_t)strtoul(argv[2], NULL, 0);
+    config.kernel_ops = 1000000;
+
+    mock_device_config_t dev_config = MOCK_DEVICE_CONFIG_DEFAULT();
+    dev_config.spi_clock_hz = config.spi_clock_hz;
+    dev_config.transaction_ns = config.transaction_ns;
+    mock_device_t *dev = mock_device_create(&dev_config);
+    if (dev == NULL)
+        return 1;
+    rphub75_transport_t transport = mock_device_transport(dev);
+    rphub75_set_transport(&transport);
+    display_init();
+
+    esp_err_t ret = rphub75_bench_run(&config);
+
+    mock_device_stats_t st;
+    mock_device_get_stats(dev, &st);
+    rphub75_set_transport(NULL);
+    mock_device_destroy(dev);
+    if (st.errors)
+        fprintf(stderr, "simulated board saw %llu malformed commands\n", (unsigned long long)st.errors);
+    return (ret != ESP_OK || st.errors) ? 1 : 0;
+}
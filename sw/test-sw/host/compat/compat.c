@@ -0,0 +1,763 @@
+// compat.c (host build)
+// POSIX implementation of the ESP-IDF / FreeRTOS subset declared in this
+// directory.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+esp_log_level_t host_log_level = ESP_LOG_WARN;
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    host_log_level = level;
+}
+
+void esp_log_buffer_hex(const char *tag, const void *buffer, size_t len)
+{
+    const uint8_t *p = buffer;
+    for (size_t off = 0; off < len; off += 16)
+    {
+        char line[16 * 3 + 1];
+        size_t n = len - off < 16 ? len - off : 16;
+        for (size_t i = 0; i < n; i++)
+            snprintf(&line[i * 3], 4, "%02x ", p[off + i]);
+        ESP_LOGI(tag, "%s", line);
+    }
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    case ESP_ERR_INVALID_VERSION:
+        return "ESP_ERR_INVALID_VERSION";
+    case ESP_ERR_NOT_FINISHED:
+        return "ESP_ERR_NOT_FINISHED";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+// Memory
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    (void)caps;
+    void *ptr = NULL;
+    if (alignment < sizeof(void *))
+        alignment = sizeof(void *);
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return NULL;
+    return ptr;
+}
+
+void *heap_caps_aligned_calloc(size_t alignment, size_t n, size_t size, uint32_t caps)
+{
+    if (size != 0 && n > SIZE_MAX / size)
+        return NULL;
+    void *ptr = heap_caps_aligned_alloc(alignment, n * size, caps);
+    if (ptr)
+        memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+void *pvPortMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void vPortFree(void *ptr)
+{
+    free(ptr);
+}
+
+// Time
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    static int64_t start = 0;
+    if (start == 0)
+        start = monotonic_us();
+    return monotonic_us() - start;
+}
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+    int64_t deadline; // esp_timer_get_time() value, -1 while stopped
+    bool quit;
+};
+
+static void *timer_thread(void *arg)
+{
+    struct esp_timer *timer = arg;
+    pthread_mutex_lock(&timer->lock);
+    while (!timer->quit)
+    {
+        if (timer->deadline < 0)
+        {
+            pthread_cond_wait(&timer->cond, &timer->lock);
+            continue;
+        }
+        int64_t remaining = timer->deadline - esp_timer_get_time();
+        if (remaining > 0)
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            int64_t ns = ts.tv_nsec + remaining * 1000;
+            ts.tv_sec += ns / 1000000000;
+            ts.tv_nsec = ns % 1000000000;
+            pthread_cond_timedwait(&timer->cond, &timer->lock, &ts);
+            continue;
+        }
+        timer->deadline = -1;
+        pthread_mutex_unlock(&timer->lock);
+        timer->callback(timer->arg);
+        pthread_mutex_lock(&timer->lock);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (args == NULL || args->callback == NULL || out == NULL)
+        return ESP_ERR_INVALID_ARG;
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL)
+        return ESP_ERR_NO_MEM;
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->deadline = -1;
+    pthread_mutex_init(&timer->lock, NULL);
+    pthread_cond_init(&timer->cond, NULL);
+    if (pthread_create(&timer->thread, NULL, timer_thread, timer) != 0)
+    {
+        free(timer);
+        return ESP_ERR_NO_MEM;
+    }
+    *out = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    pthread_mutex_lock(&timer->lock);
+    bool running = timer->deadline >= 0;
+    if (!running)
+    {
+        timer->deadline = esp_timer_get_time() + (int64_t)timeout_us;
+        pthread_cond_signal(&timer->cond);
+    }
+    pthread_mutex_unlock(&timer->lock);
+    return running ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    pthread_mutex_lock(&timer->lock);
+    bool running = timer->deadline >= 0;
+    timer->deadline = -1;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return running ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (timer == NULL)
+        return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer->lock);
+    timer->quit = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    pthread_join(timer->thread, NULL);
+    pthread_mutex_destroy(&timer->lock);
+    pthread_cond_destroy(&timer->cond);
+    free(timer);
+    return ESP_OK;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / (1000 * portTICK_PERIOD_MS));
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    uint64_t us = (uint64_t)ticks * portTICK_PERIOD_MS * 1000;
+    struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+/* Absolute CLOCK_REALTIME deadline `wait` ticks from now, for the
+ * pthread_cond_timedwait calls below. */
+static struct timespec deadline(TickType_t wait)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = (uint64_t)wait * portTICK_PERIOD_MS * 1000000;
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec += ns % 1000000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/* Waits on `cond` until `ready` returns true. Returns false on timeout. */
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *mutex, TickType_t wait,
+                       bool (*ready)(void *), void *arg)
+{
+    struct timespec ts = deadline(wait == portMAX_DELAY ? 0 : wait);
+    while (!ready(arg))
+    {
+        if (wait == 0)
+            return false;
+        if (wait == portMAX_DELAY)
+            pthread_cond_wait(cond, mutex);
+        else if (pthread_cond_timedwait(cond, mutex, &ts) == ETIMEDOUT)
+            return ready(arg);
+    }
+    return true;
+}
+
+// Critical sections
+
+static pthread_mutex_t s_critical;
+static pthread_once_t s_critical_once = PTHREAD_ONCE_INIT;
+
+static void critical_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&s_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void host_enter_critical(void)
+{
+    pthread_once(&s_critical_once, critical_init);
+    pthread_mutex_lock(&s_critical);
+}
+
+void host_exit_critical(void)
+{
+    pthread_mutex_unlock(&s_critical);
+}
+
+// Tasks
+
+struct host_task
+{
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *param;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+    bool shared; // the handle was given out and has to outlive the thread
+    struct host_task *next_exited;
+};
+
+static __thread struct host_task *s_current = NULL;
+/* Deleted tasks whose handles may still be notified */
+static pthread_mutex_t s_exited_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct host_task *s_exited = NULL;
+
+static struct host_task *task_alloc(void)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL)
+        return NULL;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    return task;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    s_current = task;
+    task->fn(task->param);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *param, UBaseType_t priority, TaskHandle_t *out, BaseType_t core)
+{
+    (void)name;
+    (void)stack_depth;
+    (void)priority;
+    (void)core;
+
+    struct host_task *task = task_alloc();
+    if (task == NULL)
+        return pdFAIL;
+    task->fn = fn;
+    task->param = param;
+    task->shared = out != NULL;
+    if (out)
+        *out = task;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0)
+    {
+        free(task);
+        if (out)
+            *out = NULL;
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+static struct host_task *current_task(void)
+{
+    if (s_current == NULL)
+    {
+        /* threads not created through xTaskCreatePinnedToCore, e.g. main() */
+        s_current = task_alloc();
+        if (s_current)
+            s_current->thread = pthread_self();
+    }
+    return s_current;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    /* Only self-deletion is supported. A handle that was given out stays
+     * valid so that late notifications do not touch freed memory; a task
+     * nobody can reach is released with its thread. */
+    if (task != NULL && task != s_current)
+        return;
+    struct host_task *self = s_current;
+    s_current = NULL;
+    if (self != NULL && self->shared)
+    {
+        pthread_mutex_lock(&s_exited_lock);
+        self->next_exited = s_exited;
+        s_exited = self;
+        pthread_mutex_unlock(&s_exited_lock);
+    }
+    else if (self != NULL)
+    {
+        pthread_mutex_destroy(&self->lock);
+        pthread_cond_destroy(&self->cond);
+        free(self);
+    }
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    struct host_task *task = current_task();
+    if (task)
+        task->shared = true;
+    return task;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+static bool notify_pending(void *arg)
+{
+    return ((struct host_task *)arg)->notify > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t wait)
+{
+    struct host_task *task = current_task();
+    pthread_mutex_lock(&task->lock);
+    uint32_t value = 0;
+    if (wait_until(&task->cond, &task->lock, wait, notify_pending, task))
+    {
+        value = task->notify;
+        task->notify = clear_on_exit ? 0 : task->notify - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+// Semaphores and mutexes
+
+struct host_sem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool mutex;       // owner-tracking recursive mutex
+    unsigned count;   // available count, or recursion depth for mutexes
+    unsigned max;
+    pthread_t owner;
+};
+
+static struct host_sem *sem_alloc(bool mutex, unsigned max, unsigned initial)
+{
+    struct host_sem *sem = calloc(1, sizeof(*sem));
+    if (sem == NULL)
+        return NULL;
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->mutex = mutex;
+    sem->max = max;
+    sem->count = initial;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return sem_alloc(true, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return sem_alloc(true, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return sem_alloc(false, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    return sem_alloc(false, max, initial);
+}
+
+static bool sem_available(void *arg)
+{
+    struct host_sem *sem = arg;
+    if (sem->mutex)
+        return sem->count == 0 || pthread_equal(sem->owner, pthread_self());
+    return sem->count > 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    pthread_mutex_lock(&sem->lock);
+    bool ok = wait_until(&sem->cond, &sem->lock, wait, sem_available, sem);
+    if (ok)
+    {
+        if (sem->mutex)
+        {
+            sem->owner = pthread_self();
+            sem->count++;
+        }
+        else
+        {
+            sem->count--;
+        }
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    BaseType_t ret = pdTRUE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->mutex)
+    {
+        if (sem->count == 0 || !pthread_equal(sem->owner, pthread_self()))
+            ret = pdFALSE;
+        else
+            sem->count--;
+    }
+    else if (sem->count < sem->max)
+    {
+        sem->count++;
+    }
+    else
+    {
+        ret = pdFALSE;
+    }
+    pthread_cond_broadcast(&sem->cond);
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    free(sem);
+}
+
+// Queues
+
+struct host_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t items[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue) + (size_t)length * item_size);
+    if (queue == NULL)
+        return NULL;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->cond, NULL);
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+static bool queue_has_space(void *arg)
+{
+    struct host_queue *queue = arg;
+    return queue->count < queue->length;
+}
+
+static bool queue_has_item(void *arg)
+{
+    return ((struct host_queue *)arg)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = wait_until(&queue->cond, &queue->lock, wait, queue_has_space, queue);
+    if (ok)
+    {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(&queue->items[(size_t)tail * queue->item_size], item, queue->item_size);
+        queue->count++;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    bool ok = wait_until(&queue->cond, &queue->lock, wait, queue_has_item, queue);
+    if (ok)
+    {
+        memcpy(item, &queue->items[(size_t)queue->head * queue->item_size], queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->cond);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->cond);
+    free(queue);
+}
+
+
+// Partitions
+
+#define HOST_PARTITIONS 8
+
+typedef struct
+{
+    esp_partition_t part;
+    char path[256];
+    void *map;     // whole file, while mapped
+    size_t map_size;
+} host_partition_t;
+
+static host_partition_t s_partitions[HOST_PARTITIONS];
+static pthread_mutex_t s_partitions_lock = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t host_partition_add(const char *label, const char *path)
+{
+    struct stat st;
+    if (label == NULL || path == NULL || strlen(label) >= sizeof(s_partitions[0].part.label) ||
+        strlen(path) >= sizeof(s_partitions[0].path))
+        return ESP_ERR_INVALID_ARG;
+    if (stat(path, &st) != 0 || st.st_size == 0 || (uint64_t)st.st_size > UINT32_MAX)
+        return ESP_ERR_NOT_FOUND;
+
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    pthread_mutex_lock(&s_partitions_lock);
+    for (int i = 0; i < HOST_PARTITIONS; i++)
+    {
+        host_partition_t *p = &s_partitions[i];
+        if (p->part.label[0] != '\0')
+            continue;
+        p->part = (esp_partition_t){
+            .type = ESP_PARTITION_TYPE_DATA,
+            .subtype = ESP_PARTITION_SUBTYPE_ANY,
+            .size = (uint32_t)st.st_size,
+            .readonly = true,
+        };
+        strcpy(p->part.label, label);
+        strcpy(p->path, path);
+        ret = ESP_OK;
+        break;
+    }
+    pthread_mutex_unlock(&s_partitions_lock);
+    return ret;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    const esp_partition_t *found = NULL;
+    pthread_mutex_lock(&s_partitions_lock);
+    for (int i = 0; i < HOST_PARTITIONS && found == NULL; i++)
+    {
+        const esp_partition_t *p = &s_partitions[i].part;
+        if (p->label[0] == '\0' || (type != ESP_PARTITION_TYPE_ANY && p->type != type) ||
+            (subtype != ESP_PARTITION_SUBTYPE_ANY && p->subtype != subtype) ||
+            (label != NULL && strcmp(p->label, label) != 0))
+            continue;
+        found = p;
+    }
+    pthread_mutex_unlock(&s_partitions_lock);
+    return found;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    if (partition == NULL || out_ptr == NULL || out_handle == NULL || offset > partition->size ||
+        size > partition->size - offset)
+        return ESP_ERR_INVALID_ARG;
+
+    host_partition_t *p = (host_partition_t *)((const uint8_t *)partition - offsetof(host_partition_t, part));
+    esp_err_t ret = ESP_OK;
+    pthread_mutex_lock(&s_partitions_lock);
+    if (p->map == NULL)
+    {
+        /* like a flash mapping, one per partition and read-only */
+        int fd = open(p->path, O_RDONLY);
+        void *map = fd >= 0 ? mmap(NULL, partition->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        if (fd >= 0)
+            close(fd);
+        if (map == MAP_FAILED)
+        {
+            ret = ESP_FAIL;
+        }
+        else
+        {
+            p->map = map;
+            p->map_size = partition->size;
+        }
+    }
+    else
+    {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_unlock(&s_partitions_lock);
+    if (ret != ESP_OK)
+        return ret;
+    *out_ptr = (const uint8_t *)p->map + offset;
+    *out_handle = (esp_partition_mmap_handle_t)(p - s_partitions);
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    if (handle >= HOST_PARTITIONS)
+        return;
+    pthread_mutex_lock(&s_partitions_lock);
+    host_partition_t *p = &s_partitions[handle];
+    if (p->map != NULL)
+        munmap(p->map, p->map_size);
+    p->map = NULL;
+    pthread_mutex_unlock(&s_partitions_lock);
+}
@@ -0,0 +1,11 @@
+// esp_attr.h (host build)
+
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define DMA_ATTR          __attribute__((aligned(4)))
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define DRAM_ATTR
+#define IRAM_ATTR
+
+#endif // HOST_ESP_ATTR_H
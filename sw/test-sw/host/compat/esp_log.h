@@ -0,0 +1,43 @@
+// esp_log.h (host build)
+// Logging to stderr. Only warnings and errors are printed unless the level is
+// raised with esp_log_level_set.
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+extern esp_log_level_t host_log_level;
+
+// The level is global on the host, `tag` is ignored.
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+
+#define HOST_LOG(level, letter, tag, format, ...)                                   \
+    do                                                                              \
+    {                                                                               \
+        if (host_log_level >= (level))                                              \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);       \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+// Hex dump at info level, 16 bytes per line
+void esp_log_buffer_hex(const char *tag, const void *buffer, size_t len);
+#define ESP_LOG_BUFFER_HEX(tag, buffer, len) esp_log_buffer_hex(tag, buffer, len)
+
+#endif // HOST_ESP_LOG_H
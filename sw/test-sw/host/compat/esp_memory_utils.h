@@ -0,0 +1,21 @@
+// esp_memory_utils.h (host build)
+// Every address can be handed to the simulated link.
+
+#ifndef HOST_ESP_MEMORY_UTILS_H
+#define HOST_ESP_MEMORY_UTILS_H
+
+#include <stdbool.h>
+
+static inline bool esp_ptr_dma_capable(const void *p)
+{
+    (void)p;
+    return true;
+}
+
+static inline bool esp_ptr_internal(const void *p)
+{
+    (void)p;
+    return true;
+}
+
+#endif // HOST_ESP_MEMORY_UTILS_H
@@ -0,0 +1,21 @@
+// esp_task_wdt.h (host build)
+// There is no task watchdog on the host; every task counts as unsubscribed.
+
+#ifndef HOST_ESP_TASK_WDT_H
+#define HOST_ESP_TASK_WDT_H
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+static inline esp_err_t esp_task_wdt_reset(void)
+{
+    return ESP_ERR_NOT_FOUND;
+}
+
+static inline esp_err_t esp_task_wdt_add(TaskHandle_t task)
+{
+    (void)task;
+    return ESP_OK;
+}
+
+#endif // HOST_ESP_TASK_WDT_H
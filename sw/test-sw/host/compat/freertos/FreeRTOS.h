@@ -0,0 +1,49 @@
+// FreeRTOS.h (host build)
+// Just enough of the FreeRTOS API for the rphub75 library, implemented on top
+// of POSIX threads in compat.c. Handles are opaque pointers.
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef struct host_task *TaskHandle_t;
+typedef struct host_sem *SemaphoreHandle_t;
+typedef struct host_queue *QueueHandle_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ  CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define portNUM_PROCESSORS  2
+#define tskNO_AFFINITY      0x7FFFFFFF
+#define configMAX_PRIORITIES 25
+
+// Critical sections map to a process-wide recursive mutex.
+typedef struct
+{
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void host_enter_critical(void);
+void host_exit_critical(void);
+#define portENTER_CRITICAL(mux) ((void)(mux), host_enter_critical())
+#define portEXIT_CRITICAL(mux)  ((void)(mux), host_exit_critical())
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *ptr);
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,9 @@
+// sdkconfig.h (host build)
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_IDF_TARGET "linux"
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,719 @@
+// mock_device.c
+// Simulated RP-HUB75 board, see mock_device.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+#include "mock_device.h"
+#include "rphub75_proto.h"
+#include "rphub75_codec.h"
+#include "fbcodec.h"
+#include "bitplane.h"
+#include "rphub75_input.h"
+#include "esp_timer.h"
+
+static const char *TAG = "MOCK_DEVICE";
+
+struct mock_device
+{
+    mock_device_config_t config;
+    mock_device_stats_t stats;
+
+    uint16_t width;
+    uint16_t height;
+    rpio_rgb_t *fb[RP_FB_COUNT];
+    uint8_t shown;
+
+    rphub75_decoder_t dec;
+    uint8_t type;       // command being executed
+    uint8_t cmd;
+    uint8_t header[RPHUB75_ARGS_MAX];
+    uint8_t *payload;
+    size_t payload_cap;
+    bool payload_ok;    // false when the payload did not fit into memory
+
+    uint8_t usb_type;
+    uint8_t usb_reports[MOCK_DEVICE_USB_QUEUE][8];
+    size_t usb_head;
+    size_t usb_count;
+    bool usb_requested; // a 0x20 request arrived, the next transaction answers it
+    uint8_t miso[RPHUB75_USB_HEADER_SIZE + 255 * 8];
+    size_t miso_len;    // packet being clocked out
+    size_t miso_pos;
+
+    rphub75_link_config_t host_link; // what the host drives
+    rphub75_link_config_t link;      // what the board receives in
+    rphub75_link_config_t committed;
+    bool link_committed;
+    int64_t revert_at_us;            // falls back to `committed` then
+    bool mode_pending;               // a mode command arrived, switch next transaction
+    rphub75_link_mode_t mode;
+    bool status_requested;           // answered in the next transaction
+    uint16_t test_seq;
+    uint16_t test_passed;
+    uint16_t test_failed;
+    uint32_t garble_pos;             // bytes since the last flipped bit
+    uint8_t received[RP_SPI_MAX_TRANSFER]; // a transaction as the board sees it
+};
+
+/* Bit errors above the mode's clock limit, one every this many bytes */
+#define MOCK_GARBLE_INTERVAL 1021
+
+static esp_err_t mock_alloc_framebuffers(mock_device_t *dev, uint16_t width, uint16_t height)
+{
+    for (int i = 0; i < RP_FB_COUNT; i++)
+    {
+        free(dev->fb[i]);
+        dev->fb[i] = calloc((size_t)width * height, sizeof(rpio_rgb_t));
+        if (dev->fb[i] == NULL)
+            return ESP_ERR_NO_MEM;
+    }
+    dev->width = width;
+    dev->height = height;
+    return ESP_OK;
+}
+
+mock_device_t *mock_device_create(const mock_device_config_t *config)
+{
+    mock_device_t *dev = calloc(1, sizeof(*dev));
+    if (dev == NULL)
+        return NULL;
+
+    dev->config = *config;
+    rphub75_decoder_init(&dev->dec);
+    dev->host_link = (rphub75_link_config_t){.lines = 1, .clock_hz = config->spi_clock_hz};
+    dev->link = dev->host_link;
+    dev->committed = dev->host_link;
+    dev->link_committed = true;
+    if (mock_alloc_framebuffers(dev, config->width, config->height) != ESP_OK)
+    {
+        mock_device_destroy(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+void mock_device_destroy(mock_device_t *dev)
+{
+    if (dev == NULL)
+        return;
+    for (int i = 0; i < RP_FB_COUNT; i++)
+        free(dev->fb[i]);
+    free(dev->payload);
+    free(dev);
+}
+
+void mock_device_get_stats(const mock_device_t *dev, mock_device_stats_t *out)
+{
+    *out = dev->stats;
+}
+
+void mock_device_reset_stats(mock_device_t *dev)
+{
+    memset(&dev->stats, 0, sizeof(dev->stats));
+}
+
+const rpio_rgb_t *mock_device_framebuffer(const mock_device_t *dev, uint8_t fb,
+                                          uint16_t *width, uint16_t *height)
+{
+    if (fb >= RP_FB_COUNT)
+        return NULL;
+    if (width)
+        *width = dev->width;
+    if (height)
+        *height = dev->height;
+    return dev->fb[fb];
+}
+
+uint8_t mock_device_shown_fb(const mock_device_t *dev)
+{
+    return dev->shown;
+}
+
+rphub75_link_config_t mock_device_link(const mock_device_t *dev, bool *committed)
+{
+    if (committed)
+        *committed = dev->link_committed;
+    return dev->link;
+}
+
+esp_err_t mock_device_write_ppm(const mock_device_t *dev, uint8_t fb, const char *path)
+{
+    if (fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+        return ESP_FAIL;
+    fprintf(f, "P6\n%u %u\n255\n", (unsigned)dev->width, (unsigned)dev->height);
+    size_t n = (size_t)dev->width * dev->height;
+    bool ok = fwrite(dev->fb[fb], sizeof(rpio_rgb_t), n, f) == n;
+    ok = fclose(f) == 0 && ok;
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t mock_device_push_usb_report(mock_device_t *dev, uint8_t type, const uint8_t *report)
+{
+    uint32_t size = rphub75_usb_report_size(type);
+    if (size == 0 || report == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (dev->usb_count == MOCK_DEVICE_USB_QUEUE)
+        return ESP_ERR_NO_MEM;
+
+    /* only one device is supported, plugging another replaces it */
+    if (type != dev->usb_type)
+        dev->usb_count = 0;
+    dev->usb_type = type;
+    memcpy(dev->usb_reports[(dev->usb_head + dev->usb_count) % MOCK_DEVICE_USB_QUEUE], report, size);
+    dev->usb_count++;
+    return ESP_OK;
+}
+
+// USB input on MISO
+
+/* Starts the next packet once the previous one is out: all queued reports,
+ * or an empty one when the host asked and nothing is queued. */
+static void mock_usb_packet(mock_device_t *dev)
+{
+    if (dev->miso_pos < dev->miso_len || (dev->usb_count == 0 && !dev->usb_requested))
+        return;
+
+    uint32_t size = rphub75_usb_report_size(dev->usb_type);
+    size_t count = dev->usb_count;
+    size_t length = 2 + count * size;
+    dev->miso[0] = rphub75_ctype_usb;
+    dev->miso[1] = (uint8_t)length;
+    dev->miso[2] = (uint8_t)(length >> 8);
+    dev->miso[3] = count ? dev->usb_type : rphub75_usb_none;
+    dev->miso[4] = (uint8_t)count;
+    for (size_t i = 0; i < count; i++)
+        memcpy(&dev->miso[RPHUB75_USB_HEADER_SIZE + i * size],
+               dev->usb_reports[(dev->usb_head + i) % MOCK_DEVICE_USB_QUEUE], size);
+    dev->usb_head = (dev->usb_head + count) % MOCK_DEVICE_USB_QUEUE;
+    dev->usb_count = 0;
+    dev->usb_requested = false;
+    dev->stats.usb_reports += count;
+    dev->miso_len = RPHUB75_USB_HEADER_SIZE + count * size;
+    dev->miso_pos = 0;
+}
+
+/* MISO window of one transaction: pending packet bytes, zeros after. */
+static void mock_usb_window(mock_device_t *dev, uint8_t *out, size_t window)
+{
+    mock_usb_packet(dev);
+    size_t n = dev->miso_len - dev->miso_pos;
+    if (n > window)
+        n = window;
+    memcpy(out, &dev->miso[dev->miso_pos], n);
+    memset(out + n, 0, window - n);
+    dev->miso_pos += n;
+}
+
+// Command execution
+
+static inline rpio_rgb_t rgb565_expand(uint16_t v)
+{
+    uint8_t r = (v >> 11) & 0x1F;
+    uint8_t g = (v >> 5) & 0x3F;
+    uint8_t b = v & 0x1F;
+    rpio_rgb_t c = {
+        .r = (uint8_t)((r << 3) | (r >> 2)),
+        .g = (uint8_t)((g << 2) | (g >> 4)),
+        .b = (uint8_t)((b << 3) | (b >> 2)),
+    };
+    return c;
+}
+
+/* Pixels of a draw that fall outside the framebuffer are dropped. */
+static void mock_draw(mock_device_t *dev, bool rgb565)
+{
+    rpio_fb_draw_t d;
+    memcpy(&d, dev->header, sizeof(d));
+    if (d.fb >= RP_FB_COUNT)
+    {
+        dev->stats.errors++;
+        return;
+    }
+
+    rpio_rgb_t *fb = dev->fb[d.fb];
+    for (uint32_t row = 0; row < d.h; row++)
+    {
+        uint32_t y = (uint32_t)d.y + row;
+        if (y >= dev->height)
+            break;
+        for (uint32_t col = 0; col < d.w; col++)
+        {
+            uint32_t x = (uint32_t)d.x + col;
+            if (x >= dev->width)
+                break;
+            size_t i = (size_t)row * d.w + col;
+            rpio_rgb_t c;
+            if (rgb565)
+            {
+                uint16_t v = (uint16_t)(dev->payload[i * 2] | (dev->payload[i * 2 + 1] << 8));
+                c = rgb565_expand(v);
+            }
+            else
+            {
+                memcpy(&c, &dev->payload[i * sizeof(c)], sizeof(c));
+            }
+            fb[(size_t)y * dev->width + x] = c;
+        }
+    }
+}
+
+static void mock_draw_packed(mock_device_t *dev)
+{
+    rphub75_fb_draw_packed_t d;
+    memcpy(&d, dev->header, sizeof(d));
+    if (d.fb >= RP_FB_COUNT || d.ref_fb >= RP_FB_COUNT ||
+        (uint32_t)d.x + d.w > dev->width || (uint32_t)d.y + d.h > dev->height)
+    {
+        dev->stats.errors++;
+        return;
+    }
+
+    size_t offset = (size_t)d.y * dev->width + d.x;
+    if (fbcodec_decode(dev->fb[d.fb] + offset, dev->width,
+                       dev->fb[d.ref_fb] + offset, dev->width,
+                       d.w, d.h, dev->payload, d.size) != 0)
+    {
+        ESP_LOGW(TAG, "malformed packed draw %ux%u at %u,%u", d.w, d.h, d.x, d.y);
+        dev->stats.errors++;
+    }
+}
+
+/* The board only takes planes packed for its own geometry; they go to its
+ * shifter as they are, so here they are unpacked to keep fb[] comparable. */
+static void mock_draw_planes(mock_device_t *dev)
+{
+    rphub75_fb_draw_planes_t d;
+    memcpy(&d, dev->header, sizeof(d));
+    bitplane_layout_t layout = {.width = d.width, .height = d.height, .scan = d.height / 2, .depth = d.depth};
+    if (d.fb >= RP_FB_COUNT || d.width != dev->width || d.height != dev->height ||
+        d.depth == 0 || d.depth > BITPLANE_MAX_DEPTH || (uint32_t)d.addr + d.count > layout.scan ||
+        d.size != bitplane_size(&layout, d.count))
+    {
+        ESP_LOGW(TAG, "bad plane draw %ux%u depth %u rows %u+%u", d.width, d.height, d.depth, d.addr, d.count);
+        dev->stats.errors++;
+        return;
+    }
+    bitplane_unpack(&layout, dev->fb[d.fb], dev->width, dev->payload, d.addr, d.count);
+}
+
+/* Forward copy pixel by pixel, like a straightforward firmware would do it.
+ * Overlapping blits within one framebuffer are therefore not safe. */
+static void mock_blit(mock_device_t *dev)
+{
+    rpio_fb_blit_t b;
+    memcpy(&b, dev->header, sizeof(b));
+    if (b.src_fb >= RP_FB_COUNT || b.dst_fb >= RP_FB_COUNT)
+    {
+        dev->stats.errors++;
+        return;
+    }
+
+    const rpio_rgb_t *src = dev->fb[b.src_fb];
+    rpio_rgb_t *dst = dev->fb[b.dst_fb];
+    for (uint32_t row = 0; row < b.h; row++)
+    {
+        uint32_t sy = (uint32_t)b.src_y + row;
+        uint32_t dy = (uint32_t)b.dst_y + row;
+        if (sy >= dev->height || dy >= dev->height)
+            break;
+        for (uint32_t col = 0; col < b.w; col++)
+        {
+            uint32_t sx = (uint32_t)b.src_x + col;
+            uint32_t dx = (uint32_t)b.dst_x + col;
+            if (sx >= dev->width || dx >= dev->width)
+                break;
+            dst[(size_t)dy * dev->width + dx] = src[(size_t)sy * dev->width + sx];
+        }
+    }
+}
+
+// Link training
+
+static uint32_t mock_link_max_hz(const mock_device_t *dev, uint8_t lines)
+{
+    switch (lines)
+    {
+    case 1:
+        return dev->config.link_max_hz[0];
+    case 2:
+        return dev->config.link_max_hz[1];
+    case 4:
+        return dev->config.link_max_hz[2];
+    default:
+        return 0;
+    }
+}
+
+static void mock_link_command(mock_device_t *dev)
+{
+    switch (dev->cmd)
+    {
+    case rphub75_link_mode_cmd:
+        memcpy(&dev->mode, dev->header, sizeof(dev->mode));
+        if (mock_link_max_hz(dev, dev->mode.lines) == 0)
+        {
+            dev->stats.errors++;
+            break;
+        }
+        dev->mode_pending = true;
+        break;
+    case rphub75_link_test_cmd:
+    {
+        rphub75_link_test_t t;
+        memcpy(&t, dev->header, sizeof(t));
+        dev->test_seq = t.seq;
+        if (rphub75_crc32(0, dev->payload, t.size) == t.crc)
+            dev->test_passed++;
+        else
+            dev->test_failed++;
+        break;
+    }
+    case rphub75_link_status_cmd:
+        dev->status_requested = true;
+        break;
+    case rphub75_link_commit_cmd:
+        dev->committed = dev->link;
+        dev->link_committed = true;
+        break;
+    }
+}
+
+/* Status for the transaction after a request; reading clears the counters. */
+static void mock_link_status(mock_device_t *dev, uint8_t *out, size_t len)
+{
+    rphub75_link_status_t st = {
+        .type = rphub75_ctype_link,
+        .lines = dev->link.lines,
+        .committed = dev->link_committed,
+        .seq = dev->test_seq,
+        .passed = dev->test_passed,
+        .failed = dev->test_failed,
+    };
+    st.crc = rphub75_crc32(0, &st, offsetof(rphub75_link_status_t, crc));
+    memcpy(out, &st, len < sizeof(st) ? len : sizeof(st));
+    dev->test_passed = 0;
+    dev->test_failed = 0;
+}
+
+/* Mode changes between transactions: an uncommitted mode past its timeout
+ * falls back, with the parser reset since whatever it was in the middle of
+ * arrived garbled; a new mode takes effect. */
+static void mock_link_update(mock_device_t *dev)
+{
+    if (!dev->link_committed && esp_timer_get_time() >= dev->revert_at_us)
+    {
+        dev->link = dev->committed;
+        dev->link_committed = true;
+        rphub75_decoder_init(&dev->dec);
+        dev->status_requested = false;
+        dev->test_passed = 0;
+        dev->test_failed = 0;
+        dev->stats.reverts++;
+    }
+    if (dev->mode_pending)
+    {
+        dev->mode_pending = false;
+        dev->link = (rphub75_link_config_t){.lines = dev->mode.lines, .clock_hz = dev->mode.clock_hz};
+        dev->link_committed = false;
+        dev->revert_at_us = esp_timer_get_time() + (int64_t)dev->mode.timeout_ms * 1000;
+    }
+}
+
+static bool mock_link_intact(const mock_device_t *dev)
+{
+    return dev->host_link.lines == dev->link.lines &&
+           dev->host_link.clock_hz <= mock_link_max_hz(dev, dev->link.lines);
+}
+
+/* What the bytes of a transaction look like at the other end. Sampling the
+ * wrong number of lines scrambles everything; a clock above the mode's limit
+ * flips a bit now and then. */
+static bool mock_link_garble(mock_device_t *dev, uint8_t *p, size_t len)
+{
+    if (dev->host_link.lines != dev->link.lines)
+    {
+        for (size_t i = 0; i < len; i++)
+            p[i] = (uint8_t)((p[i] << 1) | (p[i] >> 7)) ^ 0xA5;
+        return true;
+    }
+    if (mock_link_intact(dev))
+        return false;
+    bool flipped = false;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (++dev->garble_pos == MOCK_GARBLE_INTERVAL)
+        {
+            dev->garble_pos = 0;
+            p[i] ^= (uint8_t)(1u << (i % 8));
+            flipped = true;
+        }
+    }
+    return flipped;
+}
+
+static void mock_execute(mock_device_t *dev)
+{
+    dev->stats.commands++;
+
+    if (dev->type == rphub75_ctype_link)
+    {
+        mock_link_command(dev);
+        return;
+    }
+
+    if (dev->type == rpio_ctype_hub75)
+    {
+        switch (dev->cmd)
+        {
+        case rpio_hub75_init_cmd:
+        {
+            rpio_hub75_init_t init;
+            memcpy(&init, dev->header, sizeof(init));
+            if (mock_alloc_framebuffers(dev, init.width, init.height) != ESP_OK)
+                dev->stats.errors++;
+            dev->shown = 0;
+            break;
+        }
+        case rpio_hub75_flip_cmd:
+        {
+            rpio_hub75_flip_t flip;
+            memcpy(&flip, dev->header, sizeof(flip));
+            if (flip.fb < RP_FB_COUNT)
+                dev->shown = flip.fb;
+            else
+                dev->stats.errors++;
+            dev->stats.flips++;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    else if (dev->type == rpio_ctype_fb)
+    {
+        switch (dev->cmd)
+        {
+        case rpio_fb_clear_cmd:
+        {
+            rpio_fb_clear_t clear;
+            memcpy(&clear, dev->header, sizeof(clear));
+            if (clear.fb >= RP_FB_COUNT)
+            {
+                dev->stats.errors++;
+                break;
+            }
+            for (size_t i = 0; i < (size_t)dev->width * dev->height; i++)
+                dev->fb[clear.fb][i] = clear.color;
+            dev->stats.clears++;
+            break;
+        }
+        case rpio_fb_blit_cmd:
+            mock_blit(dev);
+            dev->stats.blits++;
+            break;
+        case rpio_fb_draw_cmd:
+            mock_draw(dev, false);
+            dev->stats.draws++;
+            break;
+        case rphub75_fb_draw565_cmd:
+            mock_draw(dev, true);
+            dev->stats.draws++;
+            break;
+        case rphub75_fb_draw_packed_cmd:
+            mock_draw_packed(dev);
+            dev->stats.draws++;
+            break;
+        case rphub75_fb_draw_planes_cmd:
+            mock_draw_planes(dev);
+            dev->stats.draws++;
+            break;
+        }
+    }
+}
+
+// Stream parser
+
+static void mock_feed(mock_device_t *dev, const uint8_t *p, size_t len)
+{
+    rphub75_decoded_t ev;
+    for (;;)
+    {
+        size_t n = rphub75_decode(&dev->dec, p, len, &ev);
+        p += n;
+        len -= n;
+
+        switch (ev.event)
+        {
+        case RPHUB75_DEC_NONE:
+            return;
+        case RPHUB75_DEC_REQUEST:
+            /* single byte request, answered in the next transaction */
+            dev->usb_requested = true;
+            dev->stats.commands++;
+            break;
+        case RPHUB75_DEC_LIST:
+            dev->stats.batches++;
+            break;
+        case RPHUB75_DEC_COMMAND:
+            /* the board keeps whole payloads; a real one would consume them as they come */
+            dev->payload_ok = true;
+            if (ev.payload_size > dev->payload_cap)
+            {
+                uint8_t *q = realloc(dev->payload, ev.payload_size);
+                if (q == NULL)
+                {
+                    dev->payload_ok = false;
+                    dev->stats.errors++;
+                    break;
+                }
+                dev->payload = q;
+                dev->payload_cap = ev.payload_size;
+            }
+            break;
+        case RPHUB75_DEC_PAYLOAD:
+            if (dev->payload_ok)
+                memcpy(&dev->payload[ev.offset], ev.data, ev.len);
+            break;
+        case RPHUB75_DEC_END:
+            if (ev.payload_size > 0 && !dev->payload_ok)
+                break;
+            dev->type = ev.type;
+            dev->cmd = ev.cmd;
+            memcpy(dev->header, ev.args, sizeof(dev->header));
+            mock_execute(dev);
+            break;
+        case RPHUB75_DEC_ERROR:
+            if (ev.error == RPHUB75_DEC_UNKNOWN_COMMAND)
+                ESP_LOGW(TAG, "unknown command %02x/%02x", ev.type, ev.cmd);
+            else if (ev.error == RPHUB75_DEC_ENTRY_LENGTH)
+                ESP_LOGW(TAG, "list entry %02x/%02x declares %zu bytes, command needs %zu", ev.type,
+                         ev.cmd, ev.entry_len, rphub75_cmd_desc(ev.type, ev.cmd)->size + (size_t)ev.payload_size);
+            else
+                ESP_LOGW(TAG, "command list ends inside a command");
+            dev->stats.errors++;
+            break;
+        }
+    }
+}
+
+/* One pass of a transfer, split into the transactions the SPI
+ * transport would queue. */
+static void mock_transfer_pass(mock_device_t *dev, const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+{
+    bool half_duplex = dev->host_link.lines > 1;
+    uint32_t total = tx_len > rx_len ? tx_len : rx_len;
+    uint64_t chunks = spi_transaction_count(tx != NULL, tx_len, rx != NULL, rx_len, half_duplex);
+    uint64_t bit_rate = (uint64_t)dev->host_link.clock_hz * dev->host_link.lines;
+
+    dev->stats.transactions += chunks;
+    dev->stats.bytes += tx_len;
+    dev->stats.link_time_ns += (uint64_t)total * 8 * 1000000000ULL / bit_rate +
+                               chunks * dev->config.transaction_ns;
+
+    if (rx != NULL)
+        memset(rx, 0, rx_len);
+    mock_link_update(dev);
+
+    /* one DMA transaction at a time, like the SPI transport splits them:
+     * the window goes out while the device still works on what came before */
+    for (uint32_t offset = 0, len; offset < total; offset += len)
+    {
+        len = spi_chunk_len(tx != NULL, tx_len, rx != NULL, rx_len, offset, half_duplex);
+        bool answering = dev->usb_requested || dev->status_requested;
+        if (dev->status_requested)
+        {
+            dev->status_requested = false;
+            if (rx != NULL && offset < rx_len)
+            {
+                uint32_t n = rx_len - offset < len ? rx_len - offset : len;
+                mock_link_status(dev, rx + offset, n);
+                if (mock_link_garble(dev, rx + offset, n))
+                    dev->stats.garbled++;
+            }
+        }
+        else if (dev->usb_requested && rx != NULL && offset < rx_len)
+        {
+            /* an explicit read of the answer, on any number of lines */
+            uint32_t n = rx_len - offset < len ? rx_len - offset : len;
+            mock_usb_window(dev, rx + offset, n < RPHUB75_MISO_WINDOW ? n : RPHUB75_MISO_WINDOW);
+            if (mock_link_garble(dev, rx + offset, n))
+                dev->stats.garbled++;
+        }
+        else if (rx == NULL && dev->host_link.lines == 1)
+        {
+            /* with more lines MISO carries data and there is no window */
+            uint8_t window[RPHUB75_MISO_WINDOW];
+            uint32_t n = rphub75_miso_window(len);
+            mock_usb_window(dev, window, n);
+            /* the host only reads the window when its input is enabled */
+            uint32_t captured = rphub75_input_window(len);
+            if (captured > 0)
+                rphub75_input_feed(window, captured);
+        }
+
+        /* MOSI is ignored while the device answers a request, which takes
+         * exactly one transaction */
+        if (answering)
+            dev->usb_requested = false;
+        else if (tx != NULL && offset < tx_len)
+        {
+            uint32_t n = len < tx_len - offset ? len : tx_len - offset;
+            const uint8_t *p = tx + offset;
+            if (!mock_link_intact(dev))
+            {
+                memcpy(dev->received, p, n);
+                if (mock_link_garble(dev, dev->received, n))
+                    dev->stats.garbled++;
+                p = dev->received;
+            }
+            mock_feed(dev, p, n);
+        }
+    }
+}
+
+static esp_err_t mock_transfer(void *ctx, const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+{
+    mock_device_t *dev = ctx;
+
+    dev->stats.calls++;
+    if (dev->host_link.lines > 1 && tx != NULL && rx != NULL)
+    {
+        /* the data lines carry one direction at a time: write, then read */
+        mock_transfer_pass(dev, tx, tx_len, NULL, 0);
+        mock_transfer_pass(dev, NULL, 0, rx, rx_len);
+    }
+    else
+        mock_transfer_pass(dev, tx, tx_len, rx, rx_len);
+
+    /* an unknown command outside a list throws away the rest of the call */
+    rphub75_decoder_end_transaction(&dev->dec);
+    return ESP_OK;
+}
+
+/* The host side of a mode switch: the board only follows through commands. */
+static esp_err_t mock_configure(void *ctx, const rphub75_link_config_t *link)
+{
+    mock_device_t *dev = ctx;
+    if (link->clock_hz == 0 || (link->lines != 1 && link->lines != 2 && link->lines != 4))
+        return ESP_ERR_INVALID_ARG;
+    dev->host_link = *link;
+    return ESP_OK;
+}
+
+rphub75_transport_t mock_device_transport(mock_device_t *dev)
+{
+    rphub75_transport_t transport = {
+        .transfer = mock_transfer,
+        .ctx = dev,
+        .configure = mock_configure,
+    };
+    return transport;
+}
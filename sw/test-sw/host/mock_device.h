@@ -0,0 +1,85 @@
+// mock_device.h
+// Simulated RP-HUB75 board for host builds. It decodes the rpio command
+// stream sent through rphub75.c into in-memory framebuffers, counts traffic
+// and models how long the transfers would take on a real SPI link.
+
+#ifndef MOCK_DEVICE_H
+#define MOCK_DEVICE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+
+typedef struct
+{
+    uint32_t spi_clock_hz;      // link clock used for the timing model
+    uint32_t transaction_ns;    // fixed cost per DMA transaction (CS, setup, ISR)
+    uint16_t width;             // framebuffer size until a hub75 init arrives
+    uint16_t height;
+    // Fastest clock each link mode (1, 2 and 4 data lines) still carries
+    // intact; above it bits get flipped. 0 for lines the board lacks.
+    uint32_t link_max_hz[3];
+} mock_device_config_t;
+
+#define MOCK_DEVICE_CONFIG_DEFAULT()                              \
+    {                                                             \
+        .spi_clock_hz = RP_SPI_CLOCK_HZ,                          \
+        .transaction_ns = 15000,                                  \
+        .width = RP_HUB75_WIDTH,                                  \
+        .height = RP_HUB75_HEIGHT,                                \
+        .link_max_hz = {40000000, 40000000, 40000000},            \
+    }
+
+typedef struct
+{
+    uint64_t bytes;           // bytes sent by the host
+    uint64_t calls;           // spi_send_and_receive calls
+    uint64_t transactions;    // DMA transactions the calls split into
+    uint64_t link_time_ns;    // modeled time on the wire
+    uint64_t commands;        // commands executed
+    uint64_t clears;
+    uint64_t blits;
+    uint64_t draws;           // all draw variants
+    uint64_t flips;
+    uint64_t batches;         // command list containers
+    uint64_t errors;          // malformed or unknown commands
+    uint64_t usb_reports;     // USB reports clocked out on MISO
+    uint64_t garbled;         // transactions received in the wrong mode or too fast
+    uint64_t reverts;         // link modes dropped for lack of a commit
+} mock_device_stats_t;
+
+#define MOCK_DEVICE_USB_QUEUE 64 // Reports the simulated USB host keeps
+
+typedef struct mock_device mock_device_t;
+
+mock_device_t *mock_device_create(const mock_device_config_t *config);
+void mock_device_destroy(mock_device_t *dev);
+
+// Transport to install with rphub75_set_transport. It starts on one line at
+// `spi_clock_hz` and can be switched to any mode; the board only follows
+// through the link commands of rphub75_link.h.
+rphub75_transport_t mock_device_transport(mock_device_t *dev);
+
+// Link mode the board is in, and whether it is committed.
+rphub75_link_config_t mock_device_link(const mock_device_t *dev, bool *committed);
+
+void mock_device_get_stats(const mock_device_t *dev, mock_device_stats_t *out);
+void mock_device_reset_stats(mock_device_t *dev);
+
+// Framebuffer contents as last written, row-major width x height.
+const rpio_rgb_t *mock_device_framebuffer(const mock_device_t *dev, uint8_t fb,
+                                          uint16_t *width, uint16_t *height);
+uint8_t mock_device_shown_fb(const mock_device_t *dev);
+
+// Queues a report from the simulated USB device of `type` (rphub75_usb_*);
+// its size follows from the type. It goes out on MISO in the windows of the
+// following transactions. ESP_ERR_NO_MEM when the queue is full.
+esp_err_t mock_device_push_usb_report(mock_device_t *dev, uint8_t type, const uint8_t *report);
+
+// Writes a framebuffer as a binary PPM image.
+esp_err_t mock_device_write_ppm(const mock_device_t *dev, uint8_t fb, const char *path);
+
+#endif // MOCK_DEVICE_H
@@ -0,0 +1,303 @@
+// sim_main.c
+// Drives the rphub75 library against the simulated board and prints what
+// went over the link. With an RPAN file it then plays that once from a
+// file-backed "anim" partition, the way the board plays it from flash.
+//
+//   rphub75_sim [frames] [out.ppm | -] [anim.rpan]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rphub75.h"
+#include "rphub75_anim.h"
+#include "rphub75_cmdq.h"
+#include "rphub75_input.h"
+#include "rphub75_link.h"
+#include "rphub75_shadow.h"
+#include "rphub75_stats.h"
+#include "colors.h"
+#include "fbcodec.h"
+#include "bitplane.h"
+#include "mock_device.h"
+#include "esp_partition.h"
+#include "freertos/semphr.h"
+
+static const uint8_t swap_chain[] = {0, 1};
+
+static void fill_rect(rpio_rgb_t *frame, int x, int y, int w, int h, rpio_rgb_t color)
+{
+    for (int py = y; py < y + h; py++)
+        for (int px = x; px < x + w; px++)
+            if (px >= 0 && py >= 0 && px < RP_HUB75_WIDTH && py < RP_HUB75_HEIGHT)
+                frame[py * RP_HUB75_WIDTH + px] = color;
+}
+
+/* A gamepad report pushed on the board has to reach the input queue through
+ * rphub75_input_poll on whatever link training picked. */
+static int check_input(mock_device_t *dev, uint8_t lines)
+{
+    static const uint8_t report[7] = {RPHUB75_PAD_A, 0, 0, 200, 128, 128, 128};
+    rphub75_input_enable(true);
+    mock_device_push_usb_report(dev, rphub75_usb_gamepad, report);
+    esp_err_t ret = rphub75_input_poll(0);
+    rphub75_input_event_t ev;
+    bool received = ret == ESP_OK && rphub75_input_next(&ev) && ev.type == RPHUB75_INPUT_GAMEPAD &&
+                    ev.gamepad.buttons == RPHUB75_PAD_A && ev.gamepad.lx == 200;
+    rphub75_input_enable(false);
+    printf("usb input     %s on %u lines\n", received ? "received" : "LOST", (unsigned)lines);
+    return !received;
+}
+
+/* Producer tasks share one command queue. Each owns a row of fb 2 and, per
+ * round, draws its first pixel and blits it one column further along: the
+ * copy only holds the round's value if the two stayed in order. */
+#define CMDQ_CHECK_PRODUCERS 4
+#define CMDQ_CHECK_ROUNDS    48
+#define CMDQ_CHECK_FB        2
+
+typedef struct
+{
+    cmdq_t *q;
+    uint8_t row;
+    SemaphoreHandle_t done;
+    int failed;
+} cmdq_producer_t;
+
+static void cmdq_producer(void *param)
+{
+    cmdq_producer_t *p = param;
+    for (uint8_t r = 0; r < CMDQ_CHECK_ROUNDS; r++)
+    {
+        rpio_rgb_t pixel = {r, p->row, 0};
+        if (cmdq_draw(p->q, CMDQ_CHECK_FB, 0, p->row, &pixel, 1, 1, NULL, NULL) != ESP_OK ||
+            cmdq_blit(p->q, CMDQ_CHECK_FB, CMDQ_CHECK_FB, 0, p->row, 1 + r, p->row, 1, 1) != ESP_OK)
+            p->failed = 1;
+        if (r % 16 == 15 && cmdq_wait_idle(p->q, portMAX_DELAY) != ESP_OK)
+            p->failed = 1;
+    }
+    xSemaphoreGive(p->done);
+    vTaskDelete(NULL);
+}
+
+static int check_cmdq(mock_device_t *dev)
+{
+    cmdq_config_t config = CMDQ_CONFIG_DEFAULT();
+    config.capacity = 16; // small, so producers run into each other and the full ring
+    config.overflow = CMDQ_OVERFLOW_WAIT;
+    config.wait_ticks = portMAX_DELAY;
+    cmdq_t q;
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(CMDQ_CHECK_PRODUCERS, 0);
+    if (done == NULL || cmdq_init(&q, &config) != ESP_OK)
+        return 1;
+
+    mock_device_stats_t before, after;
+    mock_device_get_stats(dev, &before);
+    cmdq_producer_t producers[CMDQ_CHECK_PRODUCERS];
+    for (uint8_t i = 0; i < CMDQ_CHECK_PRODUCERS; i++)
+    {
+        producers[i] = (cmdq_producer_t){.q = &q, .row = i, .done = done};
+        xTaskCreatePinnedToCore(cmdq_producer, "producer", 4096, &producers[i], 5, NULL, tskNO_AFFINITY);
+    }
+    int failed = 0;
+    for (int i = 0; i < CMDQ_CHECK_PRODUCERS; i++)
+        xSemaphoreTake(done, portMAX_DELAY);
+    failed |= cmdq_wait_idle(&q, portMAX_DELAY) != ESP_OK;
+    mock_device_get_stats(dev, &after);
+
+    const rpio_rgb_t *fb = mock_device_framebuffer(dev, CMDQ_CHECK_FB, NULL, NULL);
+    int misplaced = 0;
+    for (uint8_t i = 0; i < CMDQ_CHECK_PRODUCERS; i++)
+    {
+        failed |= producers[i].failed;
+        for (uint8_t r = 0; r < CMDQ_CHECK_ROUNDS; r++)
+        {
+            const rpio_rgb_t *px = &fb[i * RP_HUB75_WIDTH + 1 + r];
+            misplaced += px->r != r || px->g != i;
+        }
+    }
+    uint64_t expected = (uint64_t)CMDQ_CHECK_PRODUCERS * CMDQ_CHECK_ROUNDS;
+    failed |= misplaced != 0 || after.draws - before.draws != expected || after.blits - before.blits != expected;
+
+    /* a fence given up on must not leave a notification behind */
+    static rpio_rgb_t frame[RP_HUB75_WIDTH * RP_HUB75_HEIGHT];
+    cmdq_draw(&q, CMDQ_CHECK_FB, 0, 0, frame, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, NULL, NULL);
+    cmdq_wait_idle(&q, 0);
+    cmdq_wait_idle(&q, portMAX_DELAY);
+    bool stale = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20)) != 0;
+    failed |= stale;
+
+    cmdq_stats_t st;
+    cmdq_get_stats(&q, &st);
+    cmdq_deinit(&q);
+    vSemaphoreDelete(done);
+    printf("cmdq          %d producers, %llu draws %llu blits, %d out of order, %lu retries, %lu full%s\n",
+           CMDQ_CHECK_PRODUCERS, (unsigned long long)(after.draws - before.draws),
+           (unsigned long long)(after.blits - before.blits), misplaced, (unsigned long)st.retries,
+           (unsigned long)st.full, stale ? ", stale notification" : "");
+    return failed;
+}
+
+/* Applies every frame of `anim` to `fbs`, starting from what the board's
+ * framebuffers 0 and 1 held, the way rphub75_anim_play(anim, 0, 1, 1) has
+ * the board do it: frames alternate between the two, starting on 0. */
+static void anim_decode(const rphub75_anim_t *anim, rpio_rgb_t *fbs[2])
+{
+    uint16_t w = anim->header->width, h = anim->header->height;
+    for (uint32_t i = 0; i < anim->header->frame_count; i++)
+    {
+        const rphub75_anim_frame_t *f = &anim->frames[i];
+        const uint8_t *p = anim->data + f->offset;
+        rpio_rgb_t *dst = fbs[i & 1];
+        switch (f->kind)
+        {
+        case RPHUB75_ANIM_RAW:
+            for (uint16_t y = 0; y < h; y++)
+                memcpy(dst + (size_t)y * RP_HUB75_WIDTH, p + (size_t)y * w * sizeof(rpio_rgb_t),
+                       w * sizeof(rpio_rgb_t));
+            break;
+        case RPHUB75_ANIM_RGB565:
+            for (size_t px = 0; px < (size_t)w * h; px++)
+            {
+                uint16_t v = (uint16_t)(p[px * 2] | (p[px * 2 + 1] << 8));
+                uint8_t r = (v >> 11) & 0x1F, g = (v >> 5) & 0x3F, b = v & 0x1F;
+                dst[(px / w) * RP_HUB75_WIDTH + px % w] = (rpio_rgb_t){
+                    .r = (uint8_t)((r << 3) | (r >> 2)),
+                    .g = (uint8_t)((g << 2) | (g >> 4)),
+                    .b = (uint8_t)((b << 3) | (b >> 2)),
+                };
+            }
+            break;
+        case RPHUB75_ANIM_PACKED:
+            fbcodec_decode(dst, RP_HUB75_WIDTH, f->flags & RPHUB75_ANIM_KEY ? dst : fbs[(i + 1) & 1],
+                           RP_HUB75_WIDTH, w, h, p, f->size);
+            break;
+        default:
+            bitplane_unpack(&anim->layout, dst, RP_HUB75_WIDTH, p, 0, anim->layout.scan);
+            break;
+        }
+    }
+}
+
+static int play_anim(mock_device_t *dev, const char *path)
+{
+    rphub75_anim_t anim;
+    if (host_partition_add("anim", path) != ESP_OK || rphub75_anim_open_partition(&anim, "anim") != ESP_OK)
+    {
+        fprintf(stderr, "cannot play %s\n", path);
+        return 1;
+    }
+    if (anim.header->width > RP_HUB75_WIDTH || anim.header->height > RP_HUB75_HEIGHT)
+    {
+        fprintf(stderr, "%s is %ux%u, larger than the board\n", path, anim.header->width, anim.header->height);
+        rphub75_anim_close(&anim);
+        return 1;
+    }
+
+    /* the expected result, worked out from what the board holds now */
+    static rpio_rgb_t expected[2][RP_HUB75_WIDTH * RP_HUB75_HEIGHT];
+    rpio_rgb_t *fbs[2] = {expected[0], expected[1]};
+    for (uint8_t i = 0; i < 2; i++)
+        memcpy(expected[i], mock_device_framebuffer(dev, i, NULL, NULL), sizeof(expected[i]));
+    anim_decode(&anim, fbs);
+
+    mock_device_stats_t before, after;
+    mock_device_get_stats(dev, &before);
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = rphub75_anim_play(&anim, 0, 1, 1);
+    int64_t elapsed_us = esp_timer_get_time() - start;
+    mock_device_get_stats(dev, &after);
+
+    uint32_t count = rphub75_anim_frame_count(&anim);
+    uint8_t shown = mock_device_shown_fb(dev);
+    const rpio_rgb_t *fb = mock_device_framebuffer(dev, shown, NULL, NULL);
+    int mismatch = count == 0 || shown != ((count - 1) & 1) || memcmp(fb, expected[shown], sizeof(expected[shown])) != 0;
+
+    rphub75_anim_stats_t st;
+    rphub75_anim_get_stats(&anim, &st);
+    printf("anim          %lu frames in %.1f ms, %.1f bytes per frame, %lu late (max %lu us), errors %llu\n",
+           (unsigned long)st.frames, elapsed_us / 1e3, st.frames ? (double)st.bytes / st.frames : 0.0,
+           (unsigned long)st.late, (unsigned long)st.max_late_us,
+           (unsigned long long)(after.errors - before.errors));
+    printf("anim shown fb %u %s the last frame\n", (unsigned)shown, mismatch ? "DIFFERS FROM" : "matches");
+    rphub75_anim_close(&anim);
+    return ret != ESP_OK || after.errors != before.errors || mismatch;
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 120;
+    const char *ppm = argc > 2 && strcmp(argv[2], "-") != 0 ? argv[2] : NULL;
+    const char *anim = argc > 3 ? argv[3] : NULL;
+
+    mock_device_config_t config = MOCK_DEVICE_CONFIG_DEFAULT();
+    config.link_max_hz[2] = RP_LINK_CLOCK_26M; // quad tops out below 40 MHz, so training falls back once
+    mock_device_t *dev = mock_device_create(&config);
+    if (dev == NULL)
+        return 1;
+    rphub75_transport_t transport = mock_device_transport(dev);
+    rphub75_set_transport(&transport);
+
+    rphub75_link_train_config_t train = RPHUB75_LINK_TRAIN_CONFIG_DEFAULT();
+    rphub75_link_result_t trained;
+    rphub75_link_train(&train, &trained);
+    mock_device_stats_t training;
+    mock_device_get_stats(dev, &training);
+    mock_device_reset_stats(dev);
+    rphub75_stats_reset();
+
+    display_init();
+
+    shadowfb_t shadow;
+    if (shadowfb_init(&shadow, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, swap_chain, sizeof(swap_chain)) != ESP_OK)
+        return 1;
+    shadowfb_set_compression(&shadow, true);
+
+    static rpio_rgb_t frame[RP_HUB75_WIDTH * RP_HUB75_HEIGHT];
+    for (int i = 0; i < frames; i++)
+    {
+        memset(frame, 0, sizeof(frame));
+        fill_rect(frame, 0, 56, 64, 8, color_gray);
+        fill_rect(frame, 16, 44, 32, 4, color_gray);
+        fill_rect(frame, i % 56, 48, 8, 8, color_red);
+        shadowfb_present(&shadow, frame, NULL);
+    }
+
+    rphub75_stats_t link;
+    rphub75_stats_get(&link);
+    const rphub75_op_stats_t *draws = &link.ops[RPHUB75_OP_DRAW];
+
+    uint8_t shown = mock_device_shown_fb(dev);
+    const rpio_rgb_t *fb = mock_device_framebuffer(dev, shown, NULL, NULL);
+    int mismatch = memcmp(fb, frame, sizeof(frame)) != 0;
+
+    mock_device_stats_t st;
+    mock_device_get_stats(dev, &st);
+    printf("link          %u lines at %u Hz (%u tried, %u fallbacks, %llu garbled)\n",
+           (unsigned)trained.link.lines, (unsigned)trained.link.clock_hz, (unsigned)trained.tried,
+           (unsigned)trained.fallbacks, (unsigned long long)training.garbled);
+    printf("frames        %d\n", frames);
+    printf("bytes         %llu (%.1f per frame)\n", (unsigned long long)st.bytes, (double)st.bytes / frames);
+    printf("calls         %llu\n", (unsigned long long)st.calls);
+    printf("transactions  %llu\n", (unsigned long long)st.transactions);
+    printf("commands      %llu (draws %llu, flips %llu)\n", (unsigned long long)st.commands,
+           (unsigned long long)st.draws, (unsigned long long)st.flips);
+    printf("link time     %.3f ms (%.1f us per frame at %u Hz)\n", st.link_time_ns / 1e6,
+           st.link_time_ns / 1e3 / frames, (unsigned)trained.link.clock_hz);
+    printf("draw latency  avg %llu us, p99 <%lu us\n",
+           (unsigned long long)(draws->count ? draws->total_us / draws->count : 0),
+           (unsigned long)rphub75_stats_percentile_us(draws, 99));
+    printf("errors        %llu\n", (unsigned long long)st.errors);
+    printf("shown fb %u %s the last frame\n", (unsigned)shown, mismatch ? "DIFFERS FROM" : "matches");
+
+    if (ppm && mock_device_write_ppm(dev, shown, ppm) != ESP_OK)
+        fprintf(stderr, "failed to write %s\n", ppm);
+    int input_failed = check_input(dev, trained.link.lines);
+    int cmdq_failed = check_cmdq(dev);
+    int anim_failed = anim != NULL ? play_anim(dev, anim) : 0;
+
+    shadowfb_deinit(&shadow);
+    rphub75_set_transport(NULL);
+    mock_device_destroy(dev);
+    return (mismatch || st.errors || input_failed || cmdq_failed || anim_failed) ? 1 : 0;
+}
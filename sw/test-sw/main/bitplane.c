@@ -0,0 +1,144 @@
+// bitplane.c
+// Bit-plane packer and reference unpacker, see bitplane.h
+
+#include "bitplane.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* s_spread[v] holds bit i of v in bit 0 of byte i. OR-ing the six channels
+ * of a pixel clock, each shifted to its pin, gives a word whose byte i is
+ * that clock's byte of plane i: an 8x8 bit transpose in six lookups. */
+#define SPREAD(v)                                                                                  \
+    ((uint64_t)((v) & 1) | ((uint64_t)(((v) >> 1) & 1) << 8) | ((uint64_t)(((v) >> 2) & 1) << 16) | \
+     ((uint64_t)(((v) >> 3) & 1) << 24) | ((uint64_t)(((v) >> 4) & 1) << 32) |                     \
+     ((uint64_t)(((v) >> 5) & 1) << 40) | ((uint64_t)(((v) >> 6) & 1) << 48) |                     \
+     ((uint64_t)(((v) >> 7) & 1) << 56))
+#define SPREAD4(v)  SPREAD(v), SPREAD((v) + 1), SPREAD((v) + 2), SPREAD((v) + 3)
+#define SPREAD16(v) SPREAD4(v), SPREAD4((v) + 4), SPREAD4((v) + 8), SPREAD4((v) + 12)
+#define SPREAD64(v) SPREAD16(v), SPREAD16((v) + 16), SPREAD16((v) + 32), SPREAD16((v) + 48)
+
+static const uint64_t s_spread[256] = {SPREAD64(0), SPREAD64(64), SPREAD64(128), SPREAD64(192)};
+
+esp_err_t bitplane_layout_init(bitplane_layout_t *layout, const rpio_hub75_init_t *init, uint8_t depth)
+{
+    if (layout == NULL || init == NULL || depth == 0 || depth > BITPLANE_MAX_DEPTH ||
+        init->width == 0 || init->height < 2 || init->height % 2 != 0)
+        return ESP_ERR_INVALID_ARG;
+
+    layout->width = init->width;
+    layout->height = init->height;
+    layout->scan = init->height / 2;
+    layout->depth = depth;
+    return ESP_OK;
+}
+
+/* Columns [x, width) of one row address; `dst` is its plane 0. */
+static void pack_clocks(const bitplane_layout_t *layout, uint8_t *dst, const rpio_rgb_t *top,
+                        const rpio_rgb_t *bottom, uint16_t x)
+{
+    uint16_t width = layout->width;
+    uint8_t depth = layout->depth;
+    unsigned first = 8u * (BITPLANE_MAX_DEPTH - depth);
+    for (; x < width; x++)
+    {
+        uint64_t word = s_spread[top[x].r] | s_spread[top[x].g] << 1 | s_spread[top[x].b] << 2 |
+                        s_spread[bottom[x].r] << 3 | s_spread[bottom[x].g] << 4 | s_spread[bottom[x].b] << 5;
+        word >>= first;
+        uint8_t *out = dst + x;
+        for (uint8_t p = 0; p < depth; p++)
+        {
+            *out = (uint8_t)word;
+            word >>= 8;
+            out += width;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+/* Eight pixel clocks at a time: their words are the rows of an 8x8 byte
+ * matrix whose columns are the planes, so three rounds of unpacks transpose
+ * them and each plane gets one 8-byte store instead of eight byte stores. */
+static uint16_t pack_clocks_sse2(const bitplane_layout_t *layout, uint8_t *dst, const rpio_rgb_t *top,
+                                 const rpio_rgb_t *bottom)
+{
+    uint16_t width = layout->width;
+    uint8_t depth = layout->depth;
+    unsigned first = 8u * (BITPLANE_MAX_DEPTH - depth);
+    uint16_t x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        __m128i w[8];
+        for (int i = 0; i < 8; i++)
+        {
+            const rpio_rgb_t *t = &top[x + i];
+            const rpio_rgb_t *b = &bottom[x + i];
+            uint64_t word = (s_spread[t->r] | s_spread[t->g] << 1 | s_spread[t->b] << 2 |
+                             s_spread[b->r] << 3 | s_spread[b->g] << 4 | s_spread[b->b] << 5) >> first;
+            w[i] = _mm_loadl_epi64((const __m128i *)&word);
+        }
+        __m128i t0 = _mm_unpacklo_epi8(w[0], w[1]);
+        __m128i t1 = _mm_unpacklo_epi8(w[2], w[3]);
+        __m128i t2 = _mm_unpacklo_epi8(w[4], w[5]);
+        __m128i t3 = _mm_unpacklo_epi8(w[6], w[7]);
+        __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+        __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+        __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+        __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+        __m128i planes[4] = {
+            _mm_unpacklo_epi32(u0, u2), // planes 0, 1
+            _mm_unpackhi_epi32(u0, u2), // planes 2, 3
+            _mm_unpacklo_epi32(u1, u3), // planes 4, 5
+            _mm_unpackhi_epi32(u1, u3), // planes 6, 7
+        };
+        for (uint8_t p = 0; p < depth; p++)
+        {
+            __m128i v = p % 2 == 0 ? planes[p / 2] : _mm_srli_si128(planes[p / 2], 8);
+            _mm_storel_epi64((__m128i *)(dst + (size_t)p * width + x), v);
+        }
+    }
+    return x;
+}
+#endif
+
+void bitplane_pack(const bitplane_layout_t *layout, uint8_t *dst, const rpio_rgb_t *frame, size_t stride,
+                   uint16_t addr, uint16_t count)
+{
+    for (uint16_t a = 0; a < count; a++)
+    {
+        const rpio_rgb_t *top = frame + (size_t)(addr + a) * stride;
+        const rpio_rgb_t *bottom = top + (size_t)layout->scan * stride;
+        uint8_t *out = dst + (size_t)a * bitplane_row_size(layout);
+        uint16_t x = 0;
+#if defined(__SSE2__)
+        x = pack_clocks_sse2(layout, out, top, bottom);
+#endif
+        pack_clocks(layout, out, top, bottom, x);
+    }
+}
+
+void bitplane_unpack(const bitplane_layout_t *layout, rpio_rgb_t *frame, size_t stride, const uint8_t *src,
+                     uint16_t addr, uint16_t count)
+{
+    uint16_t width = layout->width;
+    uint8_t depth = layout->depth;
+    for (uint16_t a = 0; a < count; a++)
+    {
+        rpio_rgb_t *top = frame + (size_t)(addr + a) * stride;
+        rpio_rgb_t *bottom = top + (size_t)layout->scan * stride;
+        const uint8_t *in = src + (size_t)a * bitplane_row_size(layout);
+        for (uint16_t x = 0; x < width; x++)
+        {
+            uint8_t c[6] = {0};
+            for (uint8_t p = 0; p < depth; p++)
+            {
+                uint8_t byte = in[(size_t)p * width + x];
+                for (int k = 0; k < 6; k++)
+                    c[k] |= (uint8_t)(((byte >> k) & 1) << (BITPLANE_MAX_DEPTH - depth + p));
+            }
+            top[x] = (rpio_rgb_t){.r = c[0], .g = c[1], .b = c[2]};
+            bottom[x] = (rpio_rgb_t){.r = c[3], .g = c[4], .b = c[5]};
+        }
+    }
+}
@@ -0,0 +1,64 @@
+// bitplane.h
+// Bit-plane packing for rphub75_fb_draw_planes_cmd. A HUB75 chain shows its
+// frame with binary code modulation: for each row address it shifts out the
+// same bit of every pixel, one plane per bit, with the upper and lower half
+// of the panel (rows a and a + scan) on separate data pins. Packing the
+// frame in that order on the host leaves the board a plain copy.
+//
+// One byte per pixel clock, as the board's shifter takes it:
+//   bit 0..2  R, G, B of row a          bit 3..5  R, G, B of row a + scan
+// laid out [row address] [plane] [column], planes least significant first.
+// `depth` planes carry the top `depth` bits of each channel.
+//
+//   bitplane_layout_t layout;
+//   rpio_hub75_init_t init;
+//   display_get_init(&init);
+//   bitplane_layout_init(&layout, &init, 8);
+//   uint8_t *planes = malloc(bitplane_size(&layout, layout.scan));
+//   bitplane_pack(&layout, planes, frame, layout.width, 0, layout.scan);
+//   fb_draw_planes(1, &layout, 0, layout.scan, planes);
+
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#define BITPLANE_MAX_DEPTH 8
+
+typedef struct
+{
+    uint16_t width;  // pixel clocks per plane, the width of the chain
+    uint16_t height;
+    uint16_t scan;   // row addresses, height / 2
+    uint8_t depth;   // planes per row address, 1..BITPLANE_MAX_DEPTH
+} bitplane_layout_t;
+
+// The layout a board initialised with `init` displays at `depth` bits.
+esp_err_t bitplane_layout_init(bitplane_layout_t *layout, const rpio_hub75_init_t *init, uint8_t depth);
+
+// Bytes of one row address, all of its planes.
+static inline size_t bitplane_row_size(const bitplane_layout_t *layout)
+{
+    return (size_t)layout->depth * layout->width;
+}
+
+// Bytes of `count` row addresses.
+static inline size_t bitplane_size(const bitplane_layout_t *layout, uint16_t count)
+{
+    return (size_t)count * bitplane_row_size(layout);
+}
+
+// Packs row addresses [addr, addr + count) of a width x height frame whose
+// rows are `stride` pixels apart.
+void bitplane_pack(const bitplane_layout_t *layout, uint8_t *dst, const rpio_rgb_t *frame, size_t stride,
+                   uint16_t addr, uint16_t count);
+
+// Reference unpacker for the simulated board. Bits below the top `depth` of
+// each channel come back as zero.
+void bitplane_unpack(const bitplane_layout_t *layout, rpio_rgb_t *frame, size_t stride, const uint8_t *src,
+                     uint16_t addr, uint16_t count);
+
+#endif // BITPLANE_H
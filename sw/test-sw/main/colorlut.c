@@ -0,0 +1,71 @@
+// colorlut.c
+// Color correction tables, see colorlut.h
+
+#include "colorlut.h"
+
+/* round(255 * (i / 255)^2.2), generated offline so neither the build nor the
+ * board needs powf */
+const uint8_t colorlut_gamma22[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+void colorlut_build(colorlut_t *lut, const colorlut_config_t *config)
+{
+    /* brightness and white balance scale linear light, so they come after
+     * the gamma curve */
+    const uint8_t whites[3] = {config->white_r, config->white_g, config->white_b};
+    uint8_t *tables[3] = {lut->r, lut->g, lut->b};
+    for (int ch = 0; ch < 3; ch++)
+    {
+        uint32_t scale = (uint32_t)config->brightness * whites[ch];
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t v = config->gamma ? colorlut_gamma22[i] : i;
+            tables[ch][i] = (uint8_t)((v * scale + 255 * 255 / 2) / (255 * 255));
+        }
+    }
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        lut->r565[i] = (uint16_t)((lut->r[i] & 0xF8) << 8);
+        lut->g565[i] = (uint16_t)((lut->g[i] & 0xFC) << 3);
+        lut->b565[i] = (uint16_t)(lut->b[i] >> 3);
+    }
+}
+
+void colorlut_apply(const colorlut_t *lut, rpio_rgb_t *dst, const rpio_rgb_t *src, size_t count)
+{
+    /* byte arrays so the three channels are plain independent lookups */
+    const uint8_t *in = (const uint8_t *)src;
+    uint8_t *out = (uint8_t *)dst;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t r = in[0], g = in[1], b = in[2];
+        out[0] = lut->r[r];
+        out[1] = lut->g[g];
+        out[2] = lut->b[b];
+        in += 3;
+        out += 3;
+    }
+}
+
+void colorlut_pack_rgb565(const colorlut_t *lut, uint16_t *dst, const rpio_rgb_t *src, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        dst[i] = lut->r565[src[i].r] | lut->g565[src[i].g] | lut->b565[src[i].b];
+}
@@ -0,0 +1,60 @@
+// colorlut.h
+// Color correction for the panels through per-channel lookup tables: gamma,
+// global brightness and white balance are folded into one 256-entry table
+// per channel, built once when a setting changes. Correcting a pixel is then
+// three byte loads; the RGB565 tables fold the packing in as well.
+
+#ifndef COLORLUT_H
+#define COLORLUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+typedef struct
+{
+    bool gamma;          // LED gamma 2.2, so input values are perceptually even
+    uint8_t brightness;  // global scale, 255 = full
+    uint8_t white_r;     // white balance, per channel scale, 255 = unchanged
+    uint8_t white_g;
+    uint8_t white_b;
+} colorlut_config_t;
+
+#define COLORLUT_CONFIG_DEFAULT() \
+    {                             \
+        .gamma = true,            \
+        .brightness = 255,        \
+        .white_r = 255,           \
+        .white_g = 255,           \
+        .white_b = 255,           \
+    }
+
+typedef struct
+{
+    uint8_t r[256];
+    uint8_t g[256];
+    uint8_t b[256];
+    uint16_t r565[256]; // corrected value already in its RGB565 bit field
+    uint16_t g565[256];
+    uint16_t b565[256];
+} colorlut_t;
+
+// Gamma 2.2 of an 8-bit value, the table colorlut_build starts from.
+extern const uint8_t colorlut_gamma22[256];
+
+void colorlut_build(colorlut_t *lut, const colorlut_config_t *config);
+
+static inline rpio_rgb_t colorlut_map(const colorlut_t *lut, rpio_rgb_t c)
+{
+    rpio_rgb_t out = {.r = lut->r[c.r], .g = lut->g[c.g], .b = lut->b[c.b]};
+    return out;
+}
+
+// Corrects `count` pixels from `src` into `dst`; they may be the same buffer.
+void colorlut_apply(const colorlut_t *lut, rpio_rgb_t *dst, const rpio_rgb_t *src, size_t count);
+
+// Corrects and packs `count` pixels to RGB565 in one pass, like rgb565_pack.
+void colorlut_pack_rgb565(const colorlut_t *lut, uint16_t *dst, const rpio_rgb_t *src, size_t count);
+
+#endif // COLORLUT_H
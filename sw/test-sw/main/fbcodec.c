@@ -0,0 +1,215 @@
+// fbcodec.c
+// Row-wise RLE / XOR-delta codec, see fbcodec.h
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "fbcodec.h"
+
+#define TOKEN_RUN     0x80
+#define TOKEN_MAX_LEN 128
+
+static inline rpio_rgb_t px_at(const rpio_rgb_t *src, const rpio_rgb_t *ref, size_t i)
+{
+    rpio_rgb_t p = src[i];
+    if (ref)
+    {
+        p.r ^= ref[i].r;
+        p.g ^= ref[i].g;
+        p.b ^= ref[i].b;
+    }
+    return p;
+}
+
+static inline bool px_eq(rpio_rgb_t a, rpio_rgb_t b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+/* Token stream for one row of `src` (XORed with `ref` when given). With `out`
+ * NULL nothing is written and only the size is returned. */
+static size_t rle_row(uint8_t *out, const rpio_rgb_t *src, const rpio_rgb_t *ref, uint16_t w)
+{
+    size_t size = 0;
+    size_t i = 0;
+
+    while (i < w)
+    {
+        rpio_rgb_t p = px_at(src, ref, i);
+        size_t run = 1;
+        while (i + run < w && run < TOKEN_MAX_LEN && px_eq(px_at(src, ref, i + run), p))
+            run++;
+
+        if (run >= 2)
+        {
+            if (out)
+            {
+                out[size] = TOKEN_RUN | (uint8_t)(run - 1);
+                memcpy(&out[size + 1], &p, sizeof(p));
+            }
+            size += 1 + sizeof(p);
+            i += run;
+            continue;
+        }
+
+        /* literal until the next run starts */
+        size_t lit = 1;
+        while (i + lit < w && lit < TOKEN_MAX_LEN)
+        {
+            if (i + lit + 1 < w && px_eq(px_at(src, ref, i + lit), px_at(src, ref, i + lit + 1)))
+                break;
+            lit++;
+        }
+        if (out)
+        {
+            out[size] = (uint8_t)(lit - 1);
+            for (size_t k = 0; k < lit; k++)
+            {
+                rpio_rgb_t q = px_at(src, ref, i + k);
+                memcpy(&out[size + 1 + k * sizeof(q)], &q, sizeof(q));
+            }
+        }
+        size += 1 + lit * sizeof(rpio_rgb_t);
+        i += lit;
+    }
+    return size;
+}
+
+size_t fbcodec_encode(uint8_t *dst, size_t dst_cap,
+                      const rpio_rgb_t *src, size_t src_stride,
+                      const rpio_rgb_t *ref, size_t ref_stride,
+                      uint16_t w, uint16_t h)
+{
+    size_t size = 0;
+    size_t raw = (size_t)w * sizeof(rpio_rgb_t);
+
+    for (uint16_t row = 0; row < h; row++)
+    {
+        const rpio_rgb_t *s = src + (size_t)row * src_stride;
+        const rpio_rgb_t *r = ref ? ref + (size_t)row * ref_stride : NULL;
+
+        fbcodec_row_mode_t mode = FBCODEC_ROW_RAW;
+        size_t cost = raw;
+        if (r && memcmp(s, r, raw) == 0)
+        {
+            mode = FBCODEC_ROW_SAME;
+            cost = 0;
+        }
+        else
+        {
+            size_t c = rle_row(NULL, s, NULL, w);
+            if (c < cost)
+            {
+                mode = FBCODEC_ROW_RLE;
+                cost = c;
+            }
+            if (r)
+            {
+                c = rle_row(NULL, s, r, w);
+                if (c < cost)
+                {
+                    mode = FBCODEC_ROW_XOR;
+                    cost = c;
+                }
+            }
+        }
+
+        if (size + 1 + cost > dst_cap)
+            return 0;
+        dst[size++] = (uint8_t)mode;
+
+        switch (mode)
+        {
+        case FBCODEC_ROW_RAW:
+            memcpy(&dst[size], s, raw);
+            break;
+        case FBCODEC_ROW_RLE:
+            rle_row(&dst[size], s, NULL, w);
+            break;
+        case FBCODEC_ROW_XOR:
+            rle_row(&dst[size], s, r, w);
+            break;
+        case FBCODEC_ROW_SAME:
+            break;
+        }
+        size += cost;
+    }
+    return size;
+}
+
+int fbcodec_decode(rpio_rgb_t *dst, size_t dst_stride,
+                   const rpio_rgb_t *ref, size_t ref_stride,
+                   uint16_t w, uint16_t h,
+                   const uint8_t *src, size_t len)
+{
+    size_t pos = 0;
+    size_t raw = (size_t)w * sizeof(rpio_rgb_t);
+
+    for (uint16_t row = 0; row < h; row++)
+    {
+        rpio_rgb_t *d = dst + (size_t)row * dst_stride;
+        const rpio_rgb_t *r = ref ? ref + (size_t)row * ref_stride : NULL;
+
+        if (pos >= len)
+            return -1;
+        uint8_t mode = src[pos++];
+
+        switch (mode)
+        {
+        case FBCODEC_ROW_RAW:
+            if (len - pos < raw)
+                return -1;
+            memcpy(d, &src[pos], raw);
+            pos += raw;
+            break;
+
+        case FBCODEC_ROW_SAME:
+            if (r == NULL)
+                return -1;
+            if (r != d)
+                memmove(d, r, raw);
+            break;
+
+        case FBCODEC_ROW_RLE:
+        case FBCODEC_ROW_XOR:
+        {
+            bool xor = mode == FBCODEC_ROW_XOR;
+            if (xor && r == NULL)
+                return -1;
+
+            size_t x = 0;
+            while (x < w)
+            {
+                if (pos >= len)
+                    return -1;
+                uint8_t token = src[pos++];
+                size_t n = (size_t)(token & (TOKEN_RUN - 1)) + 1;
+                bool run = (token & TOKEN_RUN) != 0;
+                size_t need = (run ? 1 : n) * sizeof(rpio_rgb_t);
+                if (x + n > w || len - pos < need)
+                    return -1;
+
+                for (size_t k = 0; k < n; k++)
+                {
+                    rpio_rgb_t p;
+                    memcpy(&p, &src[pos + (run ? 0 : k * sizeof(p))], sizeof(p));
+                    if (xor)
+                    {
+                        p.r ^= r[x + k].r;
+                        p.g ^= r[x + k].g;
+                        p.b ^= r[x + k].b;
+                    }
+                    d[x + k] = p;
+                }
+                pos += need;
+                x += n;
+            }
+            break;
+        }
+
+        default:
+            return -1;
+        }
+    }
+    return pos == len ? 0 : -1;
+}
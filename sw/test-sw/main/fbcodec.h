@@ -0,0 +1,47 @@
+// fbcodec.h
+// Row-wise compression for rphub75_fb_draw_packed_cmd, shared by the host
+// encoder and the reference decoder.
+//
+// Every row starts with a mode byte:
+//   FBCODEC_ROW_RAW   w RGB888 pixels follow
+//   FBCODEC_ROW_RLE   tokens (below) encoding the w pixels
+//   FBCODEC_ROW_XOR   tokens encoding w values XORed onto the reference row
+//   FBCODEC_ROW_SAME  no data, the row equals the reference row
+// A token byte t < 0x80 is followed by t + 1 literal pixels, t >= 0x80 by one
+// pixel repeated (t & 0x7F) + 1 times.
+
+#ifndef FBCODEC_H
+#define FBCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+typedef enum
+{
+    FBCODEC_ROW_RAW = 0,
+    FBCODEC_ROW_RLE = 1,
+    FBCODEC_ROW_XOR = 2,
+    FBCODEC_ROW_SAME = 3,
+} fbcodec_row_mode_t;
+
+// Largest possible encoding of a w x h rectangle (every row raw)
+#define FBCODEC_MAX_SIZE(w, h) ((size_t)(h) * (1 + (size_t)(w) * sizeof(rpio_rgb_t)))
+
+// Encodes a w x h rectangle, picking the cheapest mode per row. Strides are in
+// pixels. `ref` is what the device's reference framebuffer holds at the same
+// place; when NULL only RAW and RLE rows are produced. Returns the encoded
+// size, or 0 if it does not fit into `dst_cap`.
+size_t fbcodec_encode(uint8_t *dst, size_t dst_cap,
+                      const rpio_rgb_t *src, size_t src_stride,
+                      const rpio_rgb_t *ref, size_t ref_stride,
+                      uint16_t w, uint16_t h);
+
+// Reference decoder. `ref` may alias `dst` (delta against the target itself).
+// Returns 0 on success, -1 if `src` is malformed or has the wrong size.
+int fbcodec_decode(rpio_rgb_t *dst, size_t dst_stride,
+                   const rpio_rgb_t *ref, size_t ref_stride,
+                   uint16_t w, uint16_t h,
+                   const uint8_t *src, size_t len);
+
+#endif // FBCODEC_H
@@ -0,0 +1,196 @@
+// frame_sched.c
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "frame_sched.h"
+
+static const char *TAG = "FRAME_SCHED";
+
+// Waits shorter than this are spun instead of handed to the timer task
+#define FRAME_SCHED_SPIN_US 50
+
+static void frame_sched_wake(void *arg)
+{
+    frame_sched_t *s = arg;
+    xTaskNotifyGive(s->waiter);
+}
+
+esp_err_t frame_sched_init(frame_sched_t *s, const frame_sched_config_t *config)
+{
+    if (s == NULL || config == NULL || config->target_fps == 0 || config->update_hz == 0 ||
+        config->max_updates == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(s, 0, sizeof(*s));
+    s->config = *config;
+    s->period_us = 1000000 / config->target_fps;
+    s->step_us = 1000000 / config->update_hz;
+
+    esp_timer_create_args_t args = {
+        .callback = frame_sched_wake,
+        .arg = s,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "frame_sched",
+        .skip_unhandled_events = true,
+    };
+    esp_err_t ret = esp_timer_create(&args, &s->timer);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "frame_sched_init: esp_timer_create failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    frame_sched_reset_stats(s);
+    return ESP_OK;
+}
+
+void frame_sched_deinit(frame_sched_t *s)
+{
+    if (s == NULL || s->timer == NULL)
+        return;
+    esp_timer_stop(s->timer);
+    esp_timer_delete(s->timer);
+    s->timer = NULL;
+}
+
+/* Sleeps on a one-shot esp_timer, which wakes with microsecond resolution
+ * where vTaskDelay would round to the RTOS tick. */
+static void sleep_until(frame_sched_t *s, int64_t until_us)
+{
+    int64_t remaining = until_us - esp_timer_get_time();
+    if (remaining > FRAME_SCHED_SPIN_US)
+    {
+        s->waiter = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, 0); // drop a stale wake-up
+        if (esp_timer_start_once(s->timer, (uint64_t)(remaining - FRAME_SCHED_SPIN_US)) == ESP_OK)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    while (esp_timer_get_time() < until_us)
+        ;
+}
+
+static void record_frame(frame_sched_stats_t *st, int64_t frame_us)
+{
+    uint32_t us = frame_us > UINT32_MAX ? UINT32_MAX : (uint32_t)frame_us;
+    uint32_t bucket = us / FRAME_SCHED_BUCKET_US;
+    if (bucket >= FRAME_SCHED_BUCKETS)
+        bucket = FRAME_SCHED_BUCKETS - 1;
+
+    st->frames++;
+    st->total_us += us;
+    if (us < st->min_us)
+        st->min_us = us;
+    if (us > st->max_us)
+        st->max_us = us;
+    st->hist[bucket]++;
+}
+
+uint32_t frame_sched_begin(frame_sched_t *s)
+{
+    int64_t now = esp_timer_get_time();
+    if (s->next_us == 0)
+    {
+        /* first frame: start the clocks, run one step */
+        s->next_us = now + s->period_us;
+        s->last_us = now;
+        s->accum_us = 0;
+        return 1;
+    }
+
+    if (now < s->next_us)
+    {
+        sleep_until(s, s->next_us);
+        now = esp_timer_get_time();
+    }
+    else if (now - s->next_us >= s->period_us)
+    {
+        /* a whole slot or more behind */
+        int64_t missed = (now - s->next_us) / s->period_us;
+        s->stats.late++;
+        if (s->config.skip_late)
+        {
+            s->stats.skipped += (uint32_t)missed;
+            s->next_us += missed * s->period_us;
+        }
+    }
+    s->next_us += s->period_us;
+
+    record_frame(&s->stats, now - s->last_us);
+    s->accum_us += now - s->last_us;
+    s->last_us = now;
+
+    /* fixed steps; under load the simulation slows down rather than running
+     * ever more steps per frame */
+    uint32_t steps = (uint32_t)(s->accum_us / s->step_us);
+    if (steps > s->config.max_updates)
+    {
+        s->stats.dropped_steps += steps - s->config.max_updates;
+        steps = s->config.max_updates;
+        s->accum_us %= s->step_us;
+    }
+    else
+    {
+        s->accum_us -= (int64_t)steps * s->step_us;
+    }
+    return steps;
+}
+
+void frame_sched_end(frame_sched_t *s)
+{
+    int64_t work = esp_timer_get_time() - s->last_us;
+    uint32_t us = work > UINT32_MAX ? UINT32_MAX : (uint32_t)work;
+    s->stats.work_total_us += us;
+    if (us > s->stats.work_max_us)
+        s->stats.work_max_us = us;
+}
+
+float frame_sched_step_s(const frame_sched_t *s)
+{
+    return (float)s->step_us / 1e6f;
+}
+
+float frame_sched_alpha(const frame_sched_t *s)
+{
+    return (float)s->accum_us / (float)s->step_us;
+}
+
+void frame_sched_get_stats(const frame_sched_t *s, frame_sched_stats_t *out)
+{
+    *out = s->stats;
+}
+
+void frame_sched_reset_stats(frame_sched_t *s)
+{
+    memset(&s->stats, 0, sizeof(s->stats));
+    s->stats.min_us = UINT32_MAX;
+}
+
+uint32_t frame_sched_percentile_us(const frame_sched_stats_t *stats, uint32_t percent)
+{
+    if (stats->frames == 0)
+        return 0;
+
+    uint64_t rank = ((uint64_t)stats->frames * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < FRAME_SCHED_BUCKETS; b++)
+    {
+        seen += stats->hist[b];
+        if (seen >= rank && seen > 0)
+            return b == FRAME_SCHED_BUCKETS - 1 ? stats->max_us : (b + 1) * FRAME_SCHED_BUCKET_US;
+    }
+    return stats->max_us;
+}
+
+void frame_sched_print(const frame_sched_t *s)
+{
+    const frame_sched_stats_t *st = &s->stats;
+    if (st->frames == 0)
+        return;
+    ESP_LOGI(TAG, "%lu frames: min %lu us, avg %llu us, p99 <%lu us, max %lu us, busy avg %llu us / max %lu us",
+             (unsigned long)st->frames, (unsigned long)st->min_us,
+             (unsigned long long)(st->total_us / st->frames),
+             (unsigned long)frame_sched_percentile_us(st, 99), (unsigned long)st->max_us,
+             (unsigned long long)(st->work_total_us / st->frames), (unsigned long)st->work_max_us);
+    ESP_LOGI(TAG, "late %lu, skipped slots %lu, dropped steps %lu",
+             (unsigned long)st->late, (unsigned long)st->skipped, (unsigned long)st->dropped_steps);
+}
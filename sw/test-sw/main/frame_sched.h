@@ -0,0 +1,94 @@
+// frame_sched.h
+// Frame pacing on esp_timer: renders at a target rate with microsecond wake-ups
+// instead of whole RTOS ticks, runs the simulation in fixed steps and reports
+// frame time statistics.
+//
+//   frame_sched_t sched;
+//   frame_sched_config_t config = FRAME_SCHED_CONFIG_DEFAULT();
+//   frame_sched_init(&sched, &config);
+//   while (1)
+//   {
+//       uint32_t steps = frame_sched_begin(&sched);  // waits for the frame slot
+//       while (steps--)
+//           update(frame_sched_step_s(&sched));
+//       render(frame_sched_alpha(&sched));           // interpolate between steps
+//       frame_sched_end(&sched);
+//   }
+
+#ifndef FRAME_SCHED_H
+#define FRAME_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define FRAME_SCHED_BUCKET_US 250 // Frame time histogram resolution
+#define FRAME_SCHED_BUCKETS   128 // Frames longer than 32 ms share the last bucket
+
+typedef struct
+{
+    uint32_t target_fps;  // render rate
+    uint32_t update_hz;   // fixed simulation rate
+    uint8_t max_updates;  // steps per frame before simulation time is dropped
+    bool skip_late;       // a frame later than a whole period skips the missed
+                          // slots instead of rendering them back to back
+} frame_sched_config_t;
+
+#define FRAME_SCHED_CONFIG_DEFAULT() \
+    {                                \
+        .target_fps = 60,            \
+        .update_hz = 60,             \
+        .max_updates = 4,            \
+        .skip_late = true,           \
+    }
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t late;            // frames that started a whole period late
+    uint32_t skipped;         // frame slots skipped because of that
+    uint32_t dropped_steps;   // simulation steps dropped by max_updates
+    uint32_t min_us;          // frame time: start to start
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t work_max_us;     // begin to end, the part the frame is busy
+    uint64_t work_total_us;
+    uint32_t hist[FRAME_SCHED_BUCKETS];
+} frame_sched_stats_t;
+
+typedef struct
+{
+    frame_sched_config_t config;
+    int64_t period_us;
+    int64_t step_us;
+    int64_t next_us;          // start of the next frame slot
+    int64_t last_us;          // start of the current frame
+    int64_t accum_us;         // simulation time not yet stepped
+    esp_timer_handle_t timer;
+    TaskHandle_t waiter;
+    frame_sched_stats_t stats;
+} frame_sched_t;
+
+esp_err_t frame_sched_init(frame_sched_t *s, const frame_sched_config_t *config);
+void frame_sched_deinit(frame_sched_t *s);
+
+// Sleeps until the next frame slot and returns how many fixed steps to run.
+uint32_t frame_sched_begin(frame_sched_t *s);
+// Marks the frame as done, for the work time statistics.
+void frame_sched_end(frame_sched_t *s);
+
+// Length of one fixed step in seconds.
+float frame_sched_step_s(const frame_sched_t *s);
+// Fraction of a step between the last update and now, for interpolation.
+float frame_sched_alpha(const frame_sched_t *s);
+
+void frame_sched_get_stats(const frame_sched_t *s, frame_sched_stats_t *out);
+void frame_sched_reset_stats(frame_sched_t *s);
+// Frame time below which `percent` of the frames fall, to bucket resolution.
+uint32_t frame_sched_percentile_us(const frame_sched_stats_t *stats, uint32_t percent);
+void frame_sched_print(const frame_sched_t *s);
+
+#endif // FRAME_SCHED_H
@@ -9,46 +9,44 @@
 #include "sdkconfig.h"
 
 #include "rphub75.h"
+#include "rphub75_shadow.h"
+#include "rphub75_stats.h"
+#include "rphub75_input.h"
+#include "rphub75_link.h"
+#include "frame_sched.h"
 #include "colors.h"
+#include "platformer.h"
+#include "rphub75_bench.h"
+#include "rphub75_anim.h"
+
+// Define to run the benchmark suite instead of the game
+// #define RUN_BENCHMARK
+
+// Define to loop the RPAN animation flashed to the "anim" partition instead
+// of the game (see host/anim_encode.c)
+// #define RUN_ANIMATION
+
+// Define to move the link to the fastest dual or quad mode the board passes.
+// USB input then only arrives through rphub75_input_poll.
+// #define TRAIN_LINK
 
 // Button pins for platformer controls
 #define BUTTON_JUMP_GPIO 16  // Red button - Jump
 #define BUTTON_RIGHT_GPIO 42 // Green button - Move Right
 #define BUTTON_LEFT_GPIO 18  // Blue button - Move Left
 
-// Platformer physics parameters
-#define GRAVITY 100
-#define PLAYER_JUMP_SPD 40.0f
-#define PLAYER_HOR_SPD 20.0f
-// Player structure
-typedef struct
-{
-    float position_x;
-    float position_y;
-    float speed;
-    bool canJump;
-} Player;
+// HID usage codes of the keyboard controls
+#define KEY_RIGHT 0x4F
+#define KEY_LEFT  0x50
+#define KEY_UP    0x52
+#define KEY_SPACE 0x2C
 
-// Environment item structure
-typedef struct
-{
-    int x;
-    int y;
-    int width;
-    int height;
-} EnvItem;
+// Link statistics are logged and reset this often
+#define STATS_PERIOD_FRAMES 600
 
 // Global player instance
-Player player = {32.0f, 20.0f, 0.0f, false};
-
-// Environment items (platforms)
-EnvItem envItems[] = {
-    {0, 56, 64, 8},  // Ground platform
-    {16, 44, 32, 4}, // Middle platform
-    {8, 32, 16, 4},  // Left platform
-    {40, 32, 16, 4}  // Right platform
-};
-int envItemsLength = sizeof(envItems) / sizeof(envItems[0]);
+Player player = PLAYER_START;
+Level level;
 
 static const char *TAG = "RPHUB75";
 
@@ -83,130 +81,77 @@ esp_err_t initialize_buttons(void)
     return ESP_OK;
 }
 
-void update_player(Player *player, EnvItem *envItems, int envItemsLength,
-                   float delta)
-{
-    // Read button states
-    bool leftPressed = (gpio_get_level(BUTTON_LEFT_GPIO) == 0);
-    bool rightPressed = (gpio_get_level(BUTTON_RIGHT_GPIO) == 0);
-    bool jumpPressed = (gpio_get_level(BUTTON_JUMP_GPIO) == 0);
-
-    // Horizontal movement
-    if (leftPressed)
-        player->position_x -= PLAYER_HOR_SPD * delta;
-    if (rightPressed)
-        player->position_x += PLAYER_HOR_SPD * delta;
-
-    // Jumping
-    if (jumpPressed && player->canJump)
-    {
-        player->speed = -PLAYER_JUMP_SPD;
-        player->canJump = false;
-    }
-
-    // Apply gravity and check collisions
-    bool hitObstacle = false;
-
-    // Temporary position for collision checking
-    float new_y = player->position_y + player->speed * delta;
-
-    for (int i = 0; i < envItemsLength; i++)
-    {
-        EnvItem *ei = &envItems[i];
-
-        // Check if player would collide with this platform
-        // Player is 8x8 pixels, positioned at center-bottom
-        float player_left = player->position_x - 4;
-        float player_right = player->position_x + 4;
-        float player_bottom = new_y + 4; // Bottom of player
-
-        // Platform bounds
-        float platform_left = ei->x;
-        float platform_right = ei->x + ei->width;
-        float platform_top = ei->y;
-
-        // Check if player is above platform and falling onto it
-        if (player_bottom >= platform_top &&
-            player->position_y + 4 <= platform_top && // Was above platform
-            player_right > platform_left && player_left < platform_right &&
-            player->speed >= 0)
-        { // Only check when falling
-
-            hitObstacle = true;
-            player->speed = 0.0f;
-            player->position_y =
-                platform_top - 4; // Position player on top of platform
-            break;
-        }
-    }
+// Controls held on the USB keyboard or gamepad, as of the last report
+static PlayerInput usb_input;
 
-    if (!hitObstacle)
-    {
-        player->position_y = new_y;
-        player->speed += GRAVITY * delta;
-        player->canJump = false;
-    }
-    else
-    {
-        player->canJump = true;
-    }
-
-    // Keep player within screen bounds
-    if (player->position_x < 4)
-        player->position_x = 4;
-    if (player->position_x > RP_HUB75_WIDTH - 4)
-        player->position_x = RP_HUB75_WIDTH - 4;
-    if (player->position_y > RP_HUB75_HEIGHT - 4)
-    {
-        player->position_y = RP_HUB75_HEIGHT - 4;
-        player->speed = 0;
-        player->canJump = true;
-    }
-}
-
-void draw_rectangle(rpio_rgb_t *fb, int x, int y, int width, int height,
-                    uint8_t r, uint8_t g, uint8_t b)
+static void read_usb_input(void)
 {
-    for (int py = y; py < y + height && py < RP_HUB75_HEIGHT; py++)
+    rphub75_input_event_t ev;
+    while (rphub75_input_next(&ev))
     {
-        for (int px = x; px < x + width && px < RP_HUB75_WIDTH; px++)
+        if (ev.type == RPHUB75_INPUT_GAMEPAD)
+        {
+            usb_input.left = ev.gamepad.lx < 64;
+            usb_input.right = ev.gamepad.lx > 192;
+            usb_input.jump = (ev.gamepad.buttons & RPHUB75_PAD_A) != 0;
+        }
+        else if (ev.type == RPHUB75_INPUT_KEYBOARD)
         {
-            if (px >= 0 && py >= 0)
+            usb_input = (PlayerInput){0};
+            for (int i = 0; i < 6; i++)
             {
-                int index = py * RP_HUB75_WIDTH + px;
-                fb[index].r = r;
-                fb[index].g = g;
-                fb[index].b = b;
+                uint8_t key = ev.keyboard.keys[i];
+                usb_input.left |= key == KEY_LEFT;
+                usb_input.right |= key == KEY_RIGHT;
+                usb_input.jump |= key == KEY_UP || key == KEY_SPACE;
             }
         }
     }
 }
 
-void update_framebuffer(rpio_rgb_t *fb, Player *player, EnvItem *envItems,
-                        int envItemsLength)
+// Buttons are active low; the USB controls work alongside them
+static PlayerInput read_buttons(void)
 {
-    // Clear framebuffer (transparent/black background)
-    memset(fb, 0, sizeof(rpio_rgb_t) * RP_HUB75_WIDTH * RP_HUB75_HEIGHT);
-
-    // Draw platforms (gray)
-    for (int i = 0; i < envItemsLength; i++)
-    {
-        draw_rectangle(fb, envItems[i].x, envItems[i].y, envItems[i].width,
-                       envItems[i].height, 128, 128, 128); // Gray color
-    }
-
-    // Draw player (red) - 8x8 pixels centered at player position
-    int player_x = (int)player->position_x - 4;
-    int player_y = (int)player->position_y - 4;
-    draw_rectangle(fb, player_x, player_y, 8, 8, 255, 0, 0); // Red color
+    read_usb_input();
+    PlayerInput input = {
+        .left = gpio_get_level(BUTTON_LEFT_GPIO) == 0 || usb_input.left,
+        .right = gpio_get_level(BUTTON_RIGHT_GPIO) == 0 || usb_input.right,
+        .jump = gpio_get_level(BUTTON_JUMP_GPIO) == 0 || usb_input.jump,
+    };
+    return input;
 }
+
 esp_err_t ret;
 
+// Device framebuffers used for double buffering
+static const uint8_t swap_chain[] = {0, 1};
+
 void app_main(void)
 {
     ESP_LOGI(TAG, "Starting RPHUB75 example");
     spi_init();
     spi_set_internal_rx_capacity(0);
+#ifdef TRAIN_LINK
+    rphub75_link_train_config_t train_config = RPHUB75_LINK_TRAIN_CONFIG_DEFAULT();
+    rphub75_link_train(&train_config, NULL);
+#endif
+    display_init();
+#ifdef RUN_BENCHMARK
+    rphub75_bench_config_t bench_config = RPHUB75_BENCH_CONFIG_DEFAULT();
+    rphub75_bench_run(&bench_config);
+    while (1)
+    {
+        vTaskDelay(portMAX_DELAY);
+    }
+#endif
+#ifdef RUN_ANIMATION
+    rphub75_anim_t anim;
+    if (rphub75_anim_open_partition(&anim, "anim") == ESP_OK)
+    {
+        rphub75_anim_play(&anim, 0, 1, 0);
+        rphub75_anim_close(&anim);
+    }
+#endif
     // Initialize ADC for potentiometers
     // Initialize buttons for platformer controls
     ret = initialize_buttons();
@@ -215,8 +160,10 @@ void app_main(void)
         return;
     }
     size_t buffer_size = (size_t)RP_HUB75_WIDTH * (size_t)RP_HUB75_HEIGHT * sizeof(rpio_rgb_t);
-    rpio_rgb_t *buffer = pvPortMalloc(buffer_size);
-    if (buffer == NULL)
+    rpio_rgb_t *buffer = rphub75_fb_alloc(RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    shadowfb_t shadow;
+    if (buffer == NULL ||
+        shadowfb_init(&shadow, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, swap_chain, sizeof(swap_chain)) != ESP_OK)
     {
         ESP_LOGE(TAG, "Failed to allocate %zu bytes for framebuffer", buffer_size);
         while (1)
@@ -224,13 +171,27 @@ void app_main(void)
             vTaskDelay(portMAX_DELAY);
         }
     }
+    shadowfb_set_compression(&shadow, true);
+    if (level_init(&level, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, envItems, envItemsLength) != ESP_OK)
+    {
+        return;
+    }
     for (int i = 0; i < buffer_size / sizeof(rpio_rgb_t); i++)
     {
         buffer[i] = color_black;
     }
-    TickType_t last_frame_time = xTaskGetTickCount();
-    const TickType_t frame_delay = pdMS_TO_TICKS(16); // ~60 FPS
+    frame_sched_t sched;
+    frame_sched_config_t sched_config = FRAME_SCHED_CONFIG_DEFAULT();
+    if (frame_sched_init(&sched, &sched_config) != ESP_OK)
+    {
+        return;
+    }
     int frame_counter = 0;
+    // State before the last simulation step, only moved on when a step runs
+    // so frames without one keep interpolating between the same two states
+    Player previous = player;
+    // USB reports ride back on the frame transfers
+    rphub75_input_enable(true);
 
     {
         esp_err_t wdt_ret = esp_task_wdt_add(NULL);
@@ -241,17 +202,48 @@ void app_main(void)
     }
     while (1)
     {
-        TickType_t current_time = xTaskGetTickCount();
-        float delta_time = (float)(current_time - last_frame_time) *
-                           portTICK_PERIOD_MS / 1000.0f;
-        last_frame_time = current_time;
+        // Fixed simulation steps, so motion does not depend on how long
+        // the previous frame took
+        uint32_t steps = frame_sched_begin(&sched);
         frame_counter++;
 
-        update_player(&player, envItems, envItemsLength, delta_time);
+        PlayerInput input = read_buttons();
+        for (uint32_t i = 0; i < steps; i++)
+        {
+            previous = player;
+            update_player(&player, &input, &level, fix16_from_float(frame_sched_step_s(&sched)));
+        }
 
-        update_framebuffer(buffer, &player, envItems, envItemsLength);
+        // Draw the player between the last two steps
+        fix16_t alpha = fix16_from_float(frame_sched_alpha(&sched));
+        Player shown = player;
+        shown.position_x = previous.position_x + fix16_mul(player.position_x - previous.position_x, alpha);
+        shown.position_y = previous.position_y + fix16_mul(player.position_y - previous.position_y, alpha);
+
+        // Only the tiles the player moved over are drawn again. A 64x64
+        // frame renders on one core: rphub75_bands.h only pays off on
+        // chained canvases (see raster_scene_256x64_bands in the benchmark).
+        update_framebuffer(buffer, &shown, &level);
+
+        // Only the tiles that changed since this device framebuffer was last
+        // drawn are sent. This is synchronous rather than through the async
+        // worker: the next diff needs to know the frame reached the board,
+        // and a delta of a few tiles costs less than the hand-off.
+        ret = shadowfb_present(&shadow, buffer, NULL);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGW(TAG, "shadowfb_present failed: %s", esp_err_to_name(ret));
+        }
+        // Only costs a transfer when this frame sent nothing to carry the reports
+        rphub75_input_poll(sched.period_us);
+        frame_sched_end(&sched);
 
-        spi_send_data((uint8_t *)buffer,
-                      RP_HUB75_WIDTH * RP_HUB75_HEIGHT * sizeof(rpio_rgb_t));
+        if (frame_counter % STATS_PERIOD_FRAMES == 0)
+        {
+            rphub75_stats_print();
+            rphub75_stats_reset();
+            frame_sched_print(&sched);
+            frame_sched_reset_stats(&sched);
+        }
     }
 }
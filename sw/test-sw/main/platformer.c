@@ -0,0 +1,169 @@
+// platformer.c
+
+#include "platformer.h"
+#include "raster.h"
+#include "colors.h"
+
+// Environment items (platforms)
+EnvItem envItems[] = {
+    {0, 56, 64, 8},  // Ground platform
+    {16, 44, 32, 4}, // Middle platform
+    {8, 32, 16, 4},  // Left platform
+    {40, 32, 16, 4}  // Right platform
+};
+const int envItemsLength = sizeof(envItems) / sizeof(envItems[0]);
+
+// Level tiles
+enum
+{
+    LEVEL_TILE_EMPTY = 0,
+    LEVEL_TILE_PLATFORM,
+};
+
+static const tile_def_t level_tiles[] = {
+    [LEVEL_TILE_EMPTY] = {0, NULL, {.r = 0, .g = 0, .b = 0}},                  // black
+    [LEVEL_TILE_PLATFORM] = {TILE_ONE_WAY, NULL, {.r = 128, .g = 128, .b = 128}}, // gray
+};
+
+esp_err_t level_init(Level *level, int width, int height, const EnvItem *items, int count)
+{
+    int size = 1 << LEVEL_TILE_SHIFT;
+    esp_err_t ret = tilemap_init(&level->map, (uint16_t)((width + size - 1) / size),
+                                 (uint16_t)((height + size - 1) / size), LEVEL_TILE_SHIFT, level_tiles,
+                                 sizeof(level_tiles) / sizeof(level_tiles[0]));
+    if (ret != ESP_OK)
+        return ret;
+
+    // Platforms you can jump through from below and land on from above
+    for (int i = 0; i < count; i++)
+    {
+        tilemap_fill(&level->map, items[i].x, items[i].y, items[i].width, items[i].height,
+                     LEVEL_TILE_PLATFORM);
+    }
+    level->drawn = false;
+    return ESP_OK;
+}
+
+void level_deinit(Level *level)
+{
+    tilemap_deinit(&level->map);
+}
+
+void level_invalidate(Level *level)
+{
+    tilemap_mark_all(&level->map);
+}
+
+static int player_left(const Player *player)
+{
+    return fix16_to_int(player->position_x) - PLAYER_SIZE / 2;
+}
+
+static int player_top(const Player *player)
+{
+    return fix16_to_int(player->position_y) - PLAYER_SIZE / 2;
+}
+
+void level_begin_frame(Level *level, const Player *shown)
+{
+    // Where the player was is background again, where it is gets redrawn
+    if (level->drawn)
+        tilemap_mark(&level->map, level->drawn_x, level->drawn_y, PLAYER_SIZE, PLAYER_SIZE);
+    level->drawn_x = player_left(shown);
+    level->drawn_y = player_top(shown);
+    level->drawn = true;
+    tilemap_mark(&level->map, level->drawn_x, level->drawn_y, PLAYER_SIZE, PLAYER_SIZE);
+}
+
+void level_end_frame(Level *level)
+{
+    tilemap_clear_dirty(&level->map);
+}
+
+void update_player(Player *player, const PlayerInput *input, const Level *level, fix16_t delta)
+{
+    bool leftPressed = input->left;
+    bool rightPressed = input->right;
+    bool jumpPressed = input->jump;
+
+    // Horizontal movement
+    fix16_t dx = 0;
+    if (leftPressed)
+        dx -= fix16_mul(PLAYER_HOR_SPD, delta);
+    if (rightPressed)
+        dx += fix16_mul(PLAYER_HOR_SPD, delta);
+
+    // Jumping
+    if (jumpPressed && player->canJump)
+    {
+        player->speed = -PLAYER_JUMP_SPD;
+        player->canJump = false;
+    }
+
+    // Move the 8x8 player around its position; the tile map stops it on
+    // the platforms it falls onto
+    fix16_t half = fix16_from_int(PLAYER_SIZE / 2);
+    tilemap_body_t body = {
+        .x = player->position_x - half,
+        .y = player->position_y - half,
+        .w = PLAYER_SIZE,
+        .h = PLAYER_SIZE,
+    };
+    uint8_t hit = tilemap_move(&level->map, &body, dx, fix16_mul(player->speed, delta));
+    player->position_x = body.x + half;
+    player->position_y = body.y + half;
+
+    // Apply gravity unless standing
+    if (hit & TILEMAP_HIT_BOTTOM)
+    {
+        player->speed = 0;
+        player->canJump = true;
+    }
+    else
+    {
+        if (hit & TILEMAP_HIT_TOP)
+            player->speed = 0;
+        player->speed += fix16_mul(GRAVITY, delta);
+        player->canJump = false;
+    }
+
+    // Keep player within level bounds
+    fix16_t width = fix16_from_int(level->map.cols << level->map.shift);
+    fix16_t height = fix16_from_int(level->map.rows << level->map.shift);
+    if (player->position_x < half)
+        player->position_x = half;
+    if (player->position_x > width - half)
+        player->position_x = width - half;
+    if (player->position_y > height - half)
+    {
+        player->position_y = height - half;
+        player->speed = 0;
+        player->canJump = true;
+    }
+}
+
+void draw_rectangle(rpio_rgb_t *fb, int x, int y, int width, int height,
+                    uint8_t r, uint8_t g, uint8_t b)
+{
+    raster_t raster;
+    raster_init(&raster, fb, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    raster_fill_rect(&raster, x, y, width, height, rgb(r, g, b));
+}
+
+void platformer_render(raster_t *r, int y0, const Player *player, const Level *level)
+{
+    // Background and platforms where something moved
+    tilemap_render(&level->map, r, 0, y0, true);
+
+    // Draw player (red) - 8x8 pixels centered at player position
+    raster_fill_rect(r, player_left(player), player_top(player) - y0, PLAYER_SIZE, PLAYER_SIZE, color_red);
+}
+
+void update_framebuffer(rpio_rgb_t *fb, const Player *player, Level *level)
+{
+    raster_t raster;
+    raster_init(&raster, fb, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    level_begin_frame(level, player);
+    platformer_render(&raster, 0, player, level);
+    level_end_frame(level);
+}
@@ -0,0 +1,91 @@
+// platformer.h
+// The platformer demo: player physics and rendering into an RGB888 frame.
+// Input is passed in so the same loop runs from the buttons on the board and
+// from scripted input in benchmarks and host builds.
+//
+// The platforms are turned into a tile map (tilemap.h) once, so collisions
+// only look at the tiles around the player and a frame only redraws the
+// tiles the player moved over; neither depends on how many platforms the
+// level has. The frame must therefore keep its contents between frames.
+
+#ifndef PLATFORMER_H
+#define PLATFORMER_H
+
+#include <stdbool.h>
+#include <rpio.h>
+
+#include "rphub75.h"
+#include "raster.h"
+#include "tilemap.h"
+
+// Platformer physics parameters
+#define GRAVITY FIX16(100)
+#define PLAYER_JUMP_SPD FIX16(40.0f)
+#define PLAYER_HOR_SPD FIX16(20.0f)
+#define PLAYER_SIZE 8
+
+// Level tiles are 1 << LEVEL_TILE_SHIFT pixels square
+#define LEVEL_TILE_SHIFT 2
+
+// Player structure, Q16.16 pixels and pixels per second
+typedef struct
+{
+    fix16_t position_x; // center
+    fix16_t position_y;
+    fix16_t speed;
+    bool canJump;
+} Player;
+
+// Environment item structure
+typedef struct
+{
+    int x;
+    int y;
+    int width;
+    int height;
+} EnvItem;
+
+// Buttons held during a frame
+typedef struct
+{
+    bool left;
+    bool right;
+    bool jump;
+} PlayerInput;
+
+#define PLAYER_START {FIX16(32), FIX16(20), 0, false}
+
+// A level: its tiles and where the player was drawn last
+typedef struct
+{
+    tilemap_t map;
+    int drawn_x;
+    int drawn_y;
+    bool drawn;
+} Level;
+
+extern EnvItem envItems[];
+extern const int envItemsLength;
+
+// A width x height pixel level with one-way platforms where the `count`
+// `items` are.
+esp_err_t level_init(Level *level, int width, int height, const EnvItem *items, int count);
+void level_deinit(Level *level);
+// Everything is drawn again, e.g. after the frame was used for something else.
+void level_invalidate(Level *level);
+// Marks the tiles under the player's last and new position for drawing.
+void level_begin_frame(Level *level, const Player *shown);
+void level_end_frame(Level *level);
+
+void update_player(Player *player, const PlayerInput *input, const Level *level, fix16_t delta);
+// Filled rectangle on a RP_HUB75_WIDTH x RP_HUB75_HEIGHT frame, clipped to it.
+// raster.h has the general drawing API.
+void draw_rectangle(rpio_rgb_t *fb, int x, int y, int width, int height,
+                    uint8_t r, uint8_t g, uint8_t b);
+// Renders rows [y0, y0 + r->height) of the frame into `r`, e.g. one band of
+// rphub75_bands.h: the tiles marked by level_begin_frame, then the player.
+void platformer_render(raster_t *r, int y0, const Player *player, const Level *level);
+// One whole frame: level_begin_frame, platformer_render and level_end_frame.
+void update_framebuffer(rpio_rgb_t *fb, const Player *player, Level *level);
+
+#endif // PLATFORMER_H
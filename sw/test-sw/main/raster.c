@@ -0,0 +1,379 @@
+// raster.c
+// Span rasterizer, see raster.h
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "raster.h"
+
+_Static_assert(sizeof(rpio_rgb_t) == 3, "raster.c expects packed RGB888 pixels");
+
+static inline bool same_color(rpio_rgb_t a, rpio_rgb_t b)
+{
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+static inline rpio_rgb_t *pixel_at(raster_t *r, int x, int y)
+{
+    return &r->pixels[(size_t)y * r->stride + x];
+}
+
+/* Clips x/y/w/h to the raster. Returns false when nothing is left. */
+static bool clip_rect(const raster_t *r, int *x, int *y, int *w, int *h)
+{
+    if (*x < 0)
+    {
+        *w += *x;
+        *x = 0;
+    }
+    if (*y < 0)
+    {
+        *h += *y;
+        *y = 0;
+    }
+    if (*w > r->width - *x)
+        *w = r->width - *x;
+    if (*h > r->height - *y)
+        *h = r->height - *y;
+    return *w > 0 && *h > 0;
+}
+
+void raster_init(raster_t *r, rpio_rgb_t *pixels, int width, int height)
+{
+    r->pixels = pixels;
+    r->width = width;
+    r->height = height;
+    r->stride = width;
+}
+
+/* Four pixels are exactly three words:
+ *   w0 = r g b r, w1 = g b r g, w2 = b r g b
+ * Once the destination is word aligned the span is written 12 bytes at a time
+ * from that pattern. */
+void raster_fill_span(rpio_rgb_t *dst, size_t count, rpio_rgb_t color)
+{
+    size_t i = 0;
+    while (i < count && ((uintptr_t)&dst[i] & 3) != 0)
+        dst[i++] = color;
+
+    if (count - i >= 4)
+    {
+        const rpio_rgb_t quad[4] = {color, color, color, color};
+        uint32_t w[3];
+        memcpy(w, quad, sizeof(w));
+
+        uint8_t *out = __builtin_assume_aligned(&dst[i], 4);
+        for (; i + 4 <= count; i += 4)
+        {
+            memcpy(out, w, sizeof(w));
+            out += sizeof(w);
+        }
+    }
+
+    for (; i < count; i++)
+        dst[i] = color;
+}
+
+void raster_clear(raster_t *r, rpio_rgb_t color)
+{
+    raster_fill_rect(r, 0, 0, r->width, r->height, color);
+}
+
+void raster_hline(raster_t *r, int x, int y, int w, rpio_rgb_t color)
+{
+    int h = 1;
+    if (clip_rect(r, &x, &y, &w, &h))
+        raster_fill_span(pixel_at(r, x, y), (size_t)w, color);
+}
+
+void raster_vline(raster_t *r, int x, int y, int h, rpio_rgb_t color)
+{
+    int w = 1;
+    if (!clip_rect(r, &x, &y, &w, &h))
+        return;
+    rpio_rgb_t *p = pixel_at(r, x, y);
+    for (int i = 0; i < h; i++, p += r->stride)
+        *p = color;
+}
+
+void raster_fill_rect(raster_t *r, int x, int y, int w, int h, rpio_rgb_t color)
+{
+    if (!clip_rect(r, &x, &y, &w, &h))
+        return;
+
+    /* the first row is filled span-wise, the others are copies of it */
+    rpio_rgb_t *first = pixel_at(r, x, y);
+    raster_fill_span(first, (size_t)w, color);
+    if (w == r->stride)
+    {
+        /* whole rows: the copy can run across row boundaries in one go */
+        for (int done = 1; done < h;)
+        {
+            int n = done < h - done ? done : h - done;
+            memcpy(first + (size_t)done * w, first, (size_t)n * w * sizeof(rpio_rgb_t));
+            done += n;
+        }
+        return;
+    }
+    rpio_rgb_t *row = first;
+    for (int i = 1; i < h; i++)
+    {
+        row += r->stride;
+        memcpy(row, first, (size_t)w * sizeof(rpio_rgb_t));
+    }
+}
+
+void raster_rect(raster_t *r, int x, int y, int w, int h, rpio_rgb_t color)
+{
+    if (w <= 0 || h <= 0)
+        return;
+    raster_hline(r, x, y, w, color);
+    if (h > 1)
+        raster_hline(r, x, y + h - 1, w, color);
+    if (h > 2)
+    {
+        raster_vline(r, x, y + 1, h - 2, color);
+        if (w > 1)
+            raster_vline(r, x + w - 1, y + 1, h - 2, color);
+    }
+}
+
+/* Steps of a line along its minor axis after k steps along the major one,
+ * exactly as the loop in raster_line rounds them. */
+static inline int64_t line_minor(int64_t k, int64_t major, int64_t minor)
+{
+    return (2 * k * minor + major) / (2 * major);
+}
+
+/* Steps along the major axis needed before the minor one has moved m times. */
+static inline int64_t line_minor_inverse(int64_t m, int64_t major, int64_t minor)
+{
+    if (m == 0)
+        return 0;
+    return (major * (2 * m - 1) + 2 * minor - 1) / (2 * minor);
+}
+
+/* Moves the start of a line that is not entirely on the raster forward to
+ * the first step where it can be, updating the error term to match. Bands of
+ * a larger frame cut most of a long line away, and this keeps them from
+ * walking it. False when the line never gets there. */
+static bool line_enter(const raster_t *r, int *x0, int *y0, int x1, int y1, int dx, int dy, int *err)
+{
+    int64_t ady = -dy;
+    int64_t need_x = x1 > *x0 ? (*x0 < 0 ? -(int64_t)*x0 : 0) : (*x0 >= r->width ? (int64_t)*x0 - r->width + 1 : 0);
+    int64_t need_y = y1 > *y0 ? (*y0 < 0 ? -(int64_t)*y0 : 0) : (*y0 >= r->height ? (int64_t)*y0 - r->height + 1 : 0);
+    if (need_x == 0 && need_y == 0)
+        return true;
+
+    int64_t k, steps_x, steps_y;
+    if (ady >= dx)
+    {
+        if (need_x > dx)
+            return false;
+        k = need_y > line_minor_inverse(need_x, ady, dx) ? need_y : line_minor_inverse(need_x, ady, dx);
+        if (k > ady)
+            return false;
+        steps_y = k;
+        steps_x = line_minor(k, ady, dx);
+    }
+    else
+    {
+        if (need_y > ady)
+            return false;
+        k = need_x > line_minor_inverse(need_y, dx, ady) ? need_x : line_minor_inverse(need_y, dx, ady);
+        if (k > dx)
+            return false;
+        steps_x = k;
+        steps_y = line_minor(k, dx, ady);
+    }
+    *x0 += (int)(x1 > *x0 ? steps_x : -steps_x);
+    *y0 += (int)(y1 > *y0 ? steps_y : -steps_y);
+    *err = (int)(dx + dy + steps_x * dy + steps_y * dx);
+    return true;
+}
+
+void raster_line(raster_t *r, int x0, int y0, int x1, int y1, rpio_rgb_t color)
+{
+    if (y0 == y1)
+    {
+        int x = x0 < x1 ? x0 : x1;
+        raster_hline(r, x, y0, (x0 < x1 ? x1 - x0 : x0 - x1) + 1, color);
+        return;
+    }
+    if (x0 == x1)
+    {
+        int y = y0 < y1 ? y0 : y1;
+        raster_vline(r, x0, y, (y0 < y1 ? y1 - y0 : y0 - y1) + 1, color);
+        return;
+    }
+
+    int dx = x1 > x0 ? x1 - x0 : x0 - x1;
+    int dy = y1 > y0 ? y0 - y1 : y1 - y0; // negative
+    int sx = x0 < x1 ? 1 : -1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+
+    /* lines fully on the raster, the common case, skip the per-pixel test */
+    int min_x = x0 < x1 ? x0 : x1;
+    int max_x = x0 < x1 ? x1 : x0;
+    int min_y = y0 < y1 ? y0 : y1;
+    int max_y = y0 < y1 ? y1 : y0;
+    bool inside = min_x >= 0 && min_y >= 0 && max_x < r->width && max_y < r->height;
+    if (!inside && (max_x < 0 || max_y < 0 || min_x >= r->width || min_y >= r->height))
+        return;
+
+    if (!inside && !line_enter(r, &x0, &y0, x1, y1, dx, dy, &err))
+        return;
+
+    for (;;)
+    {
+        if (inside || ((unsigned)x0 < (unsigned)r->width && (unsigned)y0 < (unsigned)r->height))
+            *pixel_at(r, x0, y0) = color;
+        else if ((sx > 0 ? x0 >= r->width : x0 < 0) || (sy > 0 ? y0 >= r->height : y0 < 0))
+            break; // left the raster for good
+        if (x0 == x1 && y0 == y1)
+            break;
+        int e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static inline void plot(raster_t *r, int x, int y, rpio_rgb_t color, bool inside)
+{
+    if (inside || ((unsigned)x < (unsigned)r->width && (unsigned)y < (unsigned)r->height))
+        *pixel_at(r, x, y) = color;
+}
+
+void raster_circle(raster_t *r, int cx, int cy, int radius, rpio_rgb_t color)
+{
+    if (radius < 0)
+        return;
+    if (cx + radius < 0 || cy + radius < 0 || cx - radius >= r->width || cy - radius >= r->height)
+        return;
+    bool inside = cx - radius >= 0 && cy - radius >= 0 &&
+                  cx + radius < r->width && cy + radius < r->height;
+
+    /* midpoint circle, one octant mirrored eight ways */
+    int x = radius;
+    int y = 0;
+    int err = 1 - radius;
+    while (x >= y)
+    {
+        plot(r, cx + x, cy + y, color, inside);
+        plot(r, cx - x, cy + y, color, inside);
+        plot(r, cx + x, cy - y, color, inside);
+        plot(r, cx - x, cy - y, color, inside);
+        plot(r, cx + y, cy + x, color, inside);
+        plot(r, cx - y, cy + x, color, inside);
+        plot(r, cx + y, cy - x, color, inside);
+        plot(r, cx - y, cy - x, color, inside);
+        y++;
+        if (err < 0)
+        {
+            err += 2 * y + 1;
+        }
+        else
+        {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+void raster_fill_circle(raster_t *r, int cx, int cy, int radius, rpio_rgb_t color)
+{
+    if (radius < 0)
+        return;
+    if (cx + radius < 0 || cy + radius < 0 || cx - radius >= r->width || cy - radius >= r->height)
+        return;
+
+    /* same walk as raster_circle, but every step fills the spans between
+     * the mirrored points */
+    int x = radius;
+    int y = 0;
+    int err = 1 - radius;
+    while (x >= y)
+    {
+        raster_hline(r, cx - x, cy + y, 2 * x + 1, color);
+        if (y != 0)
+            raster_hline(r, cx - x, cy - y, 2 * x + 1, color);
+        int old_y = y;
+        y++;
+        if (err < 0)
+        {
+            err += 2 * y + 1;
+        }
+        else
+        {
+            /* the outer rows change only when x steps */
+            if (x != old_y)
+            {
+                raster_hline(r, cx - old_y, cy + x, 2 * old_y + 1, color);
+                raster_hline(r, cx - old_y, cy - x, 2 * old_y + 1, color);
+            }
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+}
+
+/* Clips a sprite placed at x/y and advances `src` to its first visible pixel. */
+static bool clip_sprite(const raster_t *r, int *x, int *y, int *w, int *h,
+                        const rpio_rgb_t **src, int src_stride)
+{
+    int sx = *x < 0 ? -*x : 0;
+    int sy = *y < 0 ? -*y : 0;
+    if (!clip_rect(r, x, y, w, h))
+        return false;
+    *src += (size_t)sy * src_stride + sx;
+    return true;
+}
+
+void raster_blit(raster_t *r, int x, int y, const rpio_rgb_t *src, int w, int h, int src_stride)
+{
+    if (src == NULL || !clip_sprite(r, &x, &y, &w, &h, &src, src_stride))
+        return;
+
+    rpio_rgb_t *dst = pixel_at(r, x, y);
+    for (int row = 0; row < h; row++)
+    {
+        memcpy(dst, src, (size_t)w * sizeof(rpio_rgb_t));
+        dst += r->stride;
+        src += src_stride;
+    }
+}
+
+void raster_blit_key(raster_t *r, int x, int y, const rpio_rgb_t *src, int w, int h, int src_stride,
+                     rpio_rgb_t key)
+{
+    if (src == NULL || !clip_sprite(r, &x, &y, &w, &h, &src, src_stride))
+        return;
+
+    rpio_rgb_t *dst = pixel_at(r, x, y);
+    for (int row = 0; row < h; row++)
+    {
+        /* copy each run of opaque pixels with one memcpy */
+        int i = 0;
+        while (i < w)
+        {
+            while (i < w && same_color(src[i], key))
+                i++;
+            int start = i;
+            while (i < w && !same_color(src[i], key))
+                i++;
+            if (i > start)
+                memcpy(&dst[start], &src[start], (size_t)(i - start) * sizeof(rpio_rgb_t));
+        }
+        dst += r->stride;
+        src += src_stride;
+    }
+}
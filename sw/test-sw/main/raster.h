@@ -0,0 +1,43 @@
+// raster.h
+// Span based 2D drawing into rpio_rgb_t buffers. Every primitive is clipped
+// against the target once and then drawn as whole row spans, which are filled
+// a word at a time, instead of checking bounds for every pixel.
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+typedef struct
+{
+    rpio_rgb_t *pixels;
+    int width;
+    int height;
+    int stride; // pixels from one row to the next
+} raster_t;
+
+// Wraps a tightly packed width x height buffer, e.g. 64x64 or a chained 256x64.
+void raster_init(raster_t *r, rpio_rgb_t *pixels, int width, int height);
+
+void raster_clear(raster_t *r, rpio_rgb_t color);
+void raster_hline(raster_t *r, int x, int y, int w, rpio_rgb_t color);
+void raster_vline(raster_t *r, int x, int y, int h, rpio_rgb_t color);
+void raster_fill_rect(raster_t *r, int x, int y, int w, int h, rpio_rgb_t color);
+void raster_rect(raster_t *r, int x, int y, int w, int h, rpio_rgb_t color);
+void raster_line(raster_t *r, int x0, int y0, int x1, int y1, rpio_rgb_t color);
+void raster_circle(raster_t *r, int cx, int cy, int radius, rpio_rgb_t color);
+void raster_fill_circle(raster_t *r, int cx, int cy, int radius, rpio_rgb_t color);
+
+// Copies a w x h sprite whose rows are `src_stride` pixels apart.
+void raster_blit(raster_t *r, int x, int y, const rpio_rgb_t *src, int w, int h, int src_stride);
+
+// Same, skipping pixels equal to `key`.
+void raster_blit_key(raster_t *r, int x, int y, const rpio_rgb_t *src, int w, int h, int src_stride,
+                     rpio_rgb_t key);
+
+// Fills `count` pixels with `color`.
+void raster_fill_span(rpio_rgb_t *dst, size_t count, rpio_rgb_t color);
+
+#endif // RASTER_H
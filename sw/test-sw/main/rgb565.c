@@ -0,0 +1,93 @@
+// rgb565.c
+// RGB888 -> RGB565 packing kernels, see rgb565.h
+
+#include <string.h>
+
+#include "rgb565.h"
+
+// 4x4 Bayer matrix, values 0..15
+static const uint8_t s_bayer4[4][4] = {
+    {0, 8, 2, 10},
+    {12, 4, 14, 6},
+    {3, 11, 1, 9},
+    {15, 7, 13, 5},
+};
+
+#if defined(__XTENSA__)
+/* Three little endian words hold four RGB888 pixels:
+ *   w0 = r0 g0 b0 r1, w1 = g1 b1 r2 g2, w2 = b2 r3 g3 b3
+ * Each pixel is packed straight out of the words with shifts and masks, which
+ * replaces twelve byte loads with three word loads and two word stores. */
+static size_t rgb565_pack_words(uint16_t *dst, const rpio_rgb_t *src, size_t count)
+{
+    size_t done = 0;
+    if (((uintptr_t)dst & 3) != 0)
+        return 0;
+
+    /* memcpy with known alignment compiles to plain l32i/s32i and keeps
+     * the accesses free of aliasing issues */
+    const uint8_t *in = __builtin_assume_aligned(src, 4);
+    uint8_t *out = __builtin_assume_aligned(dst, 4);
+    for (; done + 4 <= count; done += 4)
+    {
+        uint32_t w[3];
+        memcpy(w, in, sizeof(w));
+        in += sizeof(w);
+        uint32_t w0 = w[0];
+        uint32_t w1 = w[1];
+        uint32_t w2 = w[2];
+
+        uint32_t p0 = ((w0 << 8) & 0xF800) | ((w0 >> 5) & 0x07E0) | ((w0 >> 19) & 0x001F);
+        uint32_t p1 = ((w0 >> 16) & 0xF800) | ((w1 << 3) & 0x07E0) | ((w1 >> 11) & 0x001F);
+        uint32_t p2 = ((w1 >> 8) & 0xF800) | ((w1 >> 21) & 0x07E0) | ((w2 >> 3) & 0x001F);
+        uint32_t p3 = (w2 & 0xF800) | ((w2 >> 13) & 0x07E0) | (w2 >> 27);
+
+        uint32_t packed[2] = {p0 | (p1 << 16), p2 | (p3 << 16)};
+        memcpy(out, packed, sizeof(packed));
+        out += sizeof(packed);
+    }
+    return done;
+}
+#endif
+
+void rgb565_pack(uint16_t *dst, const rpio_rgb_t *src, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__XTENSA__)
+    /* scalar head until the source is word aligned */
+    while (i < count && ((uintptr_t)&src[i] & 3) != 0)
+    {
+        dst[i] = rgb565(src[i]);
+        i++;
+    }
+    i += rgb565_pack_words(&dst[i], &src[i], count - i);
+#endif
+
+    /* plain loop: the tail on Xtensa, auto-vectorized by the compiler elsewhere */
+    for (; i < count; i++)
+        dst[i] = rgb565(src[i]);
+}
+
+static inline uint8_t add_sat(uint8_t v, uint8_t d)
+{
+    unsigned s = (unsigned)v + d;
+    return s > 255 ? 255 : (uint8_t)s;
+}
+
+void rgb565_pack_dither(uint16_t *dst, const rpio_rgb_t *src, size_t count, uint16_t x, uint16_t y)
+{
+    const uint8_t *row = s_bayer4[y & 3];
+    for (size_t i = 0; i < count; i++)
+    {
+        /* thresholds scaled to the 8 (red, blue) and 4 (green) steps that
+         * truncation to 5 and 6 bits throws away */
+        uint8_t d = row[(x + i) & 3];
+        rpio_rgb_t c = {
+            .r = add_sat(src[i].r, d >> 1),
+            .g = add_sat(src[i].g, d >> 2),
+            .b = add_sat(src[i].b, d >> 1),
+        };
+        dst[i] = rgb565(c);
+    }
+}
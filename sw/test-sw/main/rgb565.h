@@ -0,0 +1,24 @@
+// rgb565.h
+// RGB888 -> RGB565 packing kernels used by the RGB565 draw path.
+
+#ifndef RGB565_H
+#define RGB565_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+static inline uint16_t rgb565(rpio_rgb_t c)
+{
+    return (uint16_t)(((c.r & 0xF8) << 8) | ((c.g & 0xFC) << 3) | (c.b >> 3));
+}
+
+// Packs `count` pixels by truncating each channel.
+void rgb565_pack(uint16_t *dst, const rpio_rgb_t *src, size_t count);
+
+// Packs `count` pixels of one row with a 4x4 ordered (Bayer) dither. `x` and
+// `y` are the screen position of src[0] and select the dither phase, so
+// neighbouring segments and frames line up.
+void rgb565_pack_dither(uint16_t *dst, const rpio_rgb_t *src, size_t count, uint16_t x, uint16_t y);
+
+#endif // RGB565_H
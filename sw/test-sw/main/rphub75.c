@@ -1,13 +1,11 @@
 // rpio.c
-// SPI initialization implementation that uses pin definitions from ../rphub75.h
+// Command encoding on top of the transport installed by spi_init (see
+// rphub75_spi.c) or by a simulator on host builds.
 
 #include "esp_log.h"
 #include <stdio.h>
 #include "sdkconfig.h"
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
 #include "esp_err.h"
-#include "esp_mac.h"
 #include <stdint.h>
 #include <math.h>
 #include <stdlib.h>
@@ -18,21 +16,85 @@
 #include "freertos/task.h"
 #include "esp_task_wdt.h"
 #include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_memory_utils.h"
 
 #include "rphub75.h"
+#include "rphub75_proto.h"
+#include "rphub75_codec.h"
+#include "rgb565.h"
+#include "rphub75_stats.h"
 
 static const char *TAG = "RPHUB75";
-static spi_device_handle_t s_spi = NULL;
-static SemaphoreHandle_t s_spi_lock = NULL;
 
-/* Internal RX storage for polling-style reads. */
-static uint8_t *s_internal_rx = NULL;
-static size_t s_internal_rx_capacity = 0;
-static size_t s_internal_rx_len = 0;
+#define RP_CHUNK_PX (RP_SPI_MAX_TRANSFER / sizeof(uint16_t))
 
-static inline float clampf(float val, float min, float max)
+/* Staging buffer of the default board for the RGB565 draw path and for
+ * gathering strided regions, one DMA transaction worth. */
+DMA_ATTR static uint16_t s_chunk[RP_CHUNK_PX];
+
+/* Everything a board needs of its own so that boards on different SPI
+ * hosts can be driven from different tasks at the same time. */
+struct rphub75_dev
+{
+    rphub75_transport_t transport;
+    SemaphoreHandle_t lock;
+    uint16_t *chunk;  // only used with `lock` held
+    bool half_duplex; // link last configured with more than one data line
+
+    /* Internal RX storage for polling-style reads. */
+    uint8_t *internal_rx;
+    size_t internal_rx_capacity;
+    size_t internal_rx_len;
+};
+
+static rphub75_dev_t s_default_dev = {.chunk = s_chunk};
+
+/* Board the calling task's commands go to, NULL for the default one. */
+static __thread rphub75_dev_t *s_bound = NULL;
+
+static inline rphub75_dev_t *cur_dev(void)
 {
-    return fminf(fmaxf(val, min), max);
+    return s_bound ? s_bound : &s_default_dev;
+}
+
+/* The lock is recursive so that multi-part commands (header followed by
+ * payload) can hold it across several spi_send_data calls and reach the
+ * device without other tasks' commands in between. */
+static inline void spi_lock(void)
+{
+    SemaphoreHandle_t lock = cur_dev()->lock;
+    if (lock == NULL)
+        return;
+#if RP_STATS_ENABLE
+    // Only time the wait when another task holds the lock
+    if (xSemaphoreTakeRecursive(lock, 0) == pdTRUE)
+        return;
+    int64_t start = rphub75_stats_now();
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    rphub75_stats_lock_wait(rphub75_stats_now() - start);
+#else
+    xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+#endif
+}
+
+static inline void spi_unlock(void)
+{
+    SemaphoreHandle_t lock = cur_dev()->lock;
+    if (lock)
+        xSemaphoreGiveRecursive(lock);
+}
+
+/* Encodes [type] [cmd] [args] into the board's staging buffer, which is DMA
+ * capable, so the command goes out without a bounce copy. */
+static esp_err_t send_command(uint8_t type, uint8_t cmd, const void *args)
+{
+    rphub75_dev_t *dev = cur_dev();
+    spi_lock();
+    size_t n = rphub75_encode((uint8_t *)dev->chunk, RP_CHUNK_PX * sizeof(uint16_t), type, cmd, args);
+    esp_err_t ret = n > 0 ? spi_send_data((const uint8_t *)dev->chunk, (uint32_t)n) : ESP_ERR_INVALID_ARG;
+    spi_unlock();
+    return ret;
 }
 
 // Color creation functions
@@ -42,307 +104,391 @@ rpio_rgb_t rgb(uint8_t r, uint8_t g, uint8_t b)
     return color;
 }
 
+/* a in 16.16 fixed point, so the three channels cost an integer multiply
+ * each; the result is within one step of roundf(c * a) clamped to 0..255 */
+static inline uint8_t scale_fixed(uint8_t c, uint32_t k)
+{
+    uint32_t v = ((uint32_t)c * k + 0x8000) >> 16;
+    return v > 255 ? 255 : (uint8_t)v;
+}
+
 rpio_rgb_t rgba(uint8_t r, uint8_t g, uint8_t b, float a)
 {
-    rpio_rgb_t color = {.r = (uint8_t)roundf(clampf(r * a, 0.0f, 255.0f)), .g = (uint8_t)roundf(clampf(g * a, 0.0f, 255.0f)), .b = (uint8_t)roundf(clampf(b * a, 0.0f, 255.0f))};
+    /* also catches NaN; above 256 every non-zero channel saturates anyway */
+    uint32_t k = a > 0.0f ? (a < 256.0f ? (uint32_t)(a * 65536.0f + 0.5f) : 256u << 16) : 0;
+    rpio_rgb_t color = {.r = scale_fixed(r, k), .g = scale_fixed(g, k), .b = scale_fixed(b, k)};
     return color;
 }
 
+/* Which of v, p, q, t each channel takes in the six hue regions. */
+static const uint8_t s_hsv_select[6][3] = {
+    {0, 3, 1}, // r = v, g = t, b = p
+    {2, 0, 1},
+    {1, 0, 3},
+    {1, 2, 0},
+    {3, 1, 0},
+    {0, 1, 2},
+};
+
 rpio_rgb_t hsv(uint8_t h, uint8_t s, uint8_t v)
 {
     uint8_t region = h / 43;
     uint8_t remainder = (h - (region * 43)) * 6;
 
-    uint8_t p = (v * (255 - s)) >> 8;
-    uint8_t q = (v * (255 - ((s * remainder) >> 8))) >> 8;
-    uint8_t t = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
-
-    rpio_rgb_t color;
-    switch (region)
-    {
-    case 0:
-        color.r = v;
-        color.g = t;
-        color.b = p;
-        break;
-    case 1:
-        color.r = q;
-        color.g = v;
-        color.b = p;
-        break;
-    case 2:
-        color.r = p;
-        color.g = v;
-        color.b = t;
-        break;
-    case 3:
-        color.r = p;
-        color.g = q;
-        color.b = v;
-        break;
-    case 4:
-        color.r = t;
-        color.g = p;
-        color.b = v;
-        break;
-    default:
-        color.r = v;
-        color.g = p;
-        color.b = q;
-        break;
-    }
+    uint8_t vals[4];
+    vals[0] = v;
+    vals[1] = (v * (255 - s)) >> 8;                                // p
+    vals[2] = (v * (255 - ((s * remainder) >> 8))) >> 8;           // q
+    vals[3] = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;   // t
+
+    /* table select instead of a six-way switch */
+    const uint8_t *sel = s_hsv_select[region];
+    rpio_rgb_t color = {.r = vals[sel[0]], .g = vals[sel[1]], .b = vals[sel[2]]};
     return color;
 }
 
-// SPI functions
+// DMA-capable memory
 
-esp_err_t spi_init(void)
+void *rphub75_dma_alloc(size_t size)
 {
-    esp_log_level_set(TAG, ESP_LOG_INFO);
+    /* round up so the whole buffer can also be used for DMA receives, which
+     * need a multiple of 4 bytes */
+    size_t rounded = (size + RP_DMA_ALIGN - 1) & ~(size_t)(RP_DMA_ALIGN - 1);
+    if (rounded < size || rounded == 0)
+        return NULL;
+    return heap_caps_aligned_calloc(RP_DMA_ALIGN, 1, rounded, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+}
 
-    spi_bus_config_t buscfg = {
-        .miso_io_num = RP_PIN_MISO,
-        .mosi_io_num = RP_PIN_MOSI,
-        .sclk_io_num = RP_PIN_SCLK,
+void rphub75_dma_free(void *ptr)
+{
+    heap_caps_free(ptr);
+}
 
-        .max_transfer_sz = 4096, // use default
-        .flags = 0,
-        .intr_flags = 0};
+bool rphub75_is_dma_buffer(const void *ptr)
+{
+    return ptr != NULL && esp_ptr_dma_capable(ptr) && ((uintptr_t)ptr & 3) == 0;
+}
 
-    // Initialize SPI bus
-    esp_err_t ret = spi_bus_initialize(SPI_HOST, &buscfg, SPI_DMA_CH_AUTO);
-    if (ret != ESP_OK)
+rpio_rgb_t *rphub75_fb_alloc(uint16_t w, uint16_t h)
+{
+    return rphub75_dma_alloc((size_t)w * h * sizeof(rpio_rgb_t));
+}
+
+void rphub75_fb_free(rpio_rgb_t *fb)
+{
+    rphub75_dma_free(fb);
+}
+
+// Boards
+
+rphub75_dev_t *rphub75_dev_create(const rphub75_transport_t *transport)
+{
+    if (transport == NULL || transport->transfer == NULL)
+        return NULL;
+
+    rphub75_dev_t *dev = calloc(1, sizeof(*dev));
+    if (dev == NULL)
+        return NULL;
+    dev->transport = *transport;
+    dev->chunk = rphub75_dma_alloc(RP_CHUNK_PX * sizeof(uint16_t));
+    dev->lock = xSemaphoreCreateRecursiveMutex();
+    if (dev->chunk == NULL || dev->lock == NULL)
     {
-        ESP_LOGE(TAG, "Failed to initialize SPI bus: 0x%x", ret);
-        return ret;
+        ESP_LOGE(TAG, "rphub75_dev_create: out of memory");
+        rphub75_dev_destroy(dev);
+        return NULL;
     }
+    return dev;
+}
 
-    ESP_LOGI(TAG, "SPI bus initialized successfully");
-    ESP_LOGI(TAG, "Adding SPI device...");
-
-    spi_device_interface_config_t devcfg = {
-        .command_bits = 0,
-        .address_bits = 0,
-        .dummy_bits = 0,
-        .mode = 0, // SPI mode 0
-        .duty_cycle_pos = 0,
-        .cs_ena_pretrans = 0,
-        .cs_ena_posttrans = 0,
-        .clock_speed_hz = 20 * 1000 * 1000, // 20 MHz
-        .input_delay_ns = 0,
-        .spics_io_num = RP_PIN_CS,
-        .flags = 0,
-        .queue_size = 3,
-        .pre_cb = NULL,
-        .post_cb = NULL};
-
-    ret = spi_bus_add_device(SPI_HOST, &devcfg, &s_spi);
-    if (ret != ESP_OK)
+void rphub75_dev_destroy(rphub75_dev_t *dev)
+{
+    if (dev == NULL || dev == &s_default_dev)
+        return;
+    if (s_bound == dev)
+        s_bound = NULL;
+    if (dev->lock)
+        vSemaphoreDelete(dev->lock);
+    rphub75_dma_free(dev->chunk);
+    rphub75_dma_free(dev->internal_rx);
+    free(dev);
+}
+
+rphub75_dev_t *rphub75_default_dev(void)
+{
+    return &s_default_dev;
+}
+
+rphub75_dev_t *rphub75_bind(rphub75_dev_t *dev)
+{
+    rphub75_dev_t *prev = cur_dev();
+    s_bound = dev == &s_default_dev ? NULL : dev;
+    return prev;
+}
+
+rphub75_dev_t *rphub75_bound(void)
+{
+    return cur_dev();
+}
+
+// SPI functions
+
+esp_err_t rphub75_set_transport(const rphub75_transport_t *transport)
+{
+    rphub75_dev_t *dev = cur_dev();
+    /* The transport is swapped under the lock, so a transfer in progress
+     * finishes on the old one and the next sees the new one. The mutex stays
+     * until the board is destroyed: deleting it here could pull it from
+     * under a task blocked on it. */
+    if (transport == NULL)
     {
-        ESP_LOGE(TAG, "Failed to add SPI device: 0x%x", ret);
-        spi_bus_free(SPI_HOST);
-        return ret;
+        spi_lock();
+        dev->transport = (rphub75_transport_t){0};
+        spi_unlock();
+        return ESP_OK;
     }
 
     /* create mutex for SPI operations */
-    if (s_spi_lock == NULL)
+    if (dev->lock == NULL)
     {
-        s_spi_lock = xSemaphoreCreateMutex();
-        if (s_spi_lock == NULL)
+        dev->lock = xSemaphoreCreateRecursiveMutex();
+        if (dev->lock == NULL)
         {
             ESP_LOGW(TAG, "Failed to create spi mutex");
+            return ESP_ERR_NO_MEM;
         }
     }
 
-    ESP_LOGI(TAG, "SPI device added successfully");
+    spi_lock();
+    dev->transport = *transport;
+    spi_unlock();
     return ESP_OK;
 }
 
-esp_err_t spi_send_and_receive(const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+esp_err_t rphub75_get_transport(rphub75_transport_t *out)
 {
-    ESP_LOGI(TAG, "spi_send_and_receive: start");
-    if (s_spi == NULL)
-    {
-        ESP_LOGI(TAG, "spi_send_and_receive: err");
-        return ESP_ERR_INVALID_STATE;
-    }
+    if (out == NULL)
+        return ESP_ERR_INVALID_ARG;
+    spi_lock();
+    *out = cur_dev()->transport;
+    spi_unlock();
+    return out->transfer ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
 
-    esp_err_t ret = ESP_OK;
+esp_err_t rphub75_configure_link(const rphub75_link_config_t *link)
+{
+    rphub75_dev_t *dev = cur_dev();
+    if (link == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    spi_lock();
+    esp_err_t ret = ESP_ERR_INVALID_STATE;
+    if (dev->transport.transfer != NULL)
+        ret = dev->transport.configure ? dev->transport.configure(dev->transport.ctx, link) : ESP_ERR_NOT_SUPPORTED;
+    if (ret == ESP_OK)
+        dev->half_duplex = link->lines > 1;
+    spi_unlock();
+    return ret;
+}
 
-    if (s_spi_lock)
-        xSemaphoreTake(s_spi_lock, portMAX_DELAY);
+void rphub75_lock(void)
+{
+    spi_lock();
+}
 
-    uint32_t total = tx_len;
-    if (rx_len > total)
-        total = rx_len;
+void rphub75_unlock(void)
+{
+    spi_unlock();
+}
 
-    for (uint32_t i = 0; i < total; ++i)
+esp_err_t spi_send_and_receive(const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+{
+    RP_LOG_HOT(TAG, "spi_send_and_receive: tx_len=%u rx_len=%u", (unsigned)tx_len, (unsigned)rx_len);
+    rphub75_dev_t *dev = cur_dev();
+    esp_err_t wdt_ret = esp_task_wdt_reset();
+    if (wdt_ret != ESP_OK && wdt_ret != ESP_ERR_NOT_FOUND)
     {
-        if (i%1000 == 0){
-
-            esp_err_t wdt_ret = esp_task_wdt_reset();
-            if (wdt_ret != ESP_OK)
-            {
-                ESP_LOGW(TAG, "esp_task_wdt_reset returned 0x%x", wdt_ret);
-            }
-            /* brief yield so the idle task can run and reset the idle WDT
-             * (prevents "IDLE0 task did not reset watchdog" when large
-             *  transfers monopolize CPU). Use a 1-tick delay which is
-             *  short but gives the scheduler a chance to run lower
-             *  priority tasks (including IDLE). */
-            vTaskDelay(1);
-        }
-
-        uint8_t tx_byte = 0x00;
-        if (tx != NULL && i < tx_len)
-            tx_byte = tx[i];
-
-        uint8_t rx_byte = 0x00;
-
-        spi_transaction_t t = {0};
-        t.length = 8; // bits (one byte)
-        t.tx_buffer = &tx_byte;
-        t.rxlength = 8;
-        t.rx_buffer = &rx_byte;
-
-        ret = spi_device_queue_trans(s_spi, &t, portMAX_DELAY);
+        ESP_LOGW(TAG, "esp_task_wdt_reset returned 0x%x", wdt_ret);
+    }
 
-        if (ret != ESP_OK)
-        {
-            ESP_LOGE(TAG, "spi_send_and_receive: byte %lu transmit failed: %s", (unsigned long)i, esp_err_to_name(ret));
-            break;
-        }
+    /* checked under the lock, rphub75_set_transport(NULL) may run at any time */
+    spi_lock();
+    if (dev->transport.transfer == NULL)
+    {
+        spi_unlock();
+        ESP_LOGE(TAG, "spi_send_and_receive: no transport installed");
+        return ESP_ERR_INVALID_STATE;
+    }
+    int64_t start = rphub75_stats_now();
+    esp_err_t ret = dev->transport.transfer(dev->transport.ctx, tx, tx_len, rx, rx_len);
+    rphub75_stats_transfer(spi_transaction_count(tx != NULL, tx_len, rx != NULL, rx_len, dev->half_duplex), tx_len,
+                           rx_len, rphub75_stats_now() - start, ret);
+    spi_unlock();
+    return ret;
+}
 
-        if (rx != NULL && i < rx_len)
-            rx[i] = rx_byte;
+uint32_t spi_chunk_len(bool has_tx, uint32_t tx_len, bool has_rx, uint32_t rx_len, uint32_t offset,
+                       bool half_duplex)
+{
+    uint32_t total = tx_len > rx_len ? tx_len : rx_len;
+    uint32_t len = offset < total ? total - offset : 0;
+    if (len > RP_SPI_MAX_TRANSFER)
+        len = RP_SPI_MAX_TRANSFER;
+    if (has_tx && offset < tx_len)
+    {
+        if (len > tx_len - offset)
+            len = tx_len - offset;
+    }
+    else if (!half_duplex && len > RP_SPI_ZERO_TX)
+    {
+        /* past the end of tx (or read only) the zeros come from a fixed buffer */
+        len = RP_SPI_ZERO_TX;
     }
+    if (has_rx && offset < rx_len && len > rx_len - offset)
+        len = rx_len - offset;
+    return len;
+}
 
-    if (s_spi_lock)
-        xSemaphoreGive(s_spi_lock);
-    ESP_LOGI(TAG, "spi_send_and_receive: end");
-    return ret;
+uint32_t spi_transaction_count(bool has_tx, uint32_t tx_len, bool has_rx, uint32_t rx_len, bool half_duplex)
+{
+    /* the data lines carry one direction at a time: a write, then a read */
+    if (half_duplex && has_tx && has_rx)
+        return spi_transaction_count(true, tx_len, false, 0, true) + spi_transaction_count(false, 0, true, rx_len, true);
+    uint32_t total = tx_len > rx_len ? tx_len : rx_len;
+    uint32_t count = 0;
+    for (uint32_t offset = 0; offset < total; count++)
+        offset += spi_chunk_len(has_tx, tx_len, has_rx, rx_len, offset, half_duplex);
+    return count;
 }
 
 esp_err_t spi_set_internal_rx_capacity(uint32_t capacity)
 {
+    rphub75_dev_t *dev = cur_dev();
     if (capacity == 0)
     {
-        if (s_internal_rx)
+        if (dev->internal_rx)
         {
-            heap_caps_free(s_internal_rx);
-            s_internal_rx = NULL;
+            rphub75_dma_free(dev->internal_rx);
+            dev->internal_rx = NULL;
         }
-        s_internal_rx_capacity = 0;
-        s_internal_rx_len = 0;
+        dev->internal_rx_capacity = 0;
+        dev->internal_rx_len = 0;
         return ESP_OK;
     }
 
-    uint8_t *buf = heap_caps_calloc(capacity, 1, MALLOC_CAP_DMA);
+    uint8_t *buf = rphub75_dma_alloc(capacity);
     if (buf == NULL)
         return ESP_ERR_NO_MEM;
 
     // replace existing buffer
-    if (s_internal_rx)
-        heap_caps_free(s_internal_rx);
-    s_internal_rx = buf;
-    s_internal_rx_capacity = capacity;
-    s_internal_rx_len = 0;
+    if (dev->internal_rx)
+        rphub75_dma_free(dev->internal_rx);
+    dev->internal_rx = buf;
+    dev->internal_rx_capacity = capacity;
+    dev->internal_rx_len = 0;
     return ESP_OK;
 }
 
 const uint8_t *spi_get_last_rx(uint32_t *out_len)
 {
+    rphub75_dev_t *dev = cur_dev();
     if (out_len)
-        *out_len = s_internal_rx_len;
-    return s_internal_rx;
+        *out_len = dev->internal_rx_len;
+    return dev->internal_rx;
 }
 
 esp_err_t spi_send_data(const uint8_t *tx, uint32_t tx_len)
 {
-    ESP_LOGI(TAG, "spi_send_data: tx_len=%u", (unsigned)tx_len);
-    if (s_internal_rx_capacity == 0)
+    RP_LOG_HOT(TAG, "spi_send_data: tx_len=%u", (unsigned)tx_len);
+    rphub75_dev_t *dev = cur_dev();
+    if (dev->internal_rx_capacity == 0)
     {
         return spi_send_and_receive(tx, tx_len, NULL, 0);
     }
-    esp_err_t ret = spi_send_and_receive(tx, tx_len, s_internal_rx, s_internal_rx_capacity);
+    esp_err_t ret = spi_send_and_receive(tx, tx_len, dev->internal_rx, dev->internal_rx_capacity);
     if (ret == ESP_OK)
     {
-        s_internal_rx_len = s_internal_rx_capacity;
+        dev->internal_rx_len = dev->internal_rx_capacity;
     }
     return ret;
 }
 
+esp_err_t spi_send_command(uint8_t type, uint8_t cmd, const void *args, const uint8_t *payload, uint32_t size)
+{
+    if (size > 0 && payload == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    spi_lock();
+    uint8_t *chunk = (uint8_t *)cur_dev()->chunk;
+    const size_t chunk_size = RP_CHUNK_PX * sizeof(uint16_t);
+    size_t fill = rphub75_encode(chunk, chunk_size, type, cmd, args);
+    esp_err_t ret = fill > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    if (ret == ESP_OK && rphub75_is_dma_buffer(payload))
+    {
+        ret = spi_send_data(chunk, (uint32_t)fill);
+        if (ret == ESP_OK)
+            ret = spi_send_data(payload, size);
+        size = 0;
+        fill = 0;
+    }
+    /* the header and the payload share the staging buffer, which is sent
+     * whenever it fills */
+    while (ret == ESP_OK && size > 0)
+    {
+        size_t n = size < chunk_size - fill ? size : chunk_size - fill;
+        memcpy(chunk + fill, payload, n);
+        fill += n;
+        payload += n;
+        size -= (uint32_t)n;
+        if (fill == chunk_size)
+        {
+            ret = spi_send_data(chunk, (uint32_t)fill);
+            fill = 0;
+        }
+    }
+    if (ret == ESP_OK && fill > 0)
+        ret = spi_send_data(chunk, (uint32_t)fill);
+    spi_unlock();
+    return ret;
+}
+
 esp_err_t spi_read(uint32_t rx_len)
 {
-    if (s_internal_rx == NULL || s_internal_rx_capacity == 0)
+    rphub75_dev_t *dev = cur_dev();
+    if (dev->internal_rx == NULL || dev->internal_rx_capacity == 0)
     {
         return ESP_ERR_INVALID_STATE;
     }
 
-    esp_err_t ret = spi_send_and_receive(NULL, 0, s_internal_rx, rx_len);
+    esp_err_t ret = spi_send_and_receive(NULL, 0, dev->internal_rx, rx_len);
     if (ret != ESP_OK)
     {
         return ret;
     }
 
     // We read exactly the requested capacity bytes.
-    s_internal_rx_len = rx_len;
+    dev->internal_rx_len = rx_len;
 
     return ESP_OK;
 }
 
 void spi_print(void)
 {
-    if (s_internal_rx == NULL || s_internal_rx_len == 0)
+    rphub75_dev_t *dev = cur_dev();
+    if (dev->internal_rx == NULL || dev->internal_rx_len == 0)
     {
         ESP_LOGI(TAG, "spi_print: no data");
         return;
     }
 
-    char *line = heap_caps_calloc(s_internal_rx_len * 3 + 1, 1, MALLOC_CAP_8BIT);
-    if (line == NULL)
-    {
-        ESP_LOGW(TAG, "spi_print: allocation failed");
-        return;
-    }
-    char *p = line;
-    for (size_t i = 0; i < s_internal_rx_len; ++i)
-    {
-        int n = sprintf(p, "%02X ", s_internal_rx[i]);
-        p += n;
-    }
-    ESP_LOGI(TAG, "spi RX (%lu bytes): %s", s_internal_rx_len, line);
-    heap_caps_free(line);
-}
-
-void spi_deinit(void)
-{
-    esp_log_level_set(TAG, ESP_LOG_INFO);
-
-    if (s_spi)
-    {
-        spi_bus_remove_device(s_spi);
-        s_spi = NULL;
-    }
-
-    spi_bus_free(SPI_HOST);
-
-    if (s_spi_lock)
-    {
-        vSemaphoreDelete(s_spi_lock);
-        s_spi_lock = NULL;
-    }
-
-    ESP_LOGI(TAG, "SPI deinitialized");
+    /* 16 bytes per line, formatted on the stack */
+    ESP_LOGI(TAG, "spi RX (%lu bytes):", (unsigned long)dev->internal_rx_len);
+    ESP_LOG_BUFFER_HEX(TAG, dev->internal_rx, dev->internal_rx_len);
 }
 
 void misc_hardware_info(void)
 {
-    uint8_t buffer[2];
-    buffer[0] = rpio_ctype_misc;
-    buffer[1] = rpio_misc_hwinfo_cmd;
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_misc, rpio_misc_hwinfo_cmd, NULL);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "misc_hwinfo: spi_send_data failed: %s", esp_err_to_name(ret));
@@ -351,11 +497,7 @@ void misc_hardware_info(void)
 
 void misc_stat(void)
 {
-    uint8_t buffer[2];
-    buffer[0] = rpio_ctype_misc;
-    buffer[1] = rpio_misc_stat_cmd;
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_misc, rpio_misc_stat_cmd, NULL);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "misc_stat: spi_send_data failed: %s", esp_err_to_name(ret));
@@ -364,9 +506,12 @@ void misc_stat(void)
 
 void noop_test(uint8_t i)
 {
-    /* Large buffer - allocate on the heap to avoid stack overflow in RTOS tasks. */
+    /* Large buffer - allocated on first use and kept, so repeated tests
+     * neither overflow RTOS task stacks nor hit the heap. */
+    static uint8_t *buffer = NULL;
     const size_t buf_size = 4096*3;
-    uint8_t *buffer = heap_caps_calloc(buf_size, 1, MALLOC_CAP_DMA);
+    if (buffer == NULL)
+        buffer = rphub75_dma_alloc(buf_size);
     if (buffer == NULL)
     {
         ESP_LOGE(TAG, "noop_test: allocation failed for %lu bytes", (unsigned long)buf_size);
@@ -386,14 +531,12 @@ void noop_test(uint8_t i)
     {
         ESP_LOGE(TAG, "noop_test: spi_send_data failed: %s", esp_err_to_name(ret));
     }
-
-    heap_caps_free(buffer);
 }
 
 // Display functions
-void display_init(void)
+void display_get_init(rpio_hub75_init_t *out)
 {
-    rpio_hub75_init_t init_struct = {
+    *out = (rpio_hub75_init_t){
         .data_base = RP_HUB75_DATA_BASE,
         .rows_base = RP_HUB75_ROWS_BASE,
         .ctrl_base = RP_HUB75_CTRL_BASE,
@@ -401,13 +544,14 @@ void display_init(void)
         .width = RP_HUB75_WIDTH,
         .height = RP_HUB75_HEIGHT,
     };
+}
 
-    uint8_t buffer[2 + sizeof(init_struct)];
-    buffer[0] = rpio_ctype_hub75;
-    buffer[1] = rpio_hub75_init_cmd;
-    memcpy(&buffer[2], &init_struct, sizeof(init_struct));
+void display_init(void)
+{
+    rpio_hub75_init_t init_struct;
+    display_get_init(&init_struct);
 
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_hub75, rpio_hub75_init_cmd, &init_struct);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "display_init: spi_send_data failed: %s", esp_err_to_name(ret));
@@ -416,74 +560,68 @@ void display_init(void)
 
 void display_deinit(void)
 {
-    uint8_t buffer[2];
-    buffer[0] = rpio_ctype_hub75;
-    buffer[1] = rpio_hub75_deinit_cmd;
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_hub75, rpio_hub75_deinit_cmd, NULL);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "display_deinit: spi_send_data failed: %s", esp_err_to_name(ret));
     }
 }
 
-void display_flip(uint8_t fb_index)
+esp_err_t display_flip(uint8_t fb_index)
 {
+    int64_t start = rphub75_stats_now();
     rpio_hub75_flip_t flip_struct = {
         .fb = fb_index,
     };
 
-    uint8_t buffer[2 + sizeof(flip_struct)];
-    buffer[0] = rpio_ctype_hub75;
-    buffer[1] = rpio_hub75_flip_cmd;
-    memcpy(&buffer[2], &flip_struct, sizeof(flip_struct));
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_hub75, rpio_hub75_flip_cmd, &flip_struct);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "display_flip: spi_send_data failed: %s", esp_err_to_name(ret));
     }
+    rphub75_stats_op(RPHUB75_OP_FLIP, start);
+    return ret;
 }
 
 // Framebuffer functions
-void fb_clear(uint8_t fb_index, rpio_rgb_t color)
+esp_err_t fb_clear(uint8_t fb_index, rpio_rgb_t color)
 {
+    int64_t start = rphub75_stats_now();
     if (fb_index >= RP_FB_COUNT)
     {
         ESP_LOGE(TAG, "fb_clear: fb_index %u out of range (max %u)", (unsigned)fb_index, (unsigned)RP_FB_COUNT);
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
     rpio_fb_clear_t clear_struct = {
         .color = color,
         .fb = fb_index,
     };
 
-    uint8_t buffer[2 + sizeof(clear_struct)];
-    buffer[0] = rpio_ctype_fb;
-    buffer[1] = rpio_fb_clear_cmd;
-    memcpy(&buffer[2], &clear_struct, sizeof(clear_struct));
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_fb, rpio_fb_clear_cmd, &clear_struct);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "fb_clear: spi_send_data failed: %s", esp_err_to_name(ret));
+        return ret;
     }
+    rphub75_stats_op(RPHUB75_OP_CLEAR, start);
+    return ret;
 }
 
-void fb_blit(uint8_t src_fb, uint8_t dst_fb,
-             uint16_t src_x, uint16_t src_y,
-             uint16_t dst_x, uint16_t dst_y,
-             uint16_t w, uint16_t h)
+esp_err_t fb_blit(uint8_t src_fb, uint8_t dst_fb,
+                  uint16_t src_x, uint16_t src_y,
+                  uint16_t dst_x, uint16_t dst_y,
+                  uint16_t w, uint16_t h)
 {
+    int64_t start = rphub75_stats_now();
     if (src_fb >= RP_FB_COUNT)
     {
         ESP_LOGE(TAG, "fb_blit: src_fb %u out of range (max %u)", (unsigned)src_fb, (unsigned)RP_FB_COUNT);
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
     if (dst_fb >= RP_FB_COUNT)
     {
         ESP_LOGE(TAG, "fb_blit: dst_fb %u out of range (max %u)", (unsigned)dst_fb, (unsigned)RP_FB_COUNT);
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
 
     rpio_fb_blit_t blit_struct = {
@@ -497,45 +635,42 @@ void fb_blit(uint8_t src_fb, uint8_t dst_fb,
         .dst_fb = dst_fb,
     };
 
-    uint8_t buffer[2 + sizeof(blit_struct)];
-    buffer[0] = rpio_ctype_fb;
-    buffer[1] = rpio_fb_blit_cmd;
-    memcpy(&buffer[2], &blit_struct, sizeof(blit_struct));
-
-    esp_err_t ret = spi_send_data(buffer, sizeof(buffer));
+    esp_err_t ret = send_command(rpio_ctype_fb, rpio_fb_blit_cmd, &blit_struct);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "fb_blit: spi_send_data failed: %s", esp_err_to_name(ret));
+        return ret;
     }
+    rphub75_stats_op(RPHUB75_OP_BLIT, start);
+    return ret;
 }
 
-void fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
-             const rpio_rgb_t *bitmap, uint16_t w, uint16_t h)
+esp_err_t fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
+                  const rpio_rgb_t *bitmap, uint16_t w, uint16_t h)
 {
+    int64_t start = rphub75_stats_now();
     if (fb_index >= RP_FB_COUNT)
     {
         ESP_LOGE(TAG, "fb_draw: fb_index %u out of range (max %u)", (unsigned)fb_index, (unsigned)RP_FB_COUNT);
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
 
     /* compute sizes safely */
-    size_t struct_size = sizeof(rpio_fb_draw_t);
     size_t elems = (size_t)w * (size_t)h;
     if (w != 0 && elems / (size_t)w != (size_t)h)
     {
         ESP_LOGE(TAG, "fb_draw: width*height overflow");
-        return;
+        return ESP_ERR_INVALID_SIZE;
     }
 
     size_t bitmap_size = elems * sizeof(rpio_rgb_t);
     if (bitmap_size > 0 && bitmap == NULL)
     {
         ESP_LOGE(TAG, "fb_draw: bitmap is NULL");
-        return;
+        return ESP_ERR_INVALID_ARG;
     }
 
     /* send header (command + struct) first, then stream bitmap in chunks */
-    uint8_t header[2 + sizeof(rpio_fb_draw_t)];
     rpio_fb_draw_t draw_struct = {
         .x = x,
         .y = y,
@@ -543,15 +678,14 @@ void fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
         .h = h,
         .fb = fb_index,
     };
-    header[0] = rpio_ctype_fb;
-    header[1] = rpio_fb_draw_cmd;
-    memcpy(&header[2], &draw_struct, struct_size);
 
-    esp_err_t ret = spi_send_data(header, 2 + struct_size);
+    spi_lock();
+    esp_err_t ret = send_command(rpio_ctype_fb, rpio_fb_draw_cmd, &draw_struct);
     if (ret != ESP_OK)
     {
         ESP_LOGE(TAG, "fb_draw: header send failed: %s", esp_err_to_name(ret));
-        return;
+        spi_unlock();
+        return ret;
     }
 
     if (bitmap_size > 0)
@@ -560,7 +694,415 @@ void fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
         if (ret != ESP_OK)
         {
             ESP_LOGE(TAG, "fb_draw: bitmap stream failed: %s", esp_err_to_name(ret));
-            return;
         }
     }
-}
\ No newline at end of file
+    spi_unlock();
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+/* Validates an RGB565 draw and sends its header. On success the SPI lock is
+ * held and the caller streams w * h pixels before releasing it. */
+static esp_err_t fb_draw_rgb565_begin(const char *who, uint8_t fb_index, uint16_t x, uint16_t y,
+                                      const void *bitmap, uint16_t w, uint16_t h)
+{
+    if (fb_index >= RP_FB_COUNT)
+    {
+        ESP_LOGE(TAG, "%s: fb_index %u out of range (max %u)", who, (unsigned)fb_index, (unsigned)RP_FB_COUNT);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((size_t)w * h > 0 && bitmap == NULL)
+    {
+        ESP_LOGE(TAG, "%s: bitmap is NULL", who);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rpio_fb_draw_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+    };
+
+    spi_lock();
+    esp_err_t ret = send_command(rpio_ctype_fb, rphub75_fb_draw565_cmd, &draw_struct);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s: header send failed: %s", who, esp_err_to_name(ret));
+        spi_unlock();
+    }
+    return ret;
+}
+
+/* Packs n pixels of one row segment at screen position x, y. */
+static void pack_rgb565(uint16_t *dst, const rpio_rgb_t *src, size_t n, uint16_t x, uint16_t y,
+                        const colorlut_t *lut, bool dither)
+{
+    if (lut == NULL)
+    {
+        if (dither)
+            rgb565_pack_dither(dst, src, n, x, y);
+        else
+            rgb565_pack(dst, src, n);
+    }
+    else if (!dither)
+    {
+        colorlut_pack_rgb565(lut, dst, src, n);
+    }
+    else
+    {
+        /* the dither works on the corrected values */
+        rpio_rgb_t tmp[64];
+        for (size_t done = 0; done < n;)
+        {
+            size_t k = n - done < 64 ? n - done : 64;
+            colorlut_apply(lut, tmp, src + done, k);
+            rgb565_pack_dither(dst + done, tmp, k, x + done, y);
+            done += k;
+        }
+    }
+}
+
+static esp_err_t fb_draw_rgb565_common(const char *who, uint8_t fb_index, uint16_t x, uint16_t y,
+                                       const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                                       const colorlut_t *lut, bool dither)
+{
+    int64_t start = rphub75_stats_now();
+    esp_err_t ret = fb_draw_rgb565_begin(who, fb_index, x, y, bitmap, w, h);
+    if (ret != ESP_OK)
+        return ret;
+
+    /* convert into the chunk buffer and send it whenever it fills up */
+    uint16_t *chunk = cur_dev()->chunk;
+    const size_t chunk_px = RP_CHUNK_PX;
+    size_t fill = 0;
+    for (uint16_t row = 0; row < h && ret == ESP_OK; row++)
+    {
+        const rpio_rgb_t *src = bitmap + (size_t)row * w;
+        uint16_t col = 0;
+        while (col < w)
+        {
+            size_t n = w - col;
+            if (n > chunk_px - fill)
+                n = chunk_px - fill;
+
+            pack_rgb565(&chunk[fill], src + col, n, x + col, y + row, lut, dither);
+            fill += n;
+            col += n;
+
+            if (fill == chunk_px)
+            {
+                ret = spi_send_data((const uint8_t *)chunk, fill * sizeof(uint16_t));
+                fill = 0;
+                if (ret != ESP_OK)
+                    break;
+            }
+        }
+    }
+    if (ret == ESP_OK && fill > 0)
+        ret = spi_send_data((const uint8_t *)chunk, fill * sizeof(uint16_t));
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "%s: bitmap stream failed: %s", who, esp_err_to_name(ret));
+
+    spi_unlock();
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+esp_err_t fb_draw_rgb565(uint8_t fb_index, uint16_t x, uint16_t y,
+                         const rpio_rgb_t *bitmap, uint16_t w, uint16_t h, bool dither)
+{
+    return fb_draw_rgb565_common("fb_draw_rgb565", fb_index, x, y, bitmap, w, h, NULL, dither);
+}
+
+esp_err_t fb_draw_rgb565_lut(uint8_t fb_index, uint16_t x, uint16_t y,
+                             const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                             const colorlut_t *lut, bool dither)
+{
+    return fb_draw_rgb565_common("fb_draw_rgb565_lut", fb_index, x, y, bitmap, w, h, lut, dither);
+}
+
+esp_err_t fb_draw_rgb565_packed(uint8_t fb_index, uint16_t x, uint16_t y,
+                                const uint16_t *bitmap, uint16_t w, uint16_t h)
+{
+    int64_t start = rphub75_stats_now();
+    esp_err_t ret = fb_draw_rgb565_begin("fb_draw_rgb565_packed", fb_index, x, y, bitmap, w, h);
+    if (ret != ESP_OK)
+        return ret;
+
+    size_t bitmap_size = (size_t)w * h * sizeof(uint16_t);
+    if (bitmap_size > 0)
+    {
+        ret = spi_send_data((const uint8_t *)bitmap, bitmap_size);
+        if (ret != ESP_OK)
+            ESP_LOGE(TAG, "fb_draw_rgb565_packed: bitmap stream failed: %s", esp_err_to_name(ret));
+    }
+    spi_unlock();
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+esp_err_t fb_draw_packed(uint8_t fb_index, uint8_t ref_fb, uint16_t x, uint16_t y,
+                         uint16_t w, uint16_t h, const uint8_t *data, uint32_t size)
+{
+    int64_t start = rphub75_stats_now();
+    if (fb_index >= RP_FB_COUNT || ref_fb >= RP_FB_COUNT)
+    {
+        ESP_LOGE(TAG, "fb_draw_packed: fb %u / ref_fb %u out of range (max %u)",
+                 (unsigned)fb_index, (unsigned)ref_fb, (unsigned)RP_FB_COUNT);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (size > 0 && data == NULL)
+    {
+        ESP_LOGE(TAG, "fb_draw_packed: data is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rphub75_fb_draw_packed_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+        .ref_fb = ref_fb,
+        .size = size,
+    };
+
+    spi_lock();
+    esp_err_t ret = send_command(rpio_ctype_fb, rphub75_fb_draw_packed_cmd, &draw_struct);
+    if (ret == ESP_OK && size > 0)
+        ret = spi_send_data(data, size);
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "fb_draw_packed: send failed: %s", esp_err_to_name(ret));
+    spi_unlock();
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+static bool planes_valid(const char *what, uint8_t fb_index, const bitplane_layout_t *layout,
+                         uint16_t addr, uint16_t count)
+{
+    if (fb_index >= RP_FB_COUNT || layout == NULL)
+    {
+        ESP_LOGE(TAG, "%s: invalid fb %u / layout", what, (unsigned)fb_index);
+        return false;
+    }
+    if (layout->depth == 0 || layout->depth > BITPLANE_MAX_DEPTH || (uint32_t)addr + count > layout->scan)
+    {
+        ESP_LOGE(TAG, "%s: depth %u / rows %u+%u out of range (scan %u)", what, (unsigned)layout->depth,
+                 (unsigned)addr, (unsigned)count, (unsigned)layout->scan);
+        return false;
+    }
+    return true;
+}
+
+static void planes_header(rphub75_fb_draw_planes_t *draw_struct, uint8_t fb_index,
+                          const bitplane_layout_t *layout, uint16_t addr, uint16_t count)
+{
+    *draw_struct = (rphub75_fb_draw_planes_t){
+        .width = layout->width,
+        .height = layout->height,
+        .addr = addr,
+        .count = count,
+        .fb = fb_index,
+        .depth = layout->depth,
+        .size = (uint32_t)bitplane_size(layout, count),
+    };
+}
+
+esp_err_t fb_draw_planes(uint8_t fb_index, const bitplane_layout_t *layout, uint16_t addr, uint16_t count,
+                         const uint8_t *planes)
+{
+    int64_t start = rphub75_stats_now();
+    if (!planes_valid("fb_draw_planes", fb_index, layout, addr, count))
+        return ESP_ERR_INVALID_ARG;
+    if (count > 0 && planes == NULL)
+    {
+        ESP_LOGE(TAG, "fb_draw_planes: planes is NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rphub75_fb_draw_planes_t draw_struct;
+    planes_header(&draw_struct, fb_index, layout, addr, count);
+
+    spi_lock();
+    esp_err_t ret = send_command(rpio_ctype_fb, rphub75_fb_draw_planes_cmd, &draw_struct);
+    if (ret == ESP_OK && draw_struct.size > 0)
+        ret = spi_send_data(planes, draw_struct.size);
+    spi_unlock();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "fb_draw_planes: send failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+esp_err_t fb_draw_frame_planes(uint8_t fb_index, const bitplane_layout_t *layout, const rpio_rgb_t *frame)
+{
+    int64_t start = rphub75_stats_now();
+    if (!planes_valid("fb_draw_frame_planes", fb_index, layout, 0, layout != NULL ? layout->scan : 0))
+        return ESP_ERR_INVALID_ARG;
+    const size_t chunk_size = RP_CHUNK_PX * sizeof(uint16_t);
+    size_t row_size = bitplane_row_size(layout);
+    if (frame == NULL || row_size > chunk_size)
+    {
+        ESP_LOGE(TAG, "fb_draw_frame_planes: no frame or %u bytes per row address (max %u)",
+                 (unsigned)row_size, (unsigned)chunk_size);
+        return frame == NULL ? ESP_ERR_INVALID_ARG : ESP_ERR_INVALID_SIZE;
+    }
+
+    rphub75_fb_draw_planes_t draw_struct;
+    planes_header(&draw_struct, fb_index, layout, 0, layout->scan);
+
+    /* row addresses are packed straight into the staging buffer behind the
+     * header, as many as fit per transfer */
+    spi_lock();
+    uint8_t *chunk = (uint8_t *)cur_dev()->chunk;
+    size_t fill = rphub75_encode(chunk, chunk_size, rpio_ctype_fb, rphub75_fb_draw_planes_cmd, &draw_struct);
+    esp_err_t ret = ESP_OK;
+    uint16_t addr = 0;
+    while (addr < layout->scan && ret == ESP_OK)
+    {
+        uint16_t n = (uint16_t)((chunk_size - fill) / row_size);
+        if (n == 0)
+        {
+            ret = spi_send_data(chunk, fill);
+            fill = 0;
+            continue;
+        }
+        if (n > layout->scan - addr)
+            n = layout->scan - addr;
+        bitplane_pack(layout, chunk + fill, frame, layout->width, addr, n);
+        fill += (size_t)n * row_size;
+        addr += n;
+    }
+    if (ret == ESP_OK && fill > 0)
+        ret = spi_send_data(chunk, fill);
+    spi_unlock();
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "fb_draw_frame_planes: send failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+esp_err_t fb_draw_region(uint8_t fb_index, uint16_t x, uint16_t y,
+                         const rpio_rgb_t *frame, uint16_t stride, uint16_t w, uint16_t h)
+{
+    if (stride == w || h <= 1)
+        return fb_draw(fb_index, x, y, frame, w, h);
+    if (fb_index >= RP_FB_COUNT || frame == NULL || stride < w)
+    {
+        ESP_LOGE(TAG, "fb_draw_region: invalid fb %u / frame / stride %u", (unsigned)fb_index, (unsigned)stride);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int64_t start = rphub75_stats_now();
+    rpio_fb_draw_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+    };
+
+    /* the header and then the rows are gathered into the staging buffer,
+     * which is sent whenever it fills */
+    spi_lock();
+    uint8_t *chunk = (uint8_t *)cur_dev()->chunk;
+    const size_t chunk_size = RP_CHUNK_PX * sizeof(uint16_t);
+    size_t fill = rphub75_encode(chunk, chunk_size, rpio_ctype_fb, rpio_fb_draw_cmd, &draw_struct);
+    esp_err_t ret = ESP_OK;
+    for (uint16_t row = 0; row < h && ret == ESP_OK; row++)
+    {
+        const uint8_t *src = (const uint8_t *)(frame + (size_t)row * stride);
+        size_t left = (size_t)w * sizeof(rpio_rgb_t);
+        while (left > 0 && ret == ESP_OK)
+        {
+            size_t n = left < chunk_size - fill ? left : chunk_size - fill;
+            memcpy(chunk + fill, src, n);
+            fill += n;
+            src += n;
+            left -= n;
+            if (fill == chunk_size)
+            {
+                ret = spi_send_data(chunk, fill);
+                fill = 0;
+            }
+        }
+    }
+    if (ret == ESP_OK && fill > 0)
+        ret = spi_send_data(chunk, fill);
+    spi_unlock();
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "fb_draw_region: send failed: %s", esp_err_to_name(ret));
+    rphub75_stats_op(RPHUB75_OP_DRAW, start);
+    return ret;
+}
+
+esp_err_t fb_scroll(uint8_t fb_index, uint8_t spare_fb, const rphub75_rect_t *region,
+                    int16_t dx, int16_t dy, const rpio_rgb_t *frame, uint16_t stride)
+{
+    if (region == NULL || fb_index >= RP_FB_COUNT || spare_fb >= RP_FB_COUNT || spare_fb == fb_index)
+    {
+        ESP_LOGE(TAG, "fb_scroll: invalid region or fb %u / spare %u", (unsigned)fb_index, (unsigned)spare_fb);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int w = region->w, h = region->h;
+    int adx = dx < 0 ? -dx : dx;
+    int ady = dy < 0 ? -dy : dy;
+    if (w == 0 || h == 0)
+        return ESP_OK;
+
+    /* one lock for the whole scroll so nothing is drawn into the half-moved region */
+    esp_err_t ret = ESP_OK;
+    spi_lock();
+    if (adx >= w || ady >= h)
+    {
+        /* nothing survives the move */
+        if (frame)
+            ret = fb_draw_region(fb_index, region->x, region->y,
+                                 frame + (size_t)region->y * stride + region->x, stride, w, h);
+        spi_unlock();
+        return ret;
+    }
+
+    if (dx != 0 || dy != 0)
+    {
+        /* the part that stays visible, in source coordinates. Source and
+         * destination overlap, so it goes through the spare framebuffer. */
+        uint16_t sx = region->x + (dx < 0 ? adx : 0);
+        uint16_t sy = region->y + (dy < 0 ? ady : 0);
+        uint16_t sw = w - adx;
+        uint16_t sh = h - ady;
+        ret = fb_blit(fb_index, spare_fb, sx, sy, sx, sy, sw, sh);
+        if (ret == ESP_OK)
+            ret = fb_blit(spare_fb, fb_index, sx, sy, sx + dx, sy + dy, sw, sh);
+    }
+
+    if (frame && ret == ESP_OK)
+    {
+        /* exposed column strip over the full height, then the exposed row
+         * strip without the columns already sent */
+        if (adx > 0)
+        {
+            uint16_t x = dx > 0 ? region->x : region->x + w - adx;
+            ret = fb_draw_region(fb_index, x, region->y, frame + (size_t)region->y * stride + x,
+                                 stride, adx, h);
+        }
+        if (ady > 0 && ret == ESP_OK)
+        {
+            uint16_t x = region->x + (dx > 0 ? adx : 0);
+            uint16_t y = dy > 0 ? region->y : region->y + h - ady;
+            ret = fb_draw_region(fb_index, x, y, frame + (size_t)y * stride + x, stride, w - adx, ady);
+        }
+    }
+    spi_unlock();
+    return ret;
+}
@@ -5,11 +5,15 @@
 #ifndef RPHUB75_H
 #define RPHUB75_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <rpio.h>
 #include <esp_err.h>
 #include <stddef.h>
 
+#include "colorlut.h"
+#include "bitplane.h"
+
 // Default SPI pin assignments (change to match your wiring)
 #define SPI_HOST SPI2_HOST
 #define RP_PIN_MISO 7
@@ -17,6 +21,11 @@
 #define RP_PIN_SCLK 13
 #define RP_PIN_CS 14
 
+#define RP_SPI_CLOCK_HZ     (20 * 1000 * 1000) // SPI clock (20 MHz)
+#define RP_SPI_MAX_TRANSFER 4096 // Largest single DMA transaction in bytes
+#define RP_SPI_ZERO_TX      512  // Largest transaction that only receives (zeros on MOSI)
+#define RP_SPI_QUEUE_SIZE   4    // Number of DMA transactions kept in flight
+#define RP_DMA_ALIGN        32   // Alignment of buffers from rphub75_dma_alloc
 
 
 #define RP_HUB75_DATA_BASE 0   // Base pin for R0, G0, B0, R1, G1, B1
@@ -29,20 +38,136 @@
 
 #define RP_FB_COUNT 4 // Number of framebuffers available specified in firmware
 
+// Rectangle in framebuffer pixel coordinates
+typedef struct
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+} rphub75_rect_t;
+
 rpio_rgb_t rgb(uint8_t r, uint8_t g, uint8_t b);
 rpio_rgb_t rgba(uint8_t r, uint8_t g, uint8_t b, float a);
 rpio_rgb_t hsv(uint8_t h, uint8_t s, uint8_t v);
 
+// Data lines and clock of a link. With more than one line the link is half
+// duplex: MISO becomes a data line and carries no input windows.
+typedef struct
+{
+    uint8_t lines;     // 1, 2 or 4
+    uint32_t clock_hz;
+} rphub75_link_config_t;
+
+// Moves bytes to and from the board. spi_init installs the ESP32 SPI master
+// one; host builds install a simulated device instead. `transfer` is always
+// called with the SPI lock held.
+typedef struct
+{
+    esp_err_t (*transfer)(void *ctx, const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len);
+    void *ctx;
+    // Optional, switches the host side of the link for following transfers
+    // (see rphub75_link.h). Also called with the SPI lock held. On failure the
+    // link is left as it was; ESP_ERR_NOT_SUPPORTED for modes it cannot do.
+    esp_err_t (*configure)(void *ctx, const rphub75_link_config_t *link);
+} rphub75_transport_t;
+
+// Installs `transport` on the calling task's board for all following
+// transfers, NULL detaches it. The swap waits for a transfer in progress, so
+// the old transport's resources may be freed once this returns.
+esp_err_t rphub75_set_transport(const rphub75_transport_t *transport);
+// Copies the installed transport, e.g. to wrap it.
+esp_err_t rphub75_get_transport(rphub75_transport_t *out);
+// Switches the host side of the calling task's link, see rphub75_link.h for
+// switching both ends. ESP_ERR_NOT_SUPPORTED if the transport cannot.
+esp_err_t rphub75_configure_link(const rphub75_link_config_t *link);
+
+// Boards. Every command goes to the board bound to the calling task, the
+// default one unless rphub75_bind says otherwise. Each board has its own
+// transport, lock and staging buffer, so tasks bound to boards on different
+// SPI hosts transfer at the same time.
+typedef struct rphub75_dev rphub75_dev_t;
+
+// Board beyond the default one, e.g. from rphub75_spi_open.
+rphub75_dev_t *rphub75_dev_create(const rphub75_transport_t *transport);
+void rphub75_dev_destroy(rphub75_dev_t *dev);
+rphub75_dev_t *rphub75_default_dev(void);
+// Sends the calling task's commands to `dev` (NULL: the default board) and
+// returns the board they went to before.
+rphub75_dev_t *rphub75_bind(rphub75_dev_t *dev);
+rphub75_dev_t *rphub75_bound(void);
+
+// Holds the (recursive) SPI lock across several calls, e.g. a request and
+// the read of its response, so no other task's commands get in between.
+void rphub75_lock(void);
+void rphub75_unlock(void);
+
+// DMA-capable memory. Buffers from these are sent straight from memory by
+// the SPI DMA; anything else may be copied through a bounce buffer by the
+// driver first.
+void *rphub75_dma_alloc(size_t size);
+void rphub75_dma_free(void *ptr);
+bool rphub75_is_dma_buffer(const void *ptr);
+
+// Zeroed w x h frame suitable for fb_draw and shadowfb_present.
+rpio_rgb_t *rphub75_fb_alloc(uint16_t w, uint16_t h);
+void rphub75_fb_free(rpio_rgb_t *fb);
+
+// ESP32 SPI master link to one board
+typedef struct
+{
+    int host;       // SPI2_HOST or SPI3_HOST; boards on one host share its pins
+    int pin_miso;
+    int pin_mosi;
+    int pin_sclk;
+    int pin_cs;     // one chip select per board
+    int pin_wp;     // third and fourth data lines for quad mode, -1 if not wired
+    int pin_hd;
+    int clock_hz;
+} rphub75_spi_config_t;
+
+#define RP_SPI_MAX_LINKS 4 // Boards the SPI transport can drive at once
+
+#define RPHUB75_SPI_CONFIG_DEFAULT()     \
+    {                                    \
+        .host = SPI_HOST,                \
+        .pin_miso = RP_PIN_MISO,         \
+        .pin_mosi = RP_PIN_MOSI,         \
+        .pin_sclk = RP_PIN_SCLK,         \
+        .pin_cs = RP_PIN_CS,             \
+        .pin_wp = -1,                    \
+        .pin_hd = -1,                    \
+        .clock_hz = RP_SPI_CLOCK_HZ,     \
+    }
+
+// Opens an additional board, see rphub75_bind. A board on a host already in
+// use must give the same bus pins, or ESP_ERR_INVALID_STATE; only pin_cs
+// differs.
+esp_err_t rphub75_spi_open(const rphub75_spi_config_t *config, rphub75_dev_t **out_dev);
+void rphub75_spi_close(rphub75_dev_t *dev);
+
 // SPI functions
+// spi_init opens the default board with RPHUB75_SPI_CONFIG_DEFAULT().
 esp_err_t spi_init(void);
 void spi_deinit(void);
 void spi_print(void);
 
 esp_err_t spi_send_and_receive(const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len);
+// Length of the DMA transaction the SPI transport queues at `offset` of a
+// transfer, so tools can count transactions the way it splits them.
+uint32_t spi_chunk_len(bool has_tx, uint32_t tx_len, bool has_rx, uint32_t rx_len, uint32_t offset,
+                       bool half_duplex);
+// Number of DMA transactions the SPI transport splits a whole transfer into.
+uint32_t spi_transaction_count(bool has_tx, uint32_t tx_len, bool has_rx, uint32_t rx_len, bool half_duplex);
 esp_err_t spi_send_data(const uint8_t *tx, uint32_t tx_len);
 esp_err_t spi_read(uint32_t rx_len);
 esp_err_t spi_set_internal_rx_capacity(uint32_t capacity);
 const uint8_t *spi_get_last_rx(uint32_t *out_len);
+// Sends [type] [cmd] [args] followed by `size` bytes of `payload` as one
+// command, e.g. a frame stored pre-encoded. A payload outside DMA-capable
+// memory, such as memory-mapped flash, is copied through the board's staging
+// buffer a transfer at a time instead of being bounced by the driver.
+esp_err_t spi_send_command(uint8_t type, uint8_t cmd, const void *args, const uint8_t *payload, uint32_t size);
 
 void misc_hardware_info(void);
 void misc_stat(void);
@@ -51,18 +176,61 @@ void noop_test(uint8_t i);
 
 
 // Display functions
+// The geometry and pins display_init sends, e.g. for bitplane_layout_init.
+void display_get_init(rpio_hub75_init_t *out);
 void display_init(void);
 void display_deinit(void);
-void display_flip(uint8_t fb_index);
+esp_err_t display_flip(uint8_t fb_index);
 
 // Framebuffer functions
-void fb_clear(uint8_t fb_index, rpio_rgb_t color);
-void fb_blit(uint8_t src_fb, uint8_t dst_fb,
-             uint16_t src_x, uint16_t src_y,
-             uint16_t dst_x, uint16_t dst_y,
-             uint16_t w, uint16_t h);
-void fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
-             const rpio_rgb_t *bitmap, uint16_t w, uint16_t h);
+esp_err_t fb_clear(uint8_t fb_index, rpio_rgb_t color);
+esp_err_t fb_blit(uint8_t src_fb, uint8_t dst_fb,
+                  uint16_t src_x, uint16_t src_y,
+                  uint16_t dst_x, uint16_t dst_y,
+                  uint16_t w, uint16_t h);
+esp_err_t fb_draw(uint8_t fb_index, uint16_t x, uint16_t y,
+                  const rpio_rgb_t *bitmap, uint16_t w, uint16_t h);
+
+// RGB565 draws: 2 bytes per pixel on the wire instead of 3. fb_draw_rgb565
+// converts the RGB888 bitmap while streaming it (optionally with ordered
+// dithering), fb_draw_rgb565_packed sends an already packed one.
+esp_err_t fb_draw_rgb565(uint8_t fb_index, uint16_t x, uint16_t y,
+                         const rpio_rgb_t *bitmap, uint16_t w, uint16_t h, bool dither);
+esp_err_t fb_draw_rgb565_packed(uint8_t fb_index, uint16_t x, uint16_t y,
+                                const uint16_t *bitmap, uint16_t w, uint16_t h);
+// fb_draw_rgb565 with gamma, brightness and white balance from `lut`
+// (colorlut.h) applied in the same pass.
+esp_err_t fb_draw_rgb565_lut(uint8_t fb_index, uint16_t x, uint16_t y,
+                             const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                             const colorlut_t *lut, bool dither);
+
+// Compressed draw of `size` bytes produced by fbcodec_encode. XOR and SAME rows
+// are applied against the same rectangle of `ref_fb` (usually `fb_index`).
+esp_err_t fb_draw_packed(uint8_t fb_index, uint8_t ref_fb, uint16_t x, uint16_t y,
+                         uint16_t w, uint16_t h, const uint8_t *data, uint32_t size);
+
+// Bit-plane draws (bitplane.h): the board copies the planes straight to its
+// shifter instead of converting every pixel. fb_draw_planes sends row
+// addresses [addr, addr + count) already packed for `layout`;
+// fb_draw_frame_planes packs a whole width x height frame while streaming it.
+// The layout must match the board's geometry, or the board drops the draw.
+esp_err_t fb_draw_planes(uint8_t fb_index, const bitplane_layout_t *layout, uint16_t addr, uint16_t count,
+                         const uint8_t *planes);
+esp_err_t fb_draw_frame_planes(uint8_t fb_index, const bitplane_layout_t *layout, const rpio_rgb_t *frame);
+
+// Draws a w x h window whose rows are `stride` pixels apart in `frame`, e.g. a
+// column strip of a full frame, gathering rows instead of one draw per row.
+esp_err_t fb_draw_region(uint8_t fb_index, uint16_t x, uint16_t y,
+                         const rpio_rgb_t *frame, uint16_t stride, uint16_t w, uint16_t h);
+
+// Scrolls `region` of `fb_index` by dx/dy on the board: the content that stays
+// visible is moved with two fb_blit through `spare_fb` (a single blit of
+// overlapping rectangles is not safe), then only the exposed strips are sent
+// from `frame`, the new full frame with rows `stride` pixels apart. With a
+// NULL `frame` the exposed strips are left as they were. Stops at the first
+// command that fails and returns its error.
+esp_err_t fb_scroll(uint8_t fb_index, uint8_t spare_fb, const rphub75_rect_t *region,
+                    int16_t dx, int16_t dy, const rpio_rgb_t *frame, uint16_t stride);
 
 
 
@@ -0,0 +1,315 @@
+// rphub75_anim.c
+// RPAN animation player, see rphub75_anim.h
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "rphub75_anim.h"
+#include "rphub75.h"
+#include "rphub75_proto.h"
+
+static const char *TAG = "RPHUB75_ANIM";
+
+// Waits shorter than this are spun instead of handed to the timer task
+#define ANIM_SPIN_US 50
+
+static void anim_wake(void *arg)
+{
+    rphub75_anim_t *anim = arg;
+    xTaskNotifyGive(anim->waiter);
+}
+
+/* Payload size a frame of `kind` must have, 0 when any size goes. */
+static size_t frame_size(const rphub75_anim_t *anim, uint8_t kind)
+{
+    size_t pixels = (size_t)anim->header->width * anim->header->height;
+    switch (kind)
+    {
+    case RPHUB75_ANIM_RAW:
+        return pixels * sizeof(rpio_rgb_t);
+    case RPHUB75_ANIM_RGB565:
+        return pixels * sizeof(uint16_t);
+    case RPHUB75_ANIM_PLANES:
+        return bitplane_size(&anim->layout, anim->layout.scan);
+    default:
+        return 0;
+    }
+}
+
+static esp_err_t check_frames(rphub75_anim_t *anim)
+{
+    const rphub75_anim_header_t *h = anim->header;
+    for (uint32_t i = 0; i < h->frame_count; i++)
+    {
+        const rphub75_anim_frame_t *f = &anim->frames[i];
+        if (f->kind > RPHUB75_ANIM_PLANES || (uint64_t)f->offset + f->size > anim->size)
+        {
+            ESP_LOGE(TAG, "frame %lu: kind %u or %lu bytes at %lu outside the file", (unsigned long)i,
+                     (unsigned)f->kind, (unsigned long)f->size, (unsigned long)f->offset);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (f->kind == RPHUB75_ANIM_PLANES && anim->layout.depth == 0)
+        {
+            ESP_LOGE(TAG, "frame %lu: bit planes without a depth", (unsigned long)i);
+            return ESP_ERR_INVALID_ARG;
+        }
+        size_t expected = frame_size(anim, f->kind);
+        if (expected != 0 ? f->size != expected : f->size == 0)
+        {
+            ESP_LOGE(TAG, "frame %lu: %lu bytes, expected %lu", (unsigned long)i, (unsigned long)f->size,
+                     (unsigned long)expected);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        /* packed deltas need the frame before them on the board */
+        if (i == 0 && f->kind == RPHUB75_ANIM_PACKED && !(f->flags & RPHUB75_ANIM_KEY))
+        {
+            ESP_LOGE(TAG, "frame 0 is not a key frame");
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t rphub75_anim_open(rphub75_anim_t *anim, const void *data, size_t size)
+{
+    if (anim == NULL || data == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(anim, 0, sizeof(*anim));
+    const rphub75_anim_header_t *h = data;
+    if (size < sizeof(*h) || h->magic != RPHUB75_ANIM_MAGIC || h->version != RPHUB75_ANIM_VERSION)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_open: not an RPAN v%u file", RPHUB75_ANIM_VERSION);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (h->width == 0 || h->height == 0 || h->width > RP_HUB75_WIDTH || h->height > RP_HUB75_HEIGHT ||
+        h->frame_count == 0 || (uint64_t)h->index_offset + (uint64_t)h->frame_count * sizeof(rphub75_anim_frame_t) > size)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_open: %ux%u, %lu frames do not fit", h->width, h->height,
+                 (unsigned long)h->frame_count);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    anim->data = data;
+    anim->size = size;
+    anim->header = h;
+    anim->frames = (const rphub75_anim_frame_t *)(anim->data + h->index_offset);
+    if (h->depth != 0)
+    {
+        rpio_hub75_init_t init;
+        display_get_init(&init);
+        init.width = h->width;
+        init.height = h->height;
+        esp_err_t ret = bitplane_layout_init(&anim->layout, &init, h->depth);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "rphub75_anim_open: no %u-plane layout for %ux%u", h->depth, h->width, h->height);
+            return ret;
+        }
+    }
+    esp_err_t ret = check_frames(anim);
+    if (ret != ESP_OK)
+        return ret;
+
+    esp_timer_create_args_t args = {
+        .callback = anim_wake,
+        .arg = anim,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rphub75_anim",
+        .skip_unhandled_events = true,
+    };
+    ret = esp_timer_create(&args, &anim->timer);
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "rphub75_anim_open: esp_timer_create failed: %s", esp_err_to_name(ret));
+    return ret;
+}
+
+esp_err_t rphub75_anim_open_partition(rphub75_anim_t *anim, const char *label)
+{
+    if (anim == NULL || label == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (part == NULL)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_open_partition: no data partition \"%s\"", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* the whole partition goes through the flash cache; frames are read in
+     * place and never copied to RAM as a whole */
+    const void *data;
+    esp_partition_mmap_handle_t map;
+    esp_err_t ret = esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &data, &map);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_open_partition: mapping \"%s\" failed: %s", label, esp_err_to_name(ret));
+        return ret;
+    }
+    ret = rphub75_anim_open(anim, data, part->size);
+    if (ret != ESP_OK)
+    {
+        esp_partition_munmap(map);
+        return ret;
+    }
+    anim->map = map;
+    anim->mapped = true;
+    return ESP_OK;
+}
+
+void rphub75_anim_close(rphub75_anim_t *anim)
+{
+    if (anim == NULL)
+        return;
+    if (anim->timer != NULL)
+    {
+        esp_timer_stop(anim->timer);
+        esp_timer_delete(anim->timer);
+    }
+    if (anim->mapped)
+        esp_partition_munmap(anim->map);
+    memset(anim, 0, sizeof(*anim));
+}
+
+/* Sleeps on a one-shot esp_timer, which wakes with microsecond resolution
+ * where vTaskDelay would round to the RTOS tick. */
+static void sleep_until(rphub75_anim_t *anim, int64_t until_us)
+{
+    int64_t remaining = until_us - esp_timer_get_time();
+    if (remaining > ANIM_SPIN_US)
+    {
+        anim->waiter = xTaskGetCurrentTaskHandle();
+        ulTaskNotifyTake(pdTRUE, 0); // drop a stale wake-up
+        if (esp_timer_start_once(anim->timer, (uint64_t)(remaining - ANIM_SPIN_US)) == ESP_OK)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    while (esp_timer_get_time() < until_us)
+        ;
+}
+
+/* The payload goes out from where it is stored with the header in front of
+ * it; spi_send_command stages flash through the board's DMA buffer. */
+static esp_err_t send_frame(const rphub75_anim_t *anim, const rphub75_anim_frame_t *f, uint8_t fb, uint8_t prev_fb)
+{
+    const rphub75_anim_header_t *h = anim->header;
+    const uint8_t *payload = anim->data + f->offset;
+    switch (f->kind)
+    {
+    case RPHUB75_ANIM_RAW:
+    case RPHUB75_ANIM_RGB565:
+    {
+        rpio_fb_draw_t draw = {.x = 0, .y = 0, .w = h->width, .h = h->height, .fb = fb};
+        uint8_t cmd = f->kind == RPHUB75_ANIM_RAW ? rpio_fb_draw_cmd : rphub75_fb_draw565_cmd;
+        return spi_send_command(rpio_ctype_fb, cmd, &draw, payload, f->size);
+    }
+    case RPHUB75_ANIM_PACKED:
+    {
+        rphub75_fb_draw_packed_t draw = {
+            .x = 0,
+            .y = 0,
+            .w = h->width,
+            .h = h->height,
+            .fb = fb,
+            .ref_fb = f->flags & RPHUB75_ANIM_KEY ? fb : prev_fb,
+            .size = f->size,
+        };
+        return spi_send_command(rpio_ctype_fb, rphub75_fb_draw_packed_cmd, &draw, payload, f->size);
+    }
+    default:
+    {
+        rphub75_fb_draw_planes_t draw = {
+            .width = anim->layout.width,
+            .height = anim->layout.height,
+            .addr = 0,
+            .count = anim->layout.scan,
+            .fb = fb,
+            .depth = anim->layout.depth,
+            .size = f->size,
+        };
+        return spi_send_command(rpio_ctype_fb, rphub75_fb_draw_planes_cmd, &draw, payload, f->size);
+    }
+    }
+}
+
+esp_err_t rphub75_anim_step(rphub75_anim_t *anim, uint8_t fb_a, uint8_t fb_b)
+{
+    if (anim == NULL || anim->header == NULL || fb_a >= RP_FB_COUNT || fb_b >= RP_FB_COUNT || fb_a == fb_b)
+        return ESP_ERR_INVALID_ARG;
+    if (anim->next >= anim->header->frame_count)
+        return ESP_ERR_NOT_FOUND;
+
+    const rphub75_anim_frame_t *f = &anim->frames[anim->next];
+    uint8_t fb = anim->started && anim->fb == fb_a ? fb_b : fb_a;
+    esp_err_t ret = send_frame(anim, f, fb, anim->started ? anim->fb : fb);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_step: frame %lu failed: %s", (unsigned long)anim->next, esp_err_to_name(ret));
+        return ret;
+    }
+
+    /* a frame that arrives late is shown at once and the ones after it are
+     * timed from there, instead of being rushed to catch up */
+    int64_t now = esp_timer_get_time();
+    if (!anim->started)
+    {
+        anim->due_us = now;
+    }
+    else if (now > anim->due_us)
+    {
+        uint32_t late_us = (uint32_t)(now - anim->due_us);
+        anim->stats.late++;
+        if (late_us > anim->stats.max_late_us)
+            anim->stats.max_late_us = late_us;
+        anim->due_us = now;
+    }
+    else
+    {
+        sleep_until(anim, anim->due_us);
+    }
+    /* the previous frame stays up, so the next step sends to the same buffer */
+    ret = display_flip(fb);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "rphub75_anim_step: flip to frame %lu failed: %s", (unsigned long)anim->next,
+                 esp_err_to_name(ret));
+        return ret;
+    }
+
+    anim->fb = fb;
+    anim->started = true;
+    anim->due_us += f->duration_us;
+    anim->next++;
+    anim->stats.frames++;
+    anim->stats.bytes += f->size;
+    return ESP_OK;
+}
+
+void rphub75_anim_rewind(rphub75_anim_t *anim)
+{
+    anim->next = 0;
+    anim->started = false;
+}
+
+esp_err_t rphub75_anim_play(rphub75_anim_t *anim, uint8_t fb_a, uint8_t fb_b, uint32_t loops)
+{
+    for (uint32_t loop = 0; loops == 0 || loop < loops; loop++)
+    {
+        /* wrapping keeps `due_us`, so frame 0 follows the last one on time */
+        esp_err_t ret;
+        do
+            ret = rphub75_anim_step(anim, fb_a, fb_b);
+        while (ret == ESP_OK);
+        if (ret != ESP_ERR_NOT_FOUND)
+            return ret;
+        anim->next = 0;
+    }
+    /* the last frame stays up for its whole duration */
+    if (anim->started)
+        sleep_until(anim, anim->due_us);
+    return ESP_OK;
+}
+
+void rphub75_anim_get_stats(const rphub75_anim_t *anim, rphub75_anim_stats_t *out)
+{
+    *out = anim->stats;
+}
@@ -0,0 +1,126 @@
+// rphub75_anim.h
+// Playback of pre-rendered animations stored in the RPAN container. Frames
+// are kept encoded the way they go over the link, so the player reads them in
+// place from a memory-mapped flash partition (or a file on the host) and
+// streams them to the board through its staging buffer: a long animation
+// costs flash, not RAM. host/anim_encode.c builds the files.
+//
+// File layout, little endian:
+//   rphub75_anim_header_t
+//   rphub75_anim_frame_t[frame_count]   at index_offset
+//   frame payloads                      each at a multiple of 4
+//
+//   rphub75_anim_t anim;
+//   if (rphub75_anim_open_partition(&anim, "anim") == ESP_OK)
+//   {
+//       rphub75_anim_play(&anim, 0, 1, 0);   // loop forever on fb 0 and 1
+//       rphub75_anim_close(&anim);
+//   }
+
+#ifndef RPHUB75_ANIM_H
+#define RPHUB75_ANIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "bitplane.h"
+
+#define RPHUB75_ANIM_MAGIC   0x4E415052u // "RPAN"
+#define RPHUB75_ANIM_VERSION 1
+
+// Header flags
+#define RPHUB75_ANIM_LOOP 0x01 // meant to be looped, frame 0 follows the last one
+
+typedef enum
+{
+    RPHUB75_ANIM_RAW = 0,    // w * h RGB888 pixels, rpio_fb_draw_cmd
+    RPHUB75_ANIM_RGB565 = 1, // w * h RGB565 pixels, rphub75_fb_draw565_cmd
+    RPHUB75_ANIM_PACKED = 2, // fbcodec.h rows against the previous frame
+    RPHUB75_ANIM_PLANES = 3, // bitplane.h planes of every row address
+} rphub75_anim_kind_t;
+
+// Frame flags
+#define RPHUB75_ANIM_KEY 0x01 // does not depend on the previous frame
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t width;
+    uint16_t height;
+    uint8_t depth;        // planes of RPHUB75_ANIM_PLANES frames
+    uint8_t flags;
+    uint32_t frame_count;
+    uint32_t index_offset;
+} rphub75_anim_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t offset;      // from the start of the file
+    uint32_t size;
+    uint32_t duration_us; // how long the frame stays on screen
+    uint8_t kind;         // rphub75_anim_kind_t
+    uint8_t flags;
+    uint16_t reserved;
+} rphub75_anim_frame_t;
+
+typedef struct
+{
+    uint32_t frames;      // frames shown
+    uint32_t late;        // frames sent after they were due
+    uint32_t max_late_us;
+    uint64_t bytes;
+} rphub75_anim_stats_t;
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t size;
+    const rphub75_anim_header_t *header;
+    const rphub75_anim_frame_t *frames;
+    bitplane_layout_t layout;
+    esp_partition_mmap_handle_t map;
+    bool mapped;          // `map` is released on close
+    uint32_t next;        // frame rphub75_anim_step sends next
+    int64_t due_us;       // when it is to be shown
+    uint8_t fb;           // framebuffer the last frame went to
+    bool started;         // a frame is on screen, `fb` and `due_us` are valid
+    esp_timer_handle_t timer;
+    TaskHandle_t waiter;
+    rphub75_anim_stats_t stats;
+} rphub75_anim_t;
+
+// Plays a container already in memory; `data` must outlive the player. Checks
+// the header and that every frame lies within `size`.
+esp_err_t rphub75_anim_open(rphub75_anim_t *anim, const void *data, size_t size);
+// Maps the data partition `label` (esp_partition_mmap) and opens it.
+esp_err_t rphub75_anim_open_partition(rphub75_anim_t *anim, const char *label);
+void rphub75_anim_close(rphub75_anim_t *anim);
+
+static inline uint32_t rphub75_anim_frame_count(const rphub75_anim_t *anim)
+{
+    return anim->header->frame_count;
+}
+
+// Sends the next frame to whichever of fb_a / fb_b is not on screen, waits
+// until the frame is due and flips to it. The first frame is shown at once,
+// every later one when the previous one's duration is over, so the timing
+// does not drift with the link speed. Returns ESP_ERR_NOT_FOUND after the
+// last frame. When the frame or the flip fails the player stays on the frame,
+// so the step can be retried.
+esp_err_t rphub75_anim_step(rphub75_anim_t *anim, uint8_t fb_a, uint8_t fb_b);
+// Goes back to frame 0; the next step shows it at once.
+void rphub75_anim_rewind(rphub75_anim_t *anim);
+
+// Plays the animation `loops` times, 0 for ever.
+esp_err_t rphub75_anim_play(rphub75_anim_t *anim, uint8_t fb_a, uint8_t fb_b, uint32_t loops);
+
+void rphub75_anim_get_stats(const rphub75_anim_t *anim, rphub75_anim_stats_t *out);
+
+#endif // RPHUB75_ANIM_H
@@ -0,0 +1,271 @@
+// rphub75_async.c
+// SPI worker task draining a queue of submitted buffers, see rphub75_async.h
+
+#include "esp_log.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "rphub75.h"
+#include "rphub75_async.h"
+#include "rphub75_codec.h"
+
+static const char *TAG = "RPHUB75_ASYNC";
+
+typedef enum
+{
+    ASYNC_JOB_SEND,  // header (optional) followed by a caller buffer (optional)
+    ASYNC_JOB_FENCE, // signal `fence` once everything before it is sent
+    ASYNC_JOB_STOP,  // like a fence, then the worker exits
+} async_job_kind_t;
+
+/* A fence has a semaphore of its own rather than using the waiter's task
+ * notification, which frame_sched and the animation player sleep on as well.
+ * The waiter may give up before the worker reaches the fence, so both hold a
+ * reference and whichever lets go last frees it. */
+typedef struct
+{
+    SemaphoreHandle_t done;
+    atomic_int refs;
+} async_fence_t;
+
+typedef struct
+{
+    async_job_kind_t kind;
+    uint8_t header_len;
+    uint8_t header[2 + sizeof(rpio_fb_draw_t)];
+    const uint8_t *buf;
+    uint32_t len;
+    rphub75_done_cb_t done_cb;
+    void *arg;
+    async_fence_t *fence;
+    rphub75_dev_t *dev; // board the submitting task was bound to
+} async_job_t;
+
+static QueueHandle_t s_jobs = NULL;
+static TaskHandle_t s_worker = NULL;
+
+static async_fence_t *fence_create(void)
+{
+    async_fence_t *fence = malloc(sizeof(*fence));
+    if (fence == NULL)
+        return NULL;
+    fence->done = xSemaphoreCreateBinary();
+    if (fence->done == NULL)
+    {
+        free(fence);
+        return NULL;
+    }
+    atomic_init(&fence->refs, 2);
+    return fence;
+}
+
+static void fence_release(async_fence_t *fence)
+{
+    if (atomic_fetch_sub(&fence->refs, 1) == 1)
+    {
+        vSemaphoreDelete(fence->done);
+        free(fence);
+    }
+}
+
+static void async_worker(void *param)
+{
+    async_job_t job;
+    for (;;)
+    {
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        if (job.kind != ASYNC_JOB_SEND)
+        {
+            xSemaphoreGive(job.fence->done);
+            fence_release(job.fence);
+            if (job.kind == ASYNC_JOB_STOP)
+                break;
+            continue;
+        }
+
+        /* the lock keeps other tasks' commands out from between the header
+         * and its payload */
+        rphub75_bind(job.dev);
+        rphub75_lock();
+        esp_err_t ret = ESP_OK;
+        if (job.header_len > 0)
+            ret = spi_send_data(job.header, job.header_len);
+        if (ret == ESP_OK && job.len > 0)
+            ret = spi_send_data(job.buf, job.len);
+        rphub75_unlock();
+        if (ret != ESP_OK)
+            ESP_LOGE(TAG, "async_worker: send failed: %s", esp_err_to_name(ret));
+
+        if (job.done_cb)
+            job.done_cb(job.buf, ret, job.arg);
+    }
+
+    vTaskDelete(NULL);
+}
+
+esp_err_t rphub75_async_start(void)
+{
+    if (s_worker != NULL)
+        return ESP_OK;
+
+    s_jobs = xQueueCreate(RP_ASYNC_QUEUE_DEPTH, sizeof(async_job_t));
+    if (s_jobs == NULL)
+    {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(async_worker, "rphub75_spi", RP_ASYNC_TASK_STACK, NULL,
+                                RP_ASYNC_TASK_PRIO, &s_worker, RP_ASYNC_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create SPI worker task");
+        vQueueDelete(s_jobs);
+        s_jobs = NULL;
+        s_worker = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "SPI worker started on core %d", RP_ASYNC_TASK_CORE);
+    return ESP_OK;
+}
+
+void rphub75_async_stop(void)
+{
+    if (s_worker == NULL)
+        return;
+
+    async_job_t job = {
+        .kind = ASYNC_JOB_STOP,
+        .fence = fence_create(),
+    };
+    if (job.fence == NULL)
+    {
+        ESP_LOGE(TAG, "rphub75_async_stop: out of memory");
+        return;
+    }
+    xQueueSend(s_jobs, &job, portMAX_DELAY);
+    xSemaphoreTake(job.fence->done, portMAX_DELAY);
+    fence_release(job.fence);
+
+    vQueueDelete(s_jobs);
+    s_jobs = NULL;
+    s_worker = NULL;
+}
+
+static esp_err_t async_enqueue(async_job_t *job, TickType_t wait)
+{
+    if (s_jobs == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    job->dev = rphub75_bound();
+    if (xQueueSend(s_jobs, job, wait) != pdTRUE)
+        return ESP_ERR_TIMEOUT;
+    return ESP_OK;
+}
+
+esp_err_t fb_submit_async(const uint8_t *buf, uint32_t len,
+                          rphub75_done_cb_t done_cb, void *arg, TickType_t wait)
+{
+    if (len > 0 && buf == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    async_job_t job = {
+        .kind = ASYNC_JOB_SEND,
+        .buf = buf,
+        .len = len,
+        .done_cb = done_cb,
+        .arg = arg,
+    };
+    return async_enqueue(&job, wait);
+}
+
+esp_err_t fb_draw_async(uint8_t fb_index, uint16_t x, uint16_t y,
+                        const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                        rphub75_done_cb_t done_cb, void *arg, TickType_t wait)
+{
+    if (fb_index >= RP_FB_COUNT)
+    {
+        ESP_LOGE(TAG, "fb_draw_async: fb_index %u out of range (max %u)", (unsigned)fb_index, (unsigned)RP_FB_COUNT);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t bitmap_size = (size_t)w * (size_t)h * sizeof(rpio_rgb_t);
+    if (bitmap_size > UINT32_MAX)
+        return ESP_ERR_INVALID_SIZE;
+    if (bitmap_size > 0 && bitmap == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_draw_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+    };
+
+    async_job_t job = {
+        .kind = ASYNC_JOB_SEND,
+        .buf = (const uint8_t *)bitmap,
+        .len = (uint32_t)bitmap_size,
+        .done_cb = done_cb,
+        .arg = arg,
+    };
+    job.header_len = (uint8_t)rphub75_encode(job.header, sizeof(job.header), rpio_ctype_fb,
+                                             rpio_fb_draw_cmd, &draw_struct);
+
+    return async_enqueue(&job, wait);
+}
+
+esp_err_t display_flip_async(uint8_t fb_index, TickType_t wait)
+{
+    if (fb_index >= RP_FB_COUNT)
+    {
+        ESP_LOGE(TAG, "display_flip_async: fb_index %u out of range (max %u)", (unsigned)fb_index,
+                 (unsigned)RP_FB_COUNT);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    rpio_hub75_flip_t flip_struct = {
+        .fb = fb_index,
+    };
+
+    async_job_t job = {
+        .kind = ASYNC_JOB_SEND,
+    };
+    job.header_len = (uint8_t)rphub75_encode(job.header, sizeof(job.header), rpio_ctype_hub75,
+                                             rpio_hub75_flip_cmd, &flip_struct);
+
+    return async_enqueue(&job, wait);
+}
+
+esp_err_t rphub75_async_wait_idle(TickType_t wait)
+{
+    async_job_t job = {
+        .kind = ASYNC_JOB_FENCE,
+        .fence = fence_create(),
+    };
+    if (job.fence == NULL)
+        return ESP_ERR_NO_MEM;
+    esp_err_t ret = async_enqueue(&job, wait);
+    if (ret != ESP_OK)
+    {
+        /* never queued, the worker's reference goes too */
+        fence_release(job.fence);
+        fence_release(job.fence);
+        return ret;
+    }
+
+    /* on a timeout the fence stays queued; the worker signals it later and
+     * frees it, without waking anything of this task */
+    if (xSemaphoreTake(job.fence->done, wait) != pdTRUE)
+        ret = ESP_ERR_TIMEOUT;
+    fence_release(job.fence);
+    return ret;
+}
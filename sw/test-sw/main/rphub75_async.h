@@ -0,0 +1,41 @@
+// rphub75_async.h
+// Non-blocking frame submission. Buffers are handed to an SPI worker task
+// pinned to the second core, so the caller can render the next frame while
+// the previous one is still on the wire.
+
+#ifndef RPHUB75_ASYNC_H
+#define RPHUB75_ASYNC_H
+
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+
+#define RP_ASYNC_QUEUE_DEPTH 2                       // Submissions in flight before the caller is blocked
+#define RP_ASYNC_TASK_CORE   (portNUM_PROCESSORS - 1) // Core the SPI worker is pinned to
+#define RP_ASYNC_TASK_PRIO   5
+#define RP_ASYNC_TASK_STACK  4096
+
+// Called from the worker task once `buf` has been sent and may be reused.
+typedef void (*rphub75_done_cb_t)(const void *buf, esp_err_t result, void *arg);
+
+esp_err_t rphub75_async_start(void);
+void rphub75_async_stop(void);
+
+// All submissions are sent in order, to the board the calling task is bound
+// to when it submits (rphub75_bind). `wait` bounds how long the caller blocks
+// when RP_ASYNC_QUEUE_DEPTH submissions are already pending (ESP_ERR_TIMEOUT).
+// The buffers must stay valid until `done_cb` has been called.
+esp_err_t fb_submit_async(const uint8_t *buf, uint32_t len,
+                          rphub75_done_cb_t done_cb, void *arg, TickType_t wait);
+esp_err_t fb_draw_async(uint8_t fb_index, uint16_t x, uint16_t y,
+                        const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                        rphub75_done_cb_t done_cb, void *arg, TickType_t wait);
+esp_err_t display_flip_async(uint8_t fb_index, TickType_t wait);
+
+// Blocks until everything submitted so far has been sent. Uses no task
+// notification, and a timeout leaves nothing behind that could wake the
+// caller later.
+esp_err_t rphub75_async_wait_idle(TickType_t wait);
+
+#endif // RPHUB75_ASYNC_H
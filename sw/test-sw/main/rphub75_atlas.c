@@ -0,0 +1,130 @@
+// rphub75_atlas.c
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "rphub75_atlas.h"
+#include "colors.h"
+
+static const char *TAG = "RPHUB75_ATLAS";
+
+esp_err_t atlas_init(atlas_t *a, uint8_t fb, uint16_t width, uint16_t height)
+{
+    if (a == NULL || fb >= RP_FB_COUNT || width == 0 || height == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(a, 0, sizeof(*a));
+    a->fb = fb;
+    a->width = width;
+    a->height = height;
+    return fb_clear(fb, color_black);
+}
+
+void atlas_reset(atlas_t *a)
+{
+    a->shelf_x = 0;
+    a->shelf_y = 0;
+    a->shelf_h = 0;
+    a->count = 0;
+}
+
+/* Shelf packing: sprites go left to right on the current shelf, a sprite that
+ * does not fit opens a new shelf below the tallest one so far. */
+static esp_err_t atlas_place(atlas_t *a, uint16_t w, uint16_t h, uint16_t *x, uint16_t *y)
+{
+    if (w > a->width || h > a->height)
+        return ESP_ERR_INVALID_SIZE;
+
+    /* the shelf only moves once the sprite is known to fit */
+    uint16_t shelf_x = a->shelf_x;
+    uint16_t shelf_y = a->shelf_y;
+    uint16_t shelf_h = a->shelf_h;
+    if (w > a->width - shelf_x)
+    {
+        shelf_y += shelf_h;
+        shelf_x = 0;
+        shelf_h = 0;
+    }
+    if (shelf_y > a->height || h > a->height - shelf_y)
+        return ESP_ERR_NO_MEM;
+
+    *x = shelf_x;
+    *y = shelf_y;
+    a->shelf_x = shelf_x + w;
+    a->shelf_y = shelf_y;
+    a->shelf_h = h > shelf_h ? h : shelf_h;
+    return ESP_OK;
+}
+
+esp_err_t atlas_add(atlas_t *a, const rpio_rgb_t *pixels, uint16_t w, uint16_t h, uint16_t *out_id)
+{
+    return atlas_add_sheet(a, pixels, w, h, w, h, out_id);
+}
+
+esp_err_t atlas_add_sheet(atlas_t *a, const rpio_rgb_t *pixels, uint16_t sheet_w, uint16_t sheet_h,
+                          uint16_t cell_w, uint16_t cell_h, uint16_t *out_first_id)
+{
+    if (a == NULL || pixels == NULL || cell_w == 0 || cell_h == 0 ||
+        sheet_w < cell_w || sheet_h < cell_h)
+        return ESP_ERR_INVALID_ARG;
+
+    uint16_t cols = sheet_w / cell_w;
+    uint16_t rows = sheet_h / cell_h;
+    if ((uint32_t)cols * rows > (uint32_t)(RP_ATLAS_MAX_SPRITES - a->count))
+    {
+        ESP_LOGE(TAG, "atlas_add_sheet: %u sprites do not fit (%u used)", (unsigned)(cols * rows), (unsigned)a->count);
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* the sheet keeps its layout, so it is placed and drawn in one piece */
+    uint16_t x, y;
+    uint16_t shelf_x = a->shelf_x, shelf_y = a->shelf_y, shelf_h = a->shelf_h;
+    esp_err_t ret = atlas_place(a, cols * cell_w, rows * cell_h, &x, &y);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "atlas_add_sheet: no room for %ux%u", (unsigned)sheet_w, (unsigned)sheet_h);
+        return ret;
+    }
+
+    if (cols * cell_w == sheet_w && rows * cell_h == sheet_h)
+    {
+        ret = fb_draw(a->fb, x, y, pixels, sheet_w, sheet_h);
+    }
+    else
+    {
+        /* partial cells at the right or bottom edge are not uploaded */
+        for (uint16_t row = 0; row < rows * cell_h && ret == ESP_OK; row++)
+            ret = fb_draw(a->fb, x, y + row, pixels + (size_t)row * sheet_w, cols * cell_w, 1);
+    }
+    if (ret != ESP_OK)
+    {
+        /* nothing is registered and the space is handed back */
+        ESP_LOGE(TAG, "atlas_add_sheet: upload failed: %s", esp_err_to_name(ret));
+        a->shelf_x = shelf_x;
+        a->shelf_y = shelf_y;
+        a->shelf_h = shelf_h;
+        return ret;
+    }
+
+    if (out_first_id)
+        *out_first_id = a->count;
+    for (uint16_t r = 0; r < rows; r++)
+    {
+        for (uint16_t c = 0; c < cols; c++)
+        {
+            rphub75_rect_t *s = &a->sprites[a->count++];
+            s->x = x + c * cell_w;
+            s->y = y + r * cell_h;
+            s->w = cell_w;
+            s->h = cell_h;
+        }
+    }
+    return ESP_OK;
+}
+
+const rphub75_rect_t *atlas_sprite(const atlas_t *a, uint16_t id)
+{
+    if (a == NULL || id >= a->count)
+        return NULL;
+    return &a->sprites[id];
+}
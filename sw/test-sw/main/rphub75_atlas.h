@@ -0,0 +1,48 @@
+// rphub75_atlas.h
+// Sprite atlas kept in a spare device framebuffer. Sprites and sprite sheets
+// are uploaded once with fb_draw and packed onto shelves (rows of sprites
+// sharing a height); afterwards they are drawn with fb_blit by id.
+
+#ifndef RPHUB75_ATLAS_H
+#define RPHUB75_ATLAS_H
+
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+
+#define RP_ATLAS_MAX_SPRITES 64
+
+typedef struct
+{
+    uint8_t fb;         // device framebuffer holding the atlas
+    uint16_t width;
+    uint16_t height;
+    uint16_t shelf_x;   // next free column on the current shelf
+    uint16_t shelf_y;   // top of the current shelf
+    uint16_t shelf_h;   // tallest sprite on the current shelf
+    uint16_t count;
+    rphub75_rect_t sprites[RP_ATLAS_MAX_SPRITES];
+} atlas_t;
+
+// Uses device framebuffer `fb` (width x height) for the atlas and clears it.
+esp_err_t atlas_init(atlas_t *a, uint8_t fb, uint16_t width, uint16_t height);
+
+// Forgets all sprites; the framebuffer is reused from the top.
+void atlas_reset(atlas_t *a);
+
+// Uploads a w x h sprite and returns its id in `out_id`. ESP_ERR_NO_MEM when
+// the atlas is full.
+esp_err_t atlas_add(atlas_t *a, const rpio_rgb_t *pixels, uint16_t w, uint16_t h, uint16_t *out_id);
+
+// Uploads a sheet of sheet_w x sheet_h pixels in one fb_draw and registers
+// each cell_w x cell_h cell, row by row, as consecutive ids starting at
+// `out_first_id`. A failed upload registers no sprites.
+esp_err_t atlas_add_sheet(atlas_t *a, const rpio_rgb_t *pixels, uint16_t sheet_w, uint16_t sheet_h,
+                          uint16_t cell_w, uint16_t cell_h, uint16_t *out_first_id);
+
+// Where sprite `id` lives in the atlas framebuffer, NULL for unknown ids.
+const rphub75_rect_t *atlas_sprite(const atlas_t *a, uint16_t id);
+
+#endif // RPHUB75_ATLAS_H
@@ -0,0 +1,232 @@
+// rphub75_bands.c
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "rphub75.h"
+#include "rphub75_bands.h"
+
+static const char *TAG = "RPHUB75_BANDS";
+
+static inline uint16_t band_rows(const bands_t *b, uint8_t band)
+{
+    uint32_t y0 = (uint32_t)band * b->band_height;
+    return (uint16_t)(b->height - y0 < b->band_height ? b->height - y0 : b->band_height);
+}
+
+static void render_band(bands_t *b, uint8_t band)
+{
+    int y0 = band * b->band_height;
+    raster_t r;
+    raster_init(&r, b->frame + (size_t)y0 * b->width, b->width, band_rows(b, band));
+    b->render(&r, y0, b->arg);
+}
+
+static esp_err_t send_band(bands_t *b, uint8_t fb, uint8_t band)
+{
+    uint16_t y0 = (uint16_t)(band * b->band_height);
+    return fb_draw(fb, 0, y0, b->frame + (size_t)y0 * b->width, b->width, band_rows(b, band));
+}
+
+/* Takes the next band, false once all are taken. */
+static bool claim(bands_t *b, uint8_t *out)
+{
+    portENTER_CRITICAL(&b->mux);
+    bool ok = b->next < b->count;
+    if (ok)
+        *out = b->next++;
+    portEXIT_CRITICAL(&b->mux);
+    return ok;
+}
+
+static void mark_ready(bands_t *b, uint8_t band)
+{
+    portENTER_CRITICAL(&b->mux);
+    b->ready[band] = true;
+    portEXIT_CRITICAL(&b->mux);
+}
+
+static bool is_ready(bands_t *b, uint8_t band)
+{
+    portENTER_CRITICAL(&b->mux);
+    bool ready = b->ready[band];
+    portEXIT_CRITICAL(&b->mux);
+    return ready;
+}
+
+/* The worker may wake late and find a later frame, or none; it only ever
+ * renders bands it claimed, with the callback they were claimed under. */
+static bool is_exited(bands_t *b)
+{
+    portENTER_CRITICAL(&b->mux);
+    bool exited = b->exited;
+    portEXIT_CRITICAL(&b->mux);
+    return exited;
+}
+
+static void bands_task(void *param)
+{
+    bands_t *b = param;
+    for (;;)
+    {
+        xSemaphoreTake(b->go, portMAX_DELAY);
+        if (b->stop)
+            break;
+        uint8_t band;
+        while (claim(b, &band))
+        {
+            render_band(b, band);
+            mark_ready(b, band);
+            xSemaphoreGive(b->rendered);
+        }
+    }
+    portENTER_CRITICAL(&b->mux);
+    b->exited = true;
+    portEXIT_CRITICAL(&b->mux);
+    xSemaphoreGive(b->rendered);
+    vTaskDelete(NULL);
+}
+
+esp_err_t bands_init(bands_t *b, rpio_rgb_t *frame, uint16_t width, uint16_t height,
+                     uint16_t band_height)
+{
+    if (b == NULL || frame == NULL || width == 0 || height == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(b, 0, sizeof(*b));
+    if (band_height == 0)
+        band_height = RP_BANDS_DEFAULT_HEIGHT;
+    if ((height + band_height - 1) / band_height > RP_BANDS_MAX)
+        band_height = (height + RP_BANDS_MAX - 1) / RP_BANDS_MAX;
+    b->frame = frame;
+    b->width = width;
+    b->height = height;
+    b->band_height = band_height;
+    b->count = (uint8_t)((height + band_height - 1) / band_height);
+    b->mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+
+#if portNUM_PROCESSORS > 1
+    b->go = xSemaphoreCreateBinary();
+    b->rendered = xSemaphoreCreateCounting(RP_BANDS_MAX + 1, 0);
+    if (b->go == NULL || b->rendered == NULL)
+    {
+        bands_deinit(b);
+        return ESP_ERR_NO_MEM;
+    }
+    /* the caller keeps rendering on its own core */
+    BaseType_t core = xPortGetCoreID() == 0 ? 1 : 0;
+    if (xTaskCreatePinnedToCore(bands_task, "rphub75_bands", RP_BANDS_TASK_STACK, b,
+                                RP_BANDS_TASK_PRIO, &b->worker, core) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create worker task");
+        b->worker = NULL;
+        bands_deinit(b);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+void bands_deinit(bands_t *b)
+{
+    if (b == NULL)
+        return;
+
+    if (b->worker != NULL)
+    {
+        b->stop = true;
+        xSemaphoreGive(b->go);
+        /* gives left over from earlier frames come first */
+        do
+            xSemaphoreTake(b->rendered, portMAX_DELAY);
+        while (!is_exited(b));
+        b->worker = NULL;
+    }
+    if (b->go != NULL)
+        vSemaphoreDelete(b->go);
+    if (b->rendered != NULL)
+        vSemaphoreDelete(b->rendered);
+    b->go = NULL;
+    b->rendered = NULL;
+    b->count = 0;
+}
+
+/* fb >= RP_FB_COUNT renders without sending. */
+static esp_err_t bands_run(bands_t *b, uint8_t fb, bands_render_fn_t render, void *arg)
+{
+    if (b == NULL || b->count == 0 || render == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    /* every band of the last frame is done, so only a worker that is about to
+     * claim can look at this, and it does so under the same lock */
+    portENTER_CRITICAL(&b->mux);
+    b->render = render;
+    b->arg = arg;
+    b->next = 0;
+    memset(b->ready, 0, sizeof(b->ready));
+    portEXIT_CRITICAL(&b->mux);
+    if (b->worker != NULL)
+        xSemaphoreGive(b->go);
+
+    bool send = fb < RP_FB_COUNT;
+    esp_err_t ret = ESP_OK; // first failed send; nothing is sent after it
+    uint8_t done = 0; // bands known to be ready (and sent), in order
+    uint8_t mine = 0;
+    uint8_t band;
+    for (;;)
+    {
+        /* a band is sent as soon as the ones above it are; while the link is
+         * busy the worker keeps rendering */
+        while (send && ret == ESP_OK && done < b->count && is_ready(b, done))
+            ret = send_band(b, fb, done++);
+        if (!claim(b, &band))
+            break;
+        render_band(b, band);
+        mark_ready(b, band);
+        mine++;
+    }
+
+    /* The rest are in the worker's hands and each is marked ready before its
+     * give. Gives left over from earlier frames only cost an extra check.
+     * After a failed send the bands are still waited for, so the next frame
+     * never starts while the worker renders this one. */
+    while (done < b->count)
+    {
+        if (!is_ready(b, done))
+        {
+            xSemaphoreTake(b->rendered, portMAX_DELAY);
+            b->stats.waits++;
+            continue;
+        }
+        if (send && ret == ESP_OK)
+            ret = send_band(b, fb, done);
+        done++;
+    }
+
+    b->stats.frames++;
+    b->stats.caller_bands += mine;
+    b->stats.worker_bands += b->count - mine;
+    return ret;
+}
+
+esp_err_t bands_render(bands_t *b, bands_render_fn_t render, void *arg)
+{
+    return bands_run(b, RP_FB_COUNT, render, arg);
+}
+
+esp_err_t bands_draw(bands_t *b, uint8_t fb, bands_render_fn_t render, void *arg)
+{
+    if (fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    return bands_run(b, fb, render, arg);
+}
+
+void bands_get_stats(const bands_t *b, bands_stats_t *out)
+{
+    *out = b->stats;
+}
+
+void bands_reset_stats(bands_t *b)
+{
+    memset(&b->stats, 0, sizeof(b->stats));
+}
@@ -0,0 +1,94 @@
+// rphub75_bands.h
+// Band-parallel rendering. A frame is split into horizontal bands that are
+// rendered by the calling task and by a worker task on the other core, each
+// taking the next unclaimed band. The caller sends bands in order as soon as
+// they and every band above them are done, so the first rows are on the link
+// while later ones are still being rendered.
+//
+// The render callback gets a raster of just the band's rows and the frame row
+// it starts at, and draws at y - y0. Primitives outside the band are clipped
+// away, and since the raster primitives are translation invariant the frame
+// comes out exactly as if it had been drawn in one piece.
+//
+//   static void draw(raster_t *band, int y0, void *arg)
+//   {
+//       raster_clear(band, color_black);
+//       raster_fill_circle(band, 128, 32 - y0, 20, color_red);
+//   }
+//
+//   bands_t bands;
+//   bands_init(&bands, canvas, 256, 64, 0);
+//   bands_draw(&bands, fb, draw, NULL);
+//   display_flip(fb);
+
+#ifndef RPHUB75_BANDS_H
+#define RPHUB75_BANDS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "raster.h"
+
+#define RP_BANDS_MAX            32  // Bands per frame
+#define RP_BANDS_DEFAULT_HEIGHT 8   // Rows per band when bands_init gets 0
+#define RP_BANDS_TASK_PRIO      5
+#define RP_BANDS_TASK_STACK     4096
+
+// Renders rows [y0, y0 + band->height) of the frame into `band`.
+typedef void (*bands_render_fn_t)(raster_t *band, int y0, void *arg);
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t caller_bands; // rendered by the calling task
+    uint32_t worker_bands; // rendered by the worker
+    uint32_t waits;        // times the caller waited for a band of the worker
+} bands_stats_t;
+
+typedef struct
+{
+    rpio_rgb_t *frame;
+    uint16_t width;
+    uint16_t height;
+    uint16_t band_height;
+    uint8_t count;             // bands per frame
+    TaskHandle_t worker;       // NULL on single core targets
+    SemaphoreHandle_t go;      // starts the worker on a frame
+    SemaphoreHandle_t rendered; // given by the worker per band, and when it exits
+    portMUX_TYPE mux;          // guards the frame state below
+
+    /* frame being rendered */
+    bands_render_fn_t render;
+    void *arg;
+    uint8_t next;              // next unclaimed band
+    bool ready[RP_BANDS_MAX];
+    bool stop;
+    bool exited;
+
+    bands_stats_t stats;
+} bands_t;
+
+// Renders into `frame` (width x height, row-major) in bands of `band_height`
+// rows, RP_BANDS_DEFAULT_HEIGHT for 0. Rounded up so there are at most
+// RP_BANDS_MAX bands.
+esp_err_t bands_init(bands_t *b, rpio_rgb_t *frame, uint16_t width, uint16_t height,
+                     uint16_t band_height);
+void bands_deinit(bands_t *b);
+
+// Renders the whole frame and returns once every band is done.
+esp_err_t bands_render(bands_t *b, bands_render_fn_t render, void *arg);
+
+// Same, sending each band to framebuffer `fb` of the bound board as soon as
+// the bands above it are sent. Does not flip. After a failed send the rest of
+// the frame is still rendered but not sent, and the first error is returned.
+esp_err_t bands_draw(bands_t *b, uint8_t fb, bands_render_fn_t render, void *arg);
+
+void bands_get_stats(const bands_t *b, bands_stats_t *out);
+void bands_reset_stats(bands_t *b);
+
+#endif // RPHUB75_BANDS_H
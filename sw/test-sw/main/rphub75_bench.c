@@ -0,0 +1,593 @@
+// rphub75_bench.c
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "rphub75_bench.h"
+#include "rphub75_shadow.h"
+#include "platformer.h"
+#include "colors.h"
+#include "raster.h"
+#include "colorlut.h"
+#include "bitplane.h"
+#include "rphub75_atlas.h"
+#include "rphub75_scene.h"
+#include "rphub75_bands.h"
+#include "rphub75_cmdq.h"
+
+#define FRAME_PIXELS (RP_HUB75_WIDTH * RP_HUB75_HEIGHT)
+#define TICKER_ROWS 8
+#define SCENE_SPRITES 8
+#define BENCH_LEVEL_ITEMS 400
+#define ATLAS_FB 3
+
+static const char *TAG = "RPHUB75_BENCH";
+
+// Wraps the installed transport and counts what goes through it
+typedef struct
+{
+    rphub75_transport_t inner;
+    uint64_t bytes;
+    uint64_t calls;
+    uint64_t transactions;
+    int64_t time_us; // spent inside the inner transport
+    cmdq_t *flip_queue;  // set: the next transfer queues an urgent flip of flip_fb
+    uint8_t flip_fb;
+} bench_counter_t;
+
+typedef struct
+{
+    const rphub75_bench_config_t *config;
+    bench_counter_t counter;
+    rpio_rgb_t *frame;
+    rpio_rgb_t *background;
+    shadowfb_t shadow;
+    atlas_t atlas;
+    scene_t scene;
+    uint16_t nodes[SCENE_SPRITES];
+} bench_t;
+
+typedef void (*bench_frame_fn)(bench_t *b, uint32_t frame);
+
+static const uint8_t swap_chain[] = {0, 1};
+
+// Keeps the compiler from dropping kernel results
+static volatile uint32_t s_sink;
+
+static esp_err_t bench_transfer(void *ctx, const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+{
+    bench_counter_t *c = ctx;
+    c->bytes += tx_len > rx_len ? tx_len : rx_len;
+    c->calls++;
+    /* split as on the single-line link, where reads are clocked out of a smaller zero buffer */
+    c->transactions += spi_transaction_count(tx != NULL, tx_len, rx != NULL, rx_len, false);
+    if (c->flip_queue != NULL)
+    {
+        /* from the owner task, while its band is going out */
+        cmdq_flip(c->flip_queue, c->flip_fb);
+        c->flip_queue = NULL;
+    }
+
+    int64_t start = esp_timer_get_time();
+    esp_err_t ret = c->inner.transfer(c->inner.ctx, tx, tx_len, rx, rx_len);
+    c->time_us += esp_timer_get_time() - start;
+    return ret;
+}
+
+static void bench_counter_reset(bench_counter_t *c)
+{
+    c->bytes = 0;
+    c->calls = 0;
+    c->transactions = 0;
+    c->time_us = 0;
+}
+
+// Workloads
+
+static void draw_gradient(bench_t *b, uint32_t frame)
+{
+    for (int y = 0; y < RP_HUB75_HEIGHT; y++)
+    {
+        for (int x = 0; x < RP_HUB75_WIDTH; x++)
+        {
+            b->frame[y * RP_HUB75_WIDTH + x] = hsv((uint8_t)(x * 4 + frame), 255, (uint8_t)(128 + y * 2));
+        }
+    }
+}
+
+// Full-frame hsv gradient sent with fb_draw every frame
+static void frame_full(bench_t *b, uint32_t frame)
+{
+    draw_gradient(b, frame);
+    uint8_t fb = swap_chain[frame & 1];
+    fb_draw(fb, 0, 0, b->frame, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    display_flip(fb);
+}
+
+static bitplane_layout_t s_planes;
+
+// The same gradient packed into 6 bit planes while it is sent: as many bytes
+// as fb_draw, but nothing left for the board to convert
+static void frame_full_planes(bench_t *b, uint32_t frame)
+{
+    draw_gradient(b, frame);
+    uint8_t fb = swap_chain[frame & 1];
+    fb_draw_frame_planes(fb, &s_planes, b->frame);
+    display_flip(fb);
+}
+
+// 8x8 sprite bouncing over a static rgba() shaded background
+static void frame_sprite(bench_t *b, uint32_t frame)
+{
+    int span_x = RP_HUB75_WIDTH - 8;
+    int span_y = RP_HUB75_HEIGHT - 8;
+    int x = (int)(frame % (2 * span_x));
+    int y = (int)((frame * 3 / 2) % (2 * span_y));
+    if (x > span_x)
+        x = 2 * span_x - x;
+    if (y > span_y)
+        y = 2 * span_y - y;
+
+    memcpy(b->frame, b->background, FRAME_PIXELS * sizeof(rpio_rgb_t));
+    draw_rectangle(b->frame, x, y, 8, 8, 255, 255, 0);
+    shadowfb_present(&b->shadow, b->frame, NULL);
+}
+
+// Stripe pattern scrolling one pixel per frame along the bottom rows
+static void frame_ticker(bench_t *b, uint32_t frame)
+{
+    static const uint8_t pattern[] = {0x7C, 0x12, 0x11, 0x12, 0x7C, 0x00, 0x7F, 0x49, 0x49, 0x36, 0x00, 0x00};
+
+    memcpy(b->frame, b->background, FRAME_PIXELS * sizeof(rpio_rgb_t));
+    for (int x = 0; x < RP_HUB75_WIDTH; x++)
+    {
+        uint8_t column = pattern[(x + frame) % sizeof(pattern)];
+        for (int y = 0; y < TICKER_ROWS - 1; y++)
+        {
+            rpio_rgb_t *px = &b->frame[(RP_HUB75_HEIGHT - TICKER_ROWS + y) * RP_HUB75_WIDTH + x];
+            *px = (column >> y) & 1 ? color_white : color_black;
+        }
+    }
+    shadowfb_present(&b->shadow, b->frame, NULL);
+}
+
+// Same scroll done on the board: fb_blit moves the framebuffer left by one
+// column and only the new column is drawn
+static void frame_blit(bench_t *b, uint32_t frame)
+{
+    uint8_t src = swap_chain[frame & 1];
+    uint8_t dst = swap_chain[(frame + 1) & 1];
+    for (int y = 0; y < RP_HUB75_HEIGHT; y++)
+    {
+        b->frame[y] = hsv((uint8_t)(frame * 2 + y), 255, 255);
+    }
+    fb_blit(src, dst, 1, 0, 0, 0, RP_HUB75_WIDTH - 1, RP_HUB75_HEIGHT);
+    fb_draw(dst, RP_HUB75_WIDTH - 1, 0, b->frame, 1, RP_HUB75_HEIGHT);
+    display_flip(dst);
+}
+
+// Same scroll with fb_scroll on the shown framebuffer: the new frame is
+// rendered in full on the host but only its exposed column is sent
+static void frame_scroll(bench_t *b, uint32_t frame)
+{
+    static const rphub75_rect_t screen = {0, 0, RP_HUB75_WIDTH, RP_HUB75_HEIGHT};
+    for (int y = 0; y < RP_HUB75_HEIGHT; y++)
+    {
+        for (int x = 0; x < RP_HUB75_WIDTH; x++)
+        {
+            b->frame[y * RP_HUB75_WIDTH + x] = hsv((uint8_t)((x + frame) * 4), 255, (uint8_t)(128 + y * 2));
+        }
+    }
+    if (frame == 0)
+    {
+        fb_draw(0, 0, 0, b->frame, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+        display_flip(0);
+        return;
+    }
+    fb_scroll(0, 2, &screen, -1, 0, b->frame, RP_HUB75_WIDTH);
+}
+
+// The platformer from main.c with scripted input at a fixed 60 Hz step
+static Player s_player;
+static Level s_level;
+
+static void frame_platformer(bench_t *b, uint32_t frame)
+{
+    uint32_t phase = frame % 240;
+    PlayerInput input = {
+        .left = phase >= 120 && phase < 200,
+        .right = phase < 100,
+        .jump = frame % 45 == 0,
+    };
+    update_player(&s_player, &input, &s_level, FIX16(1.0f / 60.0f));
+    update_framebuffer(b->frame, &s_player, &s_level);
+    shadowfb_present(&b->shadow, b->frame, NULL);
+}
+
+// Eight atlas sprites moving every frame, composited on the board with fb_blit
+static void frame_scene(bench_t *b, uint32_t frame)
+{
+    for (int i = 0; i < SCENE_SPRITES; i++)
+    {
+        int16_t x = (int16_t)((frame + i * 11) % (RP_HUB75_WIDTH + 8)) - 8;
+        int16_t y = (int16_t)(i * 8);
+        scene_move(&b->scene, b->nodes[i], x, y);
+        scene_set_sprite(&b->scene, b->nodes[i], (uint16_t)((frame / 4 + i) % 4));
+    }
+    scene_present(&b->scene);
+}
+
+static esp_err_t bench_scene_setup(bench_t *b)
+{
+    /* four 8x8 animation frames in one 32x8 sheet */
+    rpio_rgb_t sheet[32 * 8];
+    for (int y = 0; y < 8; y++)
+        for (int x = 0; x < 32; x++)
+            sheet[y * 32 + x] = hsv((uint8_t)(x * 8), 255, (uint8_t)(255 - y * 16));
+
+    uint16_t first;
+    esp_err_t ret = atlas_init(&b->atlas, ATLAS_FB, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    if (ret == ESP_OK)
+        ret = atlas_add_sheet(&b->atlas, sheet, 32, 8, 8, 8, &first);
+    if (ret == ESP_OK)
+        ret = scene_init(&b->scene, &b->atlas, RP_HUB75_WIDTH, RP_HUB75_HEIGHT,
+                         swap_chain, sizeof(swap_chain), color_black);
+    for (int i = 0; i < SCENE_SPRITES && ret == ESP_OK; i++)
+        ret = scene_add(&b->scene, first, 0, 0, (uint8_t)(i & 1), &b->nodes[i]);
+    return ret;
+}
+
+static void bench_workload(bench_t *b, const char *name, bench_frame_fn fn)
+{
+    const rphub75_bench_config_t *config = b->config;
+
+    shadowfb_invalidate(&b->shadow);
+    // Warm-up frame so one-off full redraws do not skew the numbers
+    fn(b, 0);
+    bench_counter_reset(&b->counter);
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 1; i <= config->frames; i++)
+    {
+        fn(b, i);
+    }
+    int64_t wall_us = esp_timer_get_time() - start;
+
+    const bench_counter_t *c = &b->counter;
+    float frames = (float)config->frames;
+    float cpu_us = (float)(wall_us - c->time_us) / frames;
+    float bytes = (float)c->bytes / frames;
+    float transactions = (float)c->transactions / frames;
+    float link_us = bytes * 8.0f * 1e6f / (float)config->spi_clock_hz +
+                    transactions * (float)config->transaction_ns / 1000.0f;
+    float frame_us = cpu_us + link_us;
+
+    printf("{\"bench\":\"%s\",\"target\":\"%s\",\"frames\":%lu,\"clock_hz\":%lu,"
+           "\"cpu_us\":%.1f,\"link_us\":%.1f,\"bytes\":%.1f,\"transactions\":%.2f,"
+           "\"calls\":%.2f,\"est_fps\":%.1f}\n",
+           name, CONFIG_IDF_TARGET, (unsigned long)config->frames, (unsigned long)config->spi_clock_hz,
+           cpu_us, link_us, bytes, transactions, (float)c->calls / frames,
+           frame_us > 0.0f ? 1e6f / frame_us : 0.0f);
+}
+
+// Kernels
+
+static void bench_kernel(const char *name, uint32_t ops, int64_t elapsed_us)
+{
+    printf("{\"kernel\":\"%s\",\"target\":\"%s\",\"ops\":%lu,\"ns_per_op\":%.1f}\n",
+           name, CONFIG_IDF_TARGET, (unsigned long)ops,
+           ops ? (float)elapsed_us * 1000.0f / (float)ops : 0.0f);
+}
+
+// Clear, background panels, outlines, lines, circles and color keyed sprites,
+// on rows [y0, y0 + r->height) of a frame `height` rows high
+static void draw_scene(raster_t *r, int y0, int height, uint32_t frame)
+{
+    static const rpio_rgb_t key = {255, 0, 255};
+    rpio_rgb_t sprite[8 * 8];
+    for (int i = 0; i < 8 * 8; i++)
+    {
+        int x = i % 8, y = i / 8;
+        sprite[i] = (x - 4) * (x - 4) + (y - 4) * (y - 4) < 12 ? color_yellow : key;
+    }
+
+    raster_clear(r, color_black);
+    for (int x = 0; x < r->width; x += 16)
+    {
+        raster_fill_rect(r, x, height - 12 - y0, 12, 12, color_gray);
+        raster_rect(r, x + 2, 4 - y0, 10, 10, color_blue);
+        raster_line(r, x, -y0, x + 15, height - 1 - y0, color_green);
+        raster_fill_circle(r, x + 8, height / 2 - y0, 5, color_purple);
+        raster_circle(r, x + 8, height / 2 - y0, 7, color_white);
+        raster_blit_key(r, x + (int)(frame % 8), 20 - y0, sprite, 8, 8, 8, key);
+    }
+}
+
+static void bench_scene(const char *name, uint32_t ops, int width, int height)
+{
+    rpio_rgb_t *pixels = malloc((size_t)width * height * sizeof(rpio_rgb_t));
+    if (pixels == NULL)
+        return;
+    raster_t r;
+    raster_init(&r, pixels, width, height);
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        draw_scene(&r, 0, height, i);
+    }
+    bench_kernel(name, ops, esp_timer_get_time() - start);
+    s_sink = pixels[ops % ((size_t)width * height)].g;
+    free(pixels);
+}
+
+typedef struct
+{
+    int height;
+    uint32_t frame;
+} scene_band_arg_t;
+
+static void draw_scene_band(raster_t *band, int y0, void *arg)
+{
+    const scene_band_arg_t *a = arg;
+    draw_scene(band, y0, a->height, a->frame);
+}
+
+// Same scene rendered in bands on both cores
+static void bench_scene_bands(const char *name, uint32_t ops, int width, int height)
+{
+    rpio_rgb_t *pixels = malloc((size_t)width * height * sizeof(rpio_rgb_t));
+    if (pixels == NULL)
+        return;
+    bands_t bands;
+    if (bands_init(&bands, pixels, (uint16_t)width, (uint16_t)height, 0) != ESP_OK)
+    {
+        free(pixels);
+        return;
+    }
+
+    scene_band_arg_t arg = {.height = height};
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        arg.frame = i;
+        bands_render(&bands, draw_scene_band, &arg);
+    }
+    bench_kernel(name, ops, esp_timer_get_time() - start);
+    s_sink = pixels[ops % ((size_t)width * height)].g;
+    bands_deinit(&bands);
+    free(pixels);
+}
+
+// Player steps with scripted input on a level of `count` platforms
+static void bench_level(const char *name, uint32_t steps, const EnvItem *items, int count, int width)
+{
+    Level level;
+    if (level_init(&level, width, RP_HUB75_HEIGHT, items, count) != ESP_OK)
+        return;
+
+    Player player = PLAYER_START;
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        PlayerInput input = {
+            .left = i % 240 >= 120,
+            .right = i % 240 < 120,
+            .jump = i % 45 == 0,
+        };
+        update_player(&player, &input, &level, FIX16(1.0f / 60.0f));
+    }
+    bench_kernel(name, steps, esp_timer_get_time() - start);
+    s_sink = (uint32_t)player.position_x;
+    level_deinit(&level);
+}
+
+static void bench_kernels(bench_t *b)
+{
+    uint32_t ops = b->config->kernel_ops;
+    uint32_t acc = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        rpio_rgb_t c = rgba((uint8_t)i, (uint8_t)(i >> 3), 200, (float)(i & 255) / 255.0f);
+        acc += c.r + c.g + c.b;
+    }
+    bench_kernel("rgba", ops, esp_timer_get_time() - start);
+
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < ops; i++)
+    {
+        rpio_rgb_t c = hsv((uint8_t)i, (uint8_t)(i >> 2), 255);
+        acc += c.r + c.g + c.b;
+    }
+    bench_kernel("hsv", ops, esp_timer_get_time() - start);
+
+    // draw_rectangle is measured per full-screen fill
+    uint32_t fills = ops / 64 ? ops / 64 : 1;
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < fills; i++)
+    {
+        draw_rectangle(b->frame, 0, 0, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, (uint8_t)i, 0, 0);
+        acc += b->frame[i % FRAME_PIXELS].r;
+    }
+    bench_kernel("draw_rectangle_64x64", fills, esp_timer_get_time() - start);
+
+    // color correction is measured per full frame
+    colorlut_t lut;
+    colorlut_config_t lut_config = COLORLUT_CONFIG_DEFAULT();
+    lut_config.brightness = 192;
+    colorlut_build(&lut, &lut_config);
+    start = esp_timer_get_time();
+    for (uint32_t i = 0; i < fills; i++)
+    {
+        colorlut_apply(&lut, b->frame, b->frame, FRAME_PIXELS);
+        acc += b->frame[i % FRAME_PIXELS].g;
+    }
+    bench_kernel("colorlut_apply_64x64", fills, esp_timer_get_time() - start);
+
+    uint16_t *packed = malloc(FRAME_PIXELS * sizeof(uint16_t));
+    if (packed != NULL)
+    {
+        start = esp_timer_get_time();
+        for (uint32_t i = 0; i < fills; i++)
+        {
+            colorlut_pack_rgb565(&lut, packed, b->frame, FRAME_PIXELS);
+            acc += packed[i % FRAME_PIXELS];
+        }
+        bench_kernel("colorlut_pack_rgb565_64x64", fills, esp_timer_get_time() - start);
+        free(packed);
+    }
+
+    rpio_hub75_init_t init;
+    bitplane_layout_t layout;
+    display_get_init(&init);
+    uint8_t *planes = NULL;
+    if (bitplane_layout_init(&layout, &init, 8) == ESP_OK)
+        planes = malloc(bitplane_size(&layout, layout.scan));
+    if (planes != NULL)
+    {
+        start = esp_timer_get_time();
+        for (uint32_t i = 0; i < fills; i++)
+        {
+            bitplane_pack(&layout, planes, b->frame, RP_HUB75_WIDTH, 0, layout.scan);
+            acc += planes[i % bitplane_size(&layout, layout.scan)];
+        }
+        bench_kernel("bitplane_pack_64x64", fills, esp_timer_get_time() - start);
+        free(planes);
+    }
+
+    bench_scene("raster_scene_64x64", fills, RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    bench_scene("raster_scene_256x64", fills / 4 ? fills / 4 : 1, 4 * RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    bench_scene_bands("raster_scene_256x64_bands", fills / 4 ? fills / 4 : 1, 4 * RP_HUB75_WIDTH,
+                      RP_HUB75_HEIGHT);
+
+    // Collisions only look at the tiles around the player, so a level 100
+    // times as large must not cost more per step
+    bench_level("platformer_step_4", ops, envItems, envItemsLength, RP_HUB75_WIDTH);
+    EnvItem *items = malloc(BENCH_LEVEL_ITEMS * sizeof(EnvItem));
+    if (items != NULL)
+    {
+        for (int i = 0; i < BENCH_LEVEL_ITEMS; i++)
+        {
+            items[i] = (EnvItem){i * 12, 24 + (i * 7) % 32, 8, 4};
+        }
+        bench_level("platformer_step_400", ops, items, BENCH_LEVEL_ITEMS, BENCH_LEVEL_ITEMS * 12);
+        free(items);
+    }
+
+    s_sink = acc;
+}
+
+// Command queue
+
+/* Every frame a full-frame draw goes into the back framebuffer through a
+ * cmdq_t, and a flip of the front one is queued while its first band is on
+ * the wire, so the flip has to be sent between bands. urgent_max_us is the
+ * longest a flip waited, at most about one band of chunk_bytes. */
+static void bench_cmdq(bench_t *b)
+{
+    const rphub75_bench_config_t *config = b->config;
+    cmdq_config_t cmdq_config = CMDQ_CONFIG_DEFAULT();
+    cmdq_t q;
+    if (cmdq_init(&q, &cmdq_config) != ESP_OK)
+    {
+        ESP_LOGE(TAG, "cmdq_init failed");
+        return;
+    }
+
+    for (uint32_t i = 0; i < config->frames; i++)
+    {
+        draw_gradient(b, i);
+        b->counter.flip_fb = swap_chain[(i + 1) & 1];
+        b->counter.flip_queue = &q;
+        cmdq_draw(&q, swap_chain[i & 1], 0, 0, b->frame, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, NULL, NULL);
+        /* the frame is drawn again in place, so wait for it to be sent */
+        cmdq_wait_idle(&q, portMAX_DELAY);
+    }
+
+    cmdq_stats_t st;
+    cmdq_get_stats(&q, &st);
+    cmdq_deinit(&q);
+    printf("{\"cmdq\":\"flip_during_full_frame\",\"target\":\"%s\",\"frames\":%lu,\"chunk_bytes\":%lu,"
+           "\"chunks\":%lu,\"urgent\":%lu,\"preempted\":%lu,\"urgent_avg_us\":%.1f,\"urgent_max_us\":%lu}\n",
+           CONFIG_IDF_TARGET, (unsigned long)config->frames, (unsigned long)cmdq_config.chunk_bytes,
+           (unsigned long)st.chunks, (unsigned long)st.urgent, (unsigned long)st.preempted,
+           st.urgent ? (float)st.urgent_total_us / (float)st.urgent : 0.0f, (unsigned long)st.urgent_max_us);
+}
+
+esp_err_t rphub75_bench_run(const rphub75_bench_config_t *config)
+{
+    if (config == NULL || config->frames == 0 || config->spi_clock_hz == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    bench_t b = {.config = config};
+    esp_err_t ret = rphub75_get_transport(&b.counter.inner);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "No transport installed");
+        return ret;
+    }
+
+    size_t frame_size = FRAME_PIXELS * sizeof(rpio_rgb_t);
+    b.frame = rphub75_fb_alloc(RP_HUB75_WIDTH, RP_HUB75_HEIGHT);
+    b.background = malloc(frame_size);
+    if (b.frame == NULL || b.background == NULL)
+    {
+        rphub75_fb_free(b.frame);
+        free(b.background);
+        return ESP_ERR_NO_MEM;
+    }
+    ret = shadowfb_init(&b.shadow, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, swap_chain, sizeof(swap_chain));
+    if (ret == ESP_OK)
+        ret = shadowfb_set_compression(&b.shadow, true);
+    if (ret != ESP_OK)
+    {
+        shadowfb_deinit(&b.shadow);
+        rphub75_fb_free(b.frame);
+        free(b.background);
+        return ret;
+    }
+
+    for (int y = 0; y < RP_HUB75_HEIGHT; y++)
+    {
+        for (int x = 0; x < RP_HUB75_WIDTH; x++)
+        {
+            b.background[y * RP_HUB75_WIDTH + x] = rgba(40, 80, 160, (float)(x + y) / (RP_HUB75_WIDTH + RP_HUB75_HEIGHT));
+        }
+    }
+
+    rphub75_transport_t counting = {.transfer = bench_transfer, .ctx = &b.counter};
+    rphub75_set_transport(&counting);
+
+    bench_kernels(&b);
+    bench_workload(&b, "full_frame", frame_full);
+    rpio_hub75_init_t init;
+    display_get_init(&init);
+    if (bitplane_layout_init(&s_planes, &init, 6) == ESP_OK)
+        bench_workload(&b, "full_frame_planes", frame_full_planes);
+    bench_workload(&b, "sprite", frame_sprite);
+    bench_workload(&b, "ticker", frame_ticker);
+    bench_workload(&b, "blit_scroll", frame_blit);
+    bench_workload(&b, "fb_scroll", frame_scroll);
+    s_player = (Player)PLAYER_START;
+    if (level_init(&s_level, RP_HUB75_WIDTH, RP_HUB75_HEIGHT, envItems, envItemsLength) == ESP_OK)
+    {
+        bench_workload(&b, "platformer", frame_platformer);
+        level_deinit(&s_level);
+    }
+    if (bench_scene_setup(&b) == ESP_OK)
+        bench_workload(&b, "atlas_scene", frame_scene);
+    scene_deinit(&b.scene);
+    bench_cmdq(&b);
+
+    rphub75_set_transport(&b.counter.inner);
+    shadowfb_deinit(&b.shadow);
+    rphub75_fb_free(b.frame);
+    free(b.background);
+    return ESP_OK;
+}
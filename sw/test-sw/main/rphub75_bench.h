@@ -0,0 +1,45 @@
+// rphub75_bench.h
+// Reproducible benchmark of the drawing and transfer paths. Every workload
+// runs a fixed number of frames through the installed transport, which is
+// wrapped to count bytes and DMA transactions, and prints one JSON object per
+// line to stdout:
+//
+//   {"bench":"sprite","target":"esp32s3","frames":300,"clock_hz":20000000,
+//    "cpu_us":412.5,"link_us":98.2,"bytes":245.1,"transactions":3.00,
+//    "est_fps":1950.1}
+//
+// cpu_us is the time per frame outside the transport, bytes, transactions and
+// link_us are per frame, link_us is modeled from the SPI clock. est_fps assumes
+// the CPU waits for the link as the blocking fb_* API does. Kernel entries
+// report ns_per_op instead, and the "cmdq" entry how long urgent flips waited
+// while full-frame draws went through a command queue (urgent_max_us).
+
+#ifndef RPHUB75_BENCH_H
+#define RPHUB75_BENCH_H
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+
+typedef struct
+{
+    uint32_t spi_clock_hz;     // clock the link time is estimated for
+    uint32_t transaction_ns;   // fixed cost per DMA transaction
+    uint32_t frames;           // frames per workload
+    uint32_t kernel_ops;       // iterations per kernel benchmark
+} rphub75_bench_config_t;
+
+#define RPHUB75_BENCH_CONFIG_DEFAULT()   \
+    {                                    \
+        .spi_clock_hz = RP_SPI_CLOCK_HZ, \
+        .transaction_ns = 15000,         \
+        .frames = 300,                   \
+        .kernel_ops = 20000,             \
+    }
+
+// Runs all workloads against the installed transport (see
+// rphub75_set_transport) after display_init. Leaves framebuffers 0-2 drawn.
+esp_err_t rphub75_bench_run(const rphub75_bench_config_t *config);
+
+#endif // RPHUB75_BENCH_H
@@ -0,0 +1,229 @@
+// rphub75_cmdlist.c
+// Command list builder, see rphub75_cmdlist.h
+
+#include "esp_log.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+
+#include "rphub75.h"
+#include "rphub75_proto.h"
+#include "rphub75_codec.h"
+#include "rphub75_cmdlist.h"
+
+static const char *TAG = "RPHUB75_CMDLIST";
+
+esp_err_t cmdlist_init(cmdlist_t *cl, size_t capacity)
+{
+    if (cl == NULL || capacity <= RPHUB75_BATCH_HEADER_SIZE + RPHUB75_ENTRY_HEADER_SIZE ||
+        capacity > RPHUB75_BATCH_HEADER_SIZE + UINT16_MAX)
+        return ESP_ERR_INVALID_ARG;
+
+    cl->buf = rphub75_dma_alloc(capacity);
+    if (cl->buf == NULL)
+    {
+        ESP_LOGE(TAG, "cmdlist_init: allocation of %zu bytes failed", capacity);
+        return ESP_ERR_NO_MEM;
+    }
+    cl->capacity = capacity;
+    cmdlist_reset(cl);
+    return ESP_OK;
+}
+
+void cmdlist_deinit(cmdlist_t *cl)
+{
+    rphub75_dma_free(cl->buf);
+    cl->buf = NULL;
+    cl->capacity = 0;
+    cl->len = 0;
+    cl->count = 0;
+}
+
+void cmdlist_reset(cmdlist_t *cl)
+{
+    rphub75_encode_list_header(cl->buf, 0);
+    cl->len = RPHUB75_BATCH_HEADER_SIZE;
+    cl->count = 0;
+}
+
+esp_err_t cmdlist_flush(cmdlist_t *cl)
+{
+    if (cl->count == 0)
+        return ESP_OK;
+
+    rphub75_encode_list_header(cl->buf, (uint16_t)(cl->len - RPHUB75_BATCH_HEADER_SIZE));
+    esp_err_t ret = spi_send_data(cl->buf, cl->len);
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "cmdlist_flush: %u commands, %zu bytes failed: %s",
+                 (unsigned)cl->count, cl->len, esp_err_to_name(ret));
+    cmdlist_reset(cl);
+    return ret;
+}
+
+/* Largest payload a single entry can carry in this list. */
+static inline size_t cmdlist_max_payload(const cmdlist_t *cl)
+{
+    return cl->capacity - RPHUB75_BATCH_HEADER_SIZE - RPHUB75_ENTRY_HEADER_SIZE;
+}
+
+/* Encodes an entry with `args` and returns where its `payload_len` bytes of
+ * payload go (NULL if none), flushing the list first if the entry does not
+ * fit. */
+static esp_err_t cmdlist_append(cmdlist_t *cl, uint8_t ctype, uint8_t cmd, const void *args,
+                                size_t payload_len, uint8_t **payload)
+{
+    const rphub75_cmd_desc_t *desc = rphub75_cmd_desc(ctype, cmd);
+    if (desc == NULL)
+        return ESP_ERR_NOT_SUPPORTED;
+    size_t len = desc->size + payload_len;
+    if (len > cmdlist_max_payload(cl))
+        return ESP_ERR_INVALID_SIZE;
+
+    if (cl->len + RPHUB75_ENTRY_HEADER_SIZE + len > cl->capacity)
+    {
+        esp_err_t ret = cmdlist_flush(cl);
+        if (ret != ESP_OK)
+            return ret;
+    }
+
+    size_t n = rphub75_encode_entry(&cl->buf[cl->len], cl->capacity - cl->len, ctype, cmd, args,
+                                    (uint32_t)payload_len);
+    if (n == 0)
+        return ESP_ERR_INVALID_ARG;
+    if (payload != NULL)
+        *payload = &cl->buf[cl->len + n];
+    cl->len += RPHUB75_ENTRY_HEADER_SIZE + len;
+    cl->count++;
+    return ESP_OK;
+}
+
+esp_err_t cmdlist_clear(cmdlist_t *cl, uint8_t fb_index, rpio_rgb_t color)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_clear_t clear_struct = {
+        .color = color,
+        .fb = fb_index,
+    };
+    return cmdlist_append(cl, rpio_ctype_fb, rpio_fb_clear_cmd, &clear_struct, 0, NULL);
+}
+
+esp_err_t cmdlist_blit(cmdlist_t *cl, uint8_t src_fb, uint8_t dst_fb,
+                       uint16_t src_x, uint16_t src_y,
+                       uint16_t dst_x, uint16_t dst_y,
+                       uint16_t w, uint16_t h)
+{
+    if (src_fb >= RP_FB_COUNT || dst_fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_blit_t blit_struct = {
+        .src_x = src_x,
+        .src_y = src_y,
+        .dst_x = dst_x,
+        .dst_y = dst_y,
+        .w = w,
+        .h = h,
+        .src_fb = src_fb,
+        .dst_fb = dst_fb,
+    };
+    return cmdlist_append(cl, rpio_ctype_fb, rpio_fb_blit_cmd, &blit_struct, 0, NULL);
+}
+
+esp_err_t cmdlist_draw(cmdlist_t *cl, uint8_t fb_index, uint16_t x, uint16_t y,
+                       const rpio_rgb_t *bitmap, uint16_t w, uint16_t h)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if ((size_t)w * h > 0 && bitmap == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    size_t row_size = (size_t)w * sizeof(rpio_rgb_t);
+    size_t max_payload = cmdlist_max_payload(cl);
+    if (sizeof(rpio_fb_draw_t) + row_size > max_payload)
+    {
+        ESP_LOGE(TAG, "cmdlist_draw: a %u pixel row does not fit into the list", (unsigned)w);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* whole rows that fit into what is left of the list, or into an empty
+     * one; every band is a complete draw of its own */
+    uint16_t row = 0;
+    do
+    {
+        size_t room = cl->capacity - cl->len;
+        if (room < RPHUB75_ENTRY_HEADER_SIZE + sizeof(rpio_fb_draw_t) + row_size)
+            room = max_payload + RPHUB75_ENTRY_HEADER_SIZE;
+        size_t rows = row_size ? (room - RPHUB75_ENTRY_HEADER_SIZE - sizeof(rpio_fb_draw_t)) / row_size : h;
+        if (rows > (size_t)(h - row))
+            rows = h - row;
+
+        rpio_fb_draw_t draw_struct = {
+            .x = x,
+            .y = y + row,
+            .w = w,
+            .h = (uint16_t)rows,
+            .fb = fb_index,
+        };
+        uint8_t *p;
+        esp_err_t ret = cmdlist_append(cl, rpio_ctype_fb, rpio_fb_draw_cmd, &draw_struct,
+                                       rows * row_size, &p);
+        if (ret != ESP_OK)
+            return ret;
+        if (rows > 0 && row_size > 0)
+            memcpy(p, bitmap + (size_t)row * w, rows * row_size);
+        row += rows;
+    } while (row < h);
+
+    return ESP_OK;
+}
+
+esp_err_t cmdlist_draw_packed(cmdlist_t *cl, uint8_t fb_index, uint8_t ref_fb,
+                              uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                              const uint8_t *data, uint32_t size)
+{
+    if (fb_index >= RP_FB_COUNT || ref_fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    if (size > 0 && data == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    rphub75_fb_draw_packed_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+        .ref_fb = ref_fb,
+        .size = size,
+    };
+    uint8_t *p;
+    esp_err_t ret = cmdlist_append(cl, rpio_ctype_fb, rphub75_fb_draw_packed_cmd, &draw_struct, size, &p);
+    if (ret != ESP_OK)
+        return ret;
+    if (size > 0)
+        memcpy(p, data, size);
+    return ESP_OK;
+}
+
+esp_err_t cmdlist_flip(cmdlist_t *cl, uint8_t fb_index)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_hub75_flip_t flip_struct = {
+        .fb = fb_index,
+    };
+    return cmdlist_append(cl, rpio_ctype_hub75, rpio_hub75_flip_cmd, &flip_struct, 0, NULL);
+}
+
+esp_err_t cmdlist_command(cmdlist_t *cl, uint8_t ctype, uint8_t cmd, const void *args,
+                          const void *payload, size_t payload_len)
+{
+    if (payload_len > 0 && payload == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t *p;
+    esp_err_t ret = cmdlist_append(cl, ctype, cmd, args, payload_len, &p);
+    if (ret == ESP_OK && payload_len > 0)
+        memcpy(p, payload, payload_len);
+    return ret;
+}
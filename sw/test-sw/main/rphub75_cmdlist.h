@@ -0,0 +1,51 @@
+// rphub75_cmdlist.h
+// Command lists: many framebuffer operations appended into one preallocated
+// DMA buffer and sent as a single SPI transaction.
+
+#ifndef RPHUB75_CMDLIST_H
+#define RPHUB75_CMDLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#define RP_CMDLIST_SIZE 8192 // Default buffer size, must not exceed 65535 + 3
+
+typedef struct
+{
+    uint8_t *buf;    // DMA-capable, starts with the container header
+    size_t capacity;
+    size_t len;      // bytes used including the container header
+    uint16_t count;  // commands in the list
+} cmdlist_t;
+
+esp_err_t cmdlist_init(cmdlist_t *cl, size_t capacity);
+void cmdlist_deinit(cmdlist_t *cl);
+
+// Drops everything appended since the last flush.
+void cmdlist_reset(cmdlist_t *cl);
+
+// Appending flushes the list first when the command does not fit. Draws that
+// are larger than the whole buffer are split into bands of rows.
+esp_err_t cmdlist_clear(cmdlist_t *cl, uint8_t fb_index, rpio_rgb_t color);
+esp_err_t cmdlist_blit(cmdlist_t *cl, uint8_t src_fb, uint8_t dst_fb,
+                       uint16_t src_x, uint16_t src_y,
+                       uint16_t dst_x, uint16_t dst_y,
+                       uint16_t w, uint16_t h);
+esp_err_t cmdlist_draw(cmdlist_t *cl, uint8_t fb_index, uint16_t x, uint16_t y,
+                       const rpio_rgb_t *bitmap, uint16_t w, uint16_t h);
+esp_err_t cmdlist_draw_packed(cmdlist_t *cl, uint8_t fb_index, uint8_t ref_fb,
+                              uint16_t x, uint16_t y, uint16_t w, uint16_t h,
+                              const uint8_t *data, uint32_t size);
+esp_err_t cmdlist_flip(cmdlist_t *cl, uint8_t fb_index);
+
+// Any command rphub75_codec.h knows: `args` is its struct in host order,
+// followed by `payload_len` bytes of `payload`.
+esp_err_t cmdlist_command(cmdlist_t *cl, uint8_t ctype, uint8_t cmd, const void *args,
+                          const void *payload, size_t payload_len);
+
+// Sends the list as one transaction and empties it. An empty list sends nothing.
+esp_err_t cmdlist_flush(cmdlist_t *cl);
+
+#endif // RPHUB75_CMDLIST_H
@@ -0,0 +1,645 @@
+// rphub75_cmdq.c
+// Multi-producer command rings drained by a link owner task, see rphub75_cmdq.h
+
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/semphr.h"
+
+#include "rphub75_cmdq.h"
+#include "rphub75_input.h"
+
+static const char *TAG = "RPHUB75_CMDQ";
+
+#define CMDQ_NO_FB 0xFF
+
+typedef enum
+{
+    CMDQ_INLINE, // command and payload in the slot
+    CMDQ_BULK,   // draw whose bitmap stays with the producer
+    CMDQ_POLL,   // rphub75_input_poll
+    CMDQ_FENCE,  // signal `fence` once everything before it is sent
+    CMDQ_STOP,   // like a fence, then the owner exits
+} cmdq_kind_t;
+
+/* Signalled by the owner when it reaches a fence. A semaphore rather than
+ * the waiter's task notification, which frame_sched and the animation
+ * player sleep on too; the waiter and the owner each hold a reference, as
+ * the waiter may give up first. */
+typedef struct
+{
+    SemaphoreHandle_t done;
+    atomic_int refs;
+} cmdq_fence_t;
+
+/* A slot belongs to the producer that claimed it until its seq is published
+ * as pos + 1, then to the owner until it stores pos + capacity, which makes
+ * it claimable for the next lap of the ring. */
+struct cmdq_slot
+{
+    atomic_uint seq;
+    uint8_t kind;
+    uint8_t type;
+    uint8_t cmd;
+    uint8_t len;   // inline payload bytes
+    uint8_t fb[2]; // framebuffers the command touches, CMDQ_NO_FB if none
+    bool held;     // urgent: counted in stats.held
+    uint32_t after; // urgent: fb_queued[fb[0]] when it was queued
+    int64_t queued_us;
+    uint8_t args[RPHUB75_ARGS_MAX];
+    union
+    {
+        uint8_t payload[RP_CMDQ_INLINE];
+        struct
+        {
+            const rpio_rgb_t *bitmap;
+            uint32_t size;
+            rphub75_done_cb_t done_cb;
+            void *arg;
+        } bulk;
+        int64_t max_age_us;
+        cmdq_fence_t *fence;
+    };
+};
+
+// Producers
+
+/* One compare-and-swap on the tail when uncontended. A producer only goes
+ * round again when another one took the same slot first, so some producer
+ * always makes progress, and it never waits for the owner. NULL when the
+ * ring is full. A fetch_add claim would be wait-free, but a producer could
+ * not give back a position it took past a full ring: it would have to wait
+ * for the owner, which CMDQ_OVERFLOW_FAIL promises not to do. */
+static cmdq_slot_t *cmdq_claim(cmdq_t *q, cmdq_ring_t *r, uint32_t *out_pos)
+{
+    uint32_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    for (;;)
+    {
+        cmdq_slot_t *s = &r->slots[pos & r->mask];
+        uint32_t seq = atomic_load_explicit(&s->seq, memory_order_acquire);
+        int32_t diff = (int32_t)(seq - pos);
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                *out_pos = pos;
+                return s;
+            }
+            atomic_fetch_add_explicit(&q->retries, 1, memory_order_relaxed);
+        }
+        else if (diff < 0)
+        {
+            return NULL; // the owner has not freed this slot from the last lap
+        }
+        else
+        {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+/* Claims a slot, applying the overflow policy when the ring is full. */
+static cmdq_slot_t *cmdq_claim_policy(cmdq_t *q, cmdq_prio_t prio, uint32_t *pos, bool forever)
+{
+    cmdq_ring_t *r = &q->rings[prio];
+    cmdq_slot_t *s = cmdq_claim(q, r, pos);
+    if (s != NULL)
+        return s;
+
+    atomic_fetch_add_explicit(&q->full, 1, memory_order_relaxed);
+    if (forever || q->config.overflow == CMDQ_OVERFLOW_WAIT)
+    {
+        for (TickType_t waited = 0; s == NULL && (forever || waited < q->config.wait_ticks); waited++)
+        {
+            vTaskDelay(1);
+            s = cmdq_claim(q, r, pos);
+        }
+    }
+    if (s == NULL)
+        atomic_fetch_add_explicit(&q->rejected, 1, memory_order_relaxed);
+    return s;
+}
+
+/* Normal commands count themselves against their framebuffers before they
+ * are published, urgent ones note how many there were: everything counted
+ * by then has to be passed on before the urgent command may be. */
+static void cmdq_publish(cmdq_t *q, cmdq_prio_t prio, cmdq_slot_t *s, uint32_t pos)
+{
+    s->held = false;
+    if (prio == CMDQ_PRIO_URGENT)
+    {
+        s->queued_us = esp_timer_get_time();
+        if (s->fb[0] != CMDQ_NO_FB)
+            s->after = atomic_load_explicit(&q->fb_queued[s->fb[0]], memory_order_relaxed);
+    }
+    else
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            if (s->fb[i] != CMDQ_NO_FB && (i == 0 || s->fb[1] != s->fb[0]))
+                atomic_fetch_add_explicit(&q->fb_queued[s->fb[i]], 1, memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&s->seq, pos + 1, memory_order_release);
+    xTaskNotifyGive(q->owner);
+}
+
+static esp_err_t cmdq_push(cmdq_t *q, cmdq_prio_t prio, uint8_t type, uint8_t cmd, uint8_t fb0, uint8_t fb1,
+                           const void *args, size_t args_size, const void *payload, size_t len)
+{
+    if (q == NULL || q->owner == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    uint32_t pos;
+    cmdq_slot_t *s = cmdq_claim_policy(q, prio, &pos, false);
+    if (s == NULL)
+        return q->config.overflow == CMDQ_OVERFLOW_WAIT ? ESP_ERR_TIMEOUT : ESP_ERR_NO_MEM;
+    s->kind = CMDQ_INLINE;
+    s->type = type;
+    s->cmd = cmd;
+    s->len = (uint8_t)len;
+    s->fb[0] = fb0;
+    s->fb[1] = fb1;
+    memcpy(s->args, args, args_size);
+    if (len > 0)
+        memcpy(s->payload, payload, len);
+    cmdq_publish(q, prio, s, pos);
+    return ESP_OK;
+}
+
+static esp_err_t cmdq_push_clear(cmdq_t *q, cmdq_prio_t prio, uint8_t fb_index, rpio_rgb_t color)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_clear_t clear_struct = {
+        .color = color,
+        .fb = fb_index,
+    };
+    return cmdq_push(q, prio, rpio_ctype_fb, rpio_fb_clear_cmd, fb_index, CMDQ_NO_FB,
+                     &clear_struct, sizeof(clear_struct), NULL, 0);
+}
+
+esp_err_t cmdq_clear(cmdq_t *q, uint8_t fb_index, rpio_rgb_t color)
+{
+    return cmdq_push_clear(q, CMDQ_PRIO_NORMAL, fb_index, color);
+}
+
+esp_err_t cmdq_clear_urgent(cmdq_t *q, uint8_t fb_index, rpio_rgb_t color)
+{
+    return cmdq_push_clear(q, CMDQ_PRIO_URGENT, fb_index, color);
+}
+
+esp_err_t cmdq_blit(cmdq_t *q, uint8_t src_fb, uint8_t dst_fb,
+                    uint16_t src_x, uint16_t src_y,
+                    uint16_t dst_x, uint16_t dst_y,
+                    uint16_t w, uint16_t h)
+{
+    if (src_fb >= RP_FB_COUNT || dst_fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_blit_t blit_struct = {
+        .src_x = src_x,
+        .src_y = src_y,
+        .dst_x = dst_x,
+        .dst_y = dst_y,
+        .w = w,
+        .h = h,
+        .src_fb = src_fb,
+        .dst_fb = dst_fb,
+    };
+    return cmdq_push(q, CMDQ_PRIO_NORMAL, rpio_ctype_fb, rpio_fb_blit_cmd, src_fb, dst_fb,
+                     &blit_struct, sizeof(blit_struct), NULL, 0);
+}
+
+esp_err_t cmdq_draw(cmdq_t *q, uint8_t fb_index, uint16_t x, uint16_t y,
+                    const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                    rphub75_done_cb_t done_cb, void *arg)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+    size_t size = (size_t)w * h * sizeof(rpio_rgb_t);
+    if (size > 0 && bitmap == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_fb_draw_t draw_struct = {
+        .x = x,
+        .y = y,
+        .w = w,
+        .h = h,
+        .fb = fb_index,
+    };
+    if (size <= RP_CMDQ_INLINE)
+    {
+        esp_err_t ret = cmdq_push(q, CMDQ_PRIO_NORMAL, rpio_ctype_fb, rpio_fb_draw_cmd, fb_index, CMDQ_NO_FB,
+                                  &draw_struct, sizeof(draw_struct), bitmap, size);
+        if (ret == ESP_OK && done_cb != NULL)
+            done_cb(bitmap, ESP_OK, arg);
+        return ret;
+    }
+
+    if (q == NULL || q->owner == NULL)
+        return ESP_ERR_INVALID_STATE;
+    uint32_t pos;
+    cmdq_slot_t *s = cmdq_claim_policy(q, CMDQ_PRIO_NORMAL, &pos, false);
+    if (s == NULL)
+        return q->config.overflow == CMDQ_OVERFLOW_WAIT ? ESP_ERR_TIMEOUT : ESP_ERR_NO_MEM;
+    s->kind = CMDQ_BULK;
+    s->type = rpio_ctype_fb;
+    s->cmd = rpio_fb_draw_cmd;
+    s->fb[0] = fb_index;
+    s->fb[1] = CMDQ_NO_FB;
+    memcpy(s->args, &draw_struct, sizeof(draw_struct));
+    s->bulk.bitmap = bitmap;
+    s->bulk.size = (uint32_t)size;
+    s->bulk.done_cb = done_cb;
+    s->bulk.arg = arg;
+    cmdq_publish(q, CMDQ_PRIO_NORMAL, s, pos);
+    return ESP_OK;
+}
+
+esp_err_t cmdq_flip(cmdq_t *q, uint8_t fb_index)
+{
+    if (fb_index >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    rpio_hub75_flip_t flip_struct = {
+        .fb = fb_index,
+    };
+    return cmdq_push(q, CMDQ_PRIO_URGENT, rpio_ctype_hub75, rpio_hub75_flip_cmd, fb_index, CMDQ_NO_FB,
+                     &flip_struct, sizeof(flip_struct), NULL, 0);
+}
+
+esp_err_t cmdq_poll_input(cmdq_t *q, int64_t max_age_us)
+{
+    if (q == NULL || q->owner == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    uint32_t pos;
+    cmdq_slot_t *s = cmdq_claim_policy(q, CMDQ_PRIO_URGENT, &pos, false);
+    if (s == NULL)
+        return q->config.overflow == CMDQ_OVERFLOW_WAIT ? ESP_ERR_TIMEOUT : ESP_ERR_NO_MEM;
+    s->kind = CMDQ_POLL;
+    s->fb[0] = CMDQ_NO_FB;
+    s->fb[1] = CMDQ_NO_FB;
+    s->max_age_us = max_age_us;
+    cmdq_publish(q, CMDQ_PRIO_URGENT, s, pos);
+    return ESP_OK;
+}
+
+static cmdq_fence_t *cmdq_fence_create(void)
+{
+    cmdq_fence_t *fence = malloc(sizeof(*fence));
+    if (fence == NULL)
+        return NULL;
+    fence->done = xSemaphoreCreateBinary();
+    if (fence->done == NULL)
+    {
+        free(fence);
+        return NULL;
+    }
+    atomic_init(&fence->refs, 2);
+    return fence;
+}
+
+static void cmdq_fence_release(cmdq_fence_t *fence)
+{
+    if (atomic_fetch_sub(&fence->refs, 1) == 1)
+    {
+        vSemaphoreDelete(fence->done);
+        free(fence);
+    }
+}
+
+/* Fences go through the normal ring. When the owner reaches one it sends
+ * every urgent command it can before signalling: those queued before the
+ * fence only wait for normal commands queued before them, which are sent
+ * by then, so none of them is left behind. */
+static esp_err_t cmdq_fence(cmdq_t *q, cmdq_kind_t kind, TickType_t wait)
+{
+    cmdq_fence_t *fence = cmdq_fence_create();
+    if (fence == NULL)
+        return ESP_ERR_NO_MEM;
+    uint32_t pos;
+    cmdq_slot_t *s = cmdq_claim_policy(q, CMDQ_PRIO_NORMAL, &pos, kind == CMDQ_STOP);
+    if (s == NULL)
+    {
+        /* never queued, the owner's reference goes too */
+        cmdq_fence_release(fence);
+        cmdq_fence_release(fence);
+        return ESP_ERR_TIMEOUT;
+    }
+    s->kind = kind;
+    s->fb[0] = CMDQ_NO_FB;
+    s->fb[1] = CMDQ_NO_FB;
+    s->fence = fence;
+    cmdq_publish(q, CMDQ_PRIO_NORMAL, s, pos);
+    esp_err_t ret = xSemaphoreTake(fence->done, wait) == pdTRUE ? ESP_OK : ESP_ERR_TIMEOUT;
+    cmdq_fence_release(fence);
+    return ret;
+}
+
+esp_err_t cmdq_wait_idle(cmdq_t *q, TickType_t wait)
+{
+    if (q == NULL || q->owner == NULL)
+        return ESP_ERR_INVALID_STATE;
+    return cmdq_fence(q, CMDQ_FENCE, wait);
+}
+
+// Link owner
+
+static cmdq_slot_t *cmdq_peek(cmdq_t *q, cmdq_ring_t *r, uint32_t pos)
+{
+    cmdq_slot_t *s = &r->slots[pos & r->mask];
+    if (atomic_load_explicit(&s->seq, memory_order_acquire) != pos + 1)
+        return NULL;
+
+    uint32_t depth = atomic_load_explicit(&r->tail, memory_order_relaxed) - r->head;
+    if (depth > q->stats.max_depth)
+        q->stats.max_depth = depth;
+    return s;
+}
+
+static void cmdq_release(cmdq_ring_t *r, cmdq_slot_t *s)
+{
+    atomic_store_explicit(&s->seq, r->head + r->mask + 1, memory_order_release);
+    r->head++;
+}
+
+static void cmdq_flush(cmdq_t *q)
+{
+    if (q->list.count == 0)
+        return;
+    q->stats.lists++;
+    if (cmdlist_flush(&q->list) != ESP_OK)
+        q->stats.errors++;
+}
+
+/* A normal command is in the list; urgent ones waiting on it may follow. */
+static void cmdq_passed(cmdq_t *q, const cmdq_slot_t *s)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (s->fb[i] != CMDQ_NO_FB && (i == 0 || s->fb[1] != s->fb[0]))
+            q->fb_sent[s->fb[i]]++;
+    }
+}
+
+/* Sends the urgent commands at the head of their ring that are not waiting
+ * for normal ones, in order, along with whatever the list holds. */
+static bool cmdq_send_urgent(cmdq_t *q)
+{
+    cmdq_ring_t *r = &q->rings[CMDQ_PRIO_URGENT];
+    uint32_t pos = r->head;
+    cmdq_slot_t *s;
+    while ((s = cmdq_peek(q, r, pos)) != NULL)
+    {
+        if (s->fb[0] != CMDQ_NO_FB && (int32_t)(q->fb_sent[s->fb[0]] - s->after) < 0)
+        {
+            if (!s->held)
+            {
+                s->held = true;
+                q->stats.held++;
+            }
+            break;
+        }
+
+        q->stats.commands++;
+        q->stats.urgent++;
+        if (q->bulk != NULL)
+            q->stats.preempted++;
+        if (s->kind == CMDQ_POLL)
+        {
+            cmdq_flush(q);
+            if (rphub75_input_poll(s->max_age_us) != ESP_OK)
+                q->stats.errors++;
+        }
+        else if (cmdlist_command(&q->list, s->type, s->cmd, s->args, s->payload, s->len) != ESP_OK)
+        {
+            q->stats.errors++;
+        }
+        pos++;
+    }
+    if (pos == r->head)
+        return false;
+
+    cmdq_flush(q);
+    int64_t now = esp_timer_get_time();
+    while (r->head != pos)
+    {
+        s = &r->slots[r->head & r->mask];
+        uint32_t latency = (uint32_t)(now - s->queued_us);
+        if (latency > q->stats.urgent_max_us)
+            q->stats.urgent_max_us = latency;
+        q->stats.urgent_total_us += latency;
+        cmdq_release(r, s);
+    }
+    return true;
+}
+
+/* One band of rows of the draw in progress, as a draw command of its own
+ * sent straight from the producer's bitmap. */
+static void cmdq_send_band(cmdq_t *q)
+{
+    cmdq_slot_t *s = q->bulk;
+    rpio_fb_draw_t draw_struct;
+    memcpy(&draw_struct, s->args, sizeof(draw_struct));
+
+    uint16_t h = draw_struct.h;
+    uint32_t row_bytes = (uint32_t)draw_struct.w * sizeof(rpio_rgb_t);
+    uint32_t rows = q->config.chunk_bytes / row_bytes;
+    if (rows == 0)
+        rows = 1;
+    if (rows > (uint32_t)(h - q->bulk_row))
+        rows = h - q->bulk_row;
+    const uint8_t *data = (const uint8_t *)s->bulk.bitmap + (size_t)q->bulk_row * row_bytes;
+    draw_struct.y += q->bulk_row;
+    draw_struct.h = (uint16_t)rows;
+
+    if (q->bulk_ret == ESP_OK)
+    {
+        uint8_t header[2 + RPHUB75_ARGS_MAX];
+        size_t n = rphub75_encode(header, sizeof(header), s->type, s->cmd, &draw_struct);
+
+        /* the lock keeps direct callers on the same board out of the middle */
+        rphub75_lock();
+        esp_err_t ret = spi_send_data(header, (uint32_t)n);
+        if (ret == ESP_OK)
+            ret = spi_send_data(data, rows * row_bytes);
+        rphub75_unlock();
+        q->stats.chunks++;
+        q->bulk_ret = ret;
+    }
+    q->bulk_row += rows;
+    if (q->bulk_row < h && q->bulk_ret == ESP_OK)
+        return;
+
+    q->stats.bulk++;
+    if (q->bulk_ret != ESP_OK)
+    {
+        q->stats.errors++;
+        ESP_LOGE(TAG, "draw failed: %s", esp_err_to_name(q->bulk_ret));
+    }
+    cmdq_passed(q, s);
+    if (s->bulk.done_cb != NULL)
+        s->bulk.done_cb(s->bulk.bitmap, q->bulk_ret, s->bulk.arg);
+    q->bulk = NULL;
+    cmdq_release(&q->rings[CMDQ_PRIO_NORMAL], s);
+}
+
+static void cmdq_task(void *param)
+{
+    cmdq_t *q = param;
+    rphub75_bind(q->config.dev);
+    cmdq_ring_t *r = &q->rings[CMDQ_PRIO_NORMAL];
+    cmdq_fence_t *stopper = NULL;
+
+    while (stopper == NULL)
+    {
+        /* urgent commands first, then one band or one normal command, so an
+         * urgent one is never more than a band behind */
+        bool progress = cmdq_send_urgent(q);
+        cmdq_slot_t *s;
+        if (q->bulk != NULL)
+        {
+            cmdq_send_band(q);
+            progress = true;
+        }
+        else if ((s = cmdq_peek(q, r, r->head)) != NULL)
+        {
+            q->stats.commands++;
+            progress = true;
+            switch (s->kind)
+            {
+            case CMDQ_INLINE:
+                if (cmdlist_command(&q->list, s->type, s->cmd, s->args, s->payload, s->len) != ESP_OK)
+                    q->stats.errors++;
+                cmdq_passed(q, s);
+                break;
+            case CMDQ_BULK:
+                cmdq_flush(q);
+                q->bulk = s;
+                q->bulk_row = 0;
+                q->bulk_ret = ESP_OK;
+                cmdq_send_band(q);
+                break;
+            case CMDQ_FENCE:
+                while (cmdq_send_urgent(q))
+                    ;
+                cmdq_flush(q);
+                xSemaphoreGive(s->fence->done);
+                cmdq_fence_release(s->fence);
+                break;
+            case CMDQ_STOP:
+                stopper = s->fence;
+                break;
+            }
+            if (s->kind != CMDQ_BULK)
+                cmdq_release(r, s);
+        }
+
+        /* send the list when the rings ran dry rather than wait for more, or
+         * once it is as large as a band */
+        if (!progress || q->list.len >= q->config.chunk_bytes)
+            cmdq_flush(q);
+        if (!progress)
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    while (cmdq_send_urgent(q))
+        ;
+    cmdq_flush(q);
+    xSemaphoreGive(stopper->done);
+    cmdq_fence_release(stopper);
+    vTaskDelete(NULL);
+}
+
+static bool cmdq_ring_init(cmdq_ring_t *r, uint16_t capacity)
+{
+    r->mask = capacity - 1;
+    r->slots = calloc(capacity, sizeof(cmdq_slot_t));
+    if (r->slots == NULL)
+        return false;
+    for (uint32_t i = 0; i < capacity; i++)
+        atomic_init(&r->slots[i].seq, i);
+    atomic_init(&r->tail, 0);
+    r->head = 0;
+    return true;
+}
+
+static void cmdq_free(cmdq_t *q)
+{
+    for (int i = 0; i < CMDQ_PRIO_COUNT; i++)
+    {
+        free(q->rings[i].slots);
+        q->rings[i].slots = NULL;
+    }
+}
+
+static bool cmdq_capacity_ok(uint16_t capacity)
+{
+    return capacity >= 2 && (capacity & (capacity - 1)) == 0;
+}
+
+esp_err_t cmdq_init(cmdq_t *q, const cmdq_config_t *config)
+{
+    if (q == NULL || config == NULL || !cmdq_capacity_ok(config->capacity) ||
+        !cmdq_capacity_ok(config->urgent_capacity) || config->chunk_bytes == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(q, 0, sizeof(*q));
+    q->config = *config;
+    for (int i = 0; i < RP_FB_COUNT; i++)
+        atomic_init(&q->fb_queued[i], 0);
+    if (!cmdq_ring_init(&q->rings[CMDQ_PRIO_NORMAL], config->capacity) ||
+        !cmdq_ring_init(&q->rings[CMDQ_PRIO_URGENT], config->urgent_capacity))
+    {
+        cmdq_free(q);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t ret = cmdlist_init(&q->list, config->list_size);
+    if (ret != ESP_OK)
+    {
+        cmdq_free(q);
+        return ret;
+    }
+
+    if (xTaskCreatePinnedToCore(cmdq_task, "rphub75_cmdq", RP_CMDQ_TASK_STACK, q, RP_CMDQ_TASK_PRIO,
+                                &q->owner, config->core) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to create link owner task");
+        q->owner = NULL;
+        cmdlist_deinit(&q->list);
+        cmdq_free(q);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void cmdq_deinit(cmdq_t *q)
+{
+    if (q == NULL || q->owner == NULL)
+        return;
+
+    /* without the stop queued the owner still uses the rings */
+    esp_err_t ret = cmdq_fence(q, CMDQ_STOP, portMAX_DELAY);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "cmdq_deinit: cannot stop the owner: %s", esp_err_to_name(ret));
+        return;
+    }
+    q->owner = NULL;
+    cmdlist_deinit(&q->list);
+    cmdq_free(q);
+}
+
+void cmdq_get_stats(const cmdq_t *q, cmdq_stats_t *out)
+{
+    *out = q->stats;
+    out->full = atomic_load_explicit(&q->full, memory_order_relaxed);
+    out->rejected = atomic_load_explicit(&q->rejected, memory_order_relaxed);
+    out->retries = atomic_load_explicit(&q->retries, memory_order_relaxed);
+}
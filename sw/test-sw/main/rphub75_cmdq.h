@@ -0,0 +1,170 @@
+// rphub75_cmdq.h
+// Command queue for several drawing tasks sharing one board. Producers put
+// commands into lock-free rings and return at once; a link owner task is
+// the only one that talks to the board, so producers never wait for the SPI
+// lock or for each other's transfers, and a low priority task holding the
+// link cannot stall a high priority one. The rings are lock-free rather than
+// wait-free: a producer claims its slot with a compare-and-swap and tries
+// again only when another producer won it (stats.retries).
+//
+// Small commands (clear, blit, flip and draws of up to RP_CMDQ_INLINE bytes)
+// are copied into the ring, and the owner packs runs of them into a single
+// command list transaction. Larger draws are queued by reference, like
+// fb_draw_async: the bitmap must stay valid until `done_cb` is called.
+//
+// There are two priority classes. Flips, input polls and the *_urgent calls
+// go into their own ring, which the owner looks at before every transaction:
+// large draws are sent in bands of rows of about `chunk_bytes`, each a
+// complete draw command, so an urgent command waits for at most one band
+// instead of a whole frame. An urgent command never overtakes normal ones
+// that touch the same framebuffer, so a flip still shows every draw queued
+// into that framebuffer before it.
+//
+// A full ring is handled by the queue's overflow policy: CMDQ_OVERFLOW_FAIL
+// returns ESP_ERR_NO_MEM without waiting, CMDQ_OVERFLOW_WAIT sleeps a tick
+// at a time until there is room or `wait_ticks` passed (ESP_ERR_TIMEOUT).
+//
+//   cmdq_t q;
+//   cmdq_config_t config = CMDQ_CONFIG_DEFAULT();
+//   cmdq_init(&q, &config);
+//   ...                                       // from any task
+//   cmdq_clear(&q, 1, color_black);
+//   cmdq_draw(&q, 1, 0, 0, clock_px, 32, 8, NULL, NULL);
+//   cmdq_flip(&q, 1);
+
+#ifndef RPHUB75_CMDQ_H
+#define RPHUB75_CMDQ_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "rphub75.h"
+#include "rphub75_async.h"
+#include "rphub75_cmdlist.h"
+#include "rphub75_codec.h"
+
+#define RP_CMDQ_INLINE     48   // Largest payload copied into the ring
+#define RP_CMDQ_TASK_PRIO  6
+#define RP_CMDQ_TASK_STACK 4096
+
+typedef enum
+{
+    CMDQ_OVERFLOW_FAIL = 0,
+    CMDQ_OVERFLOW_WAIT,
+} cmdq_overflow_t;
+
+typedef enum
+{
+    CMDQ_PRIO_NORMAL = 0,
+    CMDQ_PRIO_URGENT,
+    CMDQ_PRIO_COUNT,
+} cmdq_prio_t;
+
+typedef struct
+{
+    uint16_t capacity;         // slots per ring, a power of two
+    uint16_t urgent_capacity;
+    cmdq_overflow_t overflow;
+    TickType_t wait_ticks;     // CMDQ_OVERFLOW_WAIT: longest wait for room
+    rphub75_dev_t *dev;        // board the owner sends to, NULL for the default
+    size_t list_size;          // command list buffer of the owner
+    uint32_t chunk_bytes;      // pixel bytes per band of a large draw
+    BaseType_t core;
+} cmdq_config_t;
+
+#define CMDQ_CONFIG_DEFAULT()                      \
+    {                                              \
+        .capacity = 64,                            \
+        .urgent_capacity = 16,                     \
+        .overflow = CMDQ_OVERFLOW_FAIL,            \
+        .wait_ticks = pdMS_TO_TICKS(20),           \
+        .dev = NULL,                               \
+        .list_size = RP_CMDLIST_SIZE,              \
+        .chunk_bytes = RP_SPI_MAX_TRANSFER,        \
+        .core = portNUM_PROCESSORS - 1,            \
+    }
+
+typedef struct
+{
+    uint32_t commands;    // taken by the owner
+    uint32_t lists;       // command list transactions sent
+    uint32_t bulk;        // draws sent by reference
+    uint32_t chunks;      // bands those were sent in
+    uint32_t full;        // enqueues that found a ring full
+    uint32_t rejected;    // ... and gave up
+    uint32_t retries;     // producers that lost a slot to another producer
+    uint32_t max_depth;   // most slots of one ring in use at once
+    uint32_t errors;      // failed transfers
+    uint32_t urgent;      // urgent commands sent
+    uint32_t preempted;   // ... of those in the middle of a large draw
+    uint32_t held;        // ... of those that waited for a draw into their framebuffer
+    uint32_t urgent_max_us; // longest time from enqueue to the wire
+    uint64_t urgent_total_us;
+} cmdq_stats_t;
+
+typedef struct cmdq_slot cmdq_slot_t;
+
+typedef struct
+{
+    cmdq_slot_t *slots;
+    uint32_t mask;
+    atomic_uint tail;      // next slot producers claim
+    uint32_t head;         // next slot the owner takes, owner only
+} cmdq_ring_t;
+
+typedef struct
+{
+    cmdq_ring_t rings[CMDQ_PRIO_COUNT];
+    cmdq_config_t config;
+    cmdlist_t list;
+    TaskHandle_t owner;
+
+    /* normal commands per framebuffer: queued (by producers) and passed on
+     * to the list (by the owner); urgent ones wait for the count they saw */
+    atomic_uint fb_queued[RP_FB_COUNT];
+    uint32_t fb_sent[RP_FB_COUNT];
+
+    /* large draw being sent in bands, still holding its normal slot */
+    cmdq_slot_t *bulk;
+    uint16_t bulk_row;
+    esp_err_t bulk_ret;
+
+    /* counted with relaxed atomics; the owner's own counters are plain */
+    atomic_uint full;
+    atomic_uint rejected;
+    atomic_uint retries;
+    cmdq_stats_t stats;
+} cmdq_t;
+
+esp_err_t cmdq_init(cmdq_t *q, const cmdq_config_t *config);
+// Sends what is queued, then stops the owner.
+void cmdq_deinit(cmdq_t *q);
+
+esp_err_t cmdq_clear(cmdq_t *q, uint8_t fb_index, rpio_rgb_t color);
+esp_err_t cmdq_clear_urgent(cmdq_t *q, uint8_t fb_index, rpio_rgb_t color);
+esp_err_t cmdq_blit(cmdq_t *q, uint8_t src_fb, uint8_t dst_fb,
+                    uint16_t src_x, uint16_t src_y,
+                    uint16_t dst_x, uint16_t dst_y,
+                    uint16_t w, uint16_t h);
+// Copied when w * h pixels fit into RP_CMDQ_INLINE bytes; `done_cb` (may be
+// NULL) is then called right away. Otherwise `bitmap` is sent from where it is.
+esp_err_t cmdq_draw(cmdq_t *q, uint8_t fb_index, uint16_t x, uint16_t y,
+                    const rpio_rgb_t *bitmap, uint16_t w, uint16_t h,
+                    rphub75_done_cb_t done_cb, void *arg);
+// Urgent.
+esp_err_t cmdq_flip(cmdq_t *q, uint8_t fb_index);
+// Urgent rphub75_input_poll(max_age_us) from the owner; the default board only.
+esp_err_t cmdq_poll_input(cmdq_t *q, int64_t max_age_us);
+
+// Blocks until everything queued before the call has been sent, or
+// ESP_ERR_TIMEOUT after `wait`. Does not use the caller's task notification.
+esp_err_t cmdq_wait_idle(cmdq_t *q, TickType_t wait);
+
+void cmdq_get_stats(const cmdq_t *q, cmdq_stats_t *out);
+
+#endif // RPHUB75_CMDQ_H
@@ -0,0 +1,385 @@
+// rphub75_codec.c
+// Command encoder and stream decoder, see rphub75_codec.h
+
+#include <string.h>
+
+#include "rphub75_codec.h"
+
+/* bit of a field in rphub75_cmd_desc_t.wide16 / wide32 */
+#define AT(T, f) (uint16_t)(1u << offsetof(T, f))
+
+static const rphub75_cmd_desc_t s_cmds[] = {
+    {rpio_ctype_misc, rpio_misc_hwinfo_cmd, 0, RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rpio_ctype_misc, rpio_misc_stat_cmd, 0, RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rpio_ctype_hub75, rpio_hub75_init_cmd, sizeof(rpio_hub75_init_t), RPHUB75_PAYLOAD_NONE, 0, 0,
+     AT(rpio_hub75_init_t, width) | AT(rpio_hub75_init_t, height), 0},
+    {rpio_ctype_hub75, rpio_hub75_deinit_cmd, 0, RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rpio_ctype_hub75, rpio_hub75_flip_cmd, sizeof(rpio_hub75_flip_t), RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rpio_ctype_fb, rpio_fb_clear_cmd, sizeof(rpio_fb_clear_t), RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rpio_ctype_fb, rpio_fb_blit_cmd, sizeof(rpio_fb_blit_t), RPHUB75_PAYLOAD_NONE, 0, 0,
+     AT(rpio_fb_blit_t, src_x) | AT(rpio_fb_blit_t, src_y) | AT(rpio_fb_blit_t, dst_x) |
+         AT(rpio_fb_blit_t, dst_y) | AT(rpio_fb_blit_t, w) | AT(rpio_fb_blit_t, h),
+     0},
+    {rpio_ctype_fb, rpio_fb_draw_cmd, sizeof(rpio_fb_draw_t), RPHUB75_PAYLOAD_PIXELS, sizeof(rpio_rgb_t),
+     offsetof(rpio_fb_draw_t, w),
+     AT(rpio_fb_draw_t, x) | AT(rpio_fb_draw_t, y) | AT(rpio_fb_draw_t, w) | AT(rpio_fb_draw_t, h), 0},
+    {rpio_ctype_fb, rphub75_fb_draw565_cmd, sizeof(rpio_fb_draw_t), RPHUB75_PAYLOAD_PIXELS, sizeof(uint16_t),
+     offsetof(rpio_fb_draw_t, w),
+     AT(rpio_fb_draw_t, x) | AT(rpio_fb_draw_t, y) | AT(rpio_fb_draw_t, w) | AT(rpio_fb_draw_t, h), 0},
+    {rpio_ctype_fb, rphub75_fb_draw_packed_cmd, sizeof(rphub75_fb_draw_packed_t), RPHUB75_PAYLOAD_SIZED, 4,
+     offsetof(rphub75_fb_draw_packed_t, size),
+     AT(rphub75_fb_draw_packed_t, x) | AT(rphub75_fb_draw_packed_t, y) | AT(rphub75_fb_draw_packed_t, w) |
+         AT(rphub75_fb_draw_packed_t, h),
+     AT(rphub75_fb_draw_packed_t, size)},
+    {rpio_ctype_fb, rphub75_fb_draw_planes_cmd, sizeof(rphub75_fb_draw_planes_t), RPHUB75_PAYLOAD_SIZED, 4,
+     offsetof(rphub75_fb_draw_planes_t, size),
+     AT(rphub75_fb_draw_planes_t, width) | AT(rphub75_fb_draw_planes_t, height) |
+         AT(rphub75_fb_draw_planes_t, addr) | AT(rphub75_fb_draw_planes_t, count),
+     AT(rphub75_fb_draw_planes_t, size)},
+    {rphub75_ctype_link, rphub75_link_mode_cmd, sizeof(rphub75_link_mode_t), RPHUB75_PAYLOAD_NONE, 0, 0,
+     AT(rphub75_link_mode_t, timeout_ms), AT(rphub75_link_mode_t, clock_hz)},
+    {rphub75_ctype_link, rphub75_link_test_cmd, sizeof(rphub75_link_test_t), RPHUB75_PAYLOAD_SIZED, 2,
+     offsetof(rphub75_link_test_t, size),
+     AT(rphub75_link_test_t, seq) | AT(rphub75_link_test_t, size), AT(rphub75_link_test_t, crc)},
+    {rphub75_ctype_link, rphub75_link_status_cmd, 0, RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+    {rphub75_ctype_link, rphub75_link_commit_cmd, 0, RPHUB75_PAYLOAD_NONE, 0, 0, 0, 0},
+};
+
+const rphub75_cmd_desc_t *rphub75_cmd_desc(uint8_t type, uint8_t cmd)
+{
+    for (size_t i = 0; i < sizeof(s_cmds) / sizeof(s_cmds[0]); i++)
+        if (s_cmds[i].type == type && s_cmds[i].cmd == cmd)
+            return &s_cmds[i];
+    return NULL;
+}
+
+static inline uint16_t read_u16(const uint8_t *p)
+{
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t rphub75_payload_size(const rphub75_cmd_desc_t *desc, const void *args)
+{
+    const uint8_t *a = args;
+    switch (desc->payload)
+    {
+    case RPHUB75_PAYLOAD_PIXELS:
+    {
+        uint64_t n = (uint64_t)read_u16(a + desc->at) * read_u16(a + desc->at + 2) * desc->unit;
+        return n > UINT32_MAX ? UINT32_MAX : (uint32_t)n;
+    }
+    case RPHUB75_PAYLOAD_SIZED:
+        return desc->unit == 4 ? read_u32(a + desc->at) : read_u16(a + desc->at);
+    default:
+        return 0;
+    }
+}
+
+/* Copies a struct between host order and the wire. Both ESP32 and RP2350
+ * are little endian, where this is a plain copy. */
+static void swap_fields(uint8_t *dst, const uint8_t *src, const rphub75_cmd_desc_t *desc)
+{
+    /* commands without arguments may pass a NULL struct */
+    if (desc->size == 0)
+        return;
+    memcpy(dst, src, desc->size);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (uint8_t i = 0; i < desc->size; i++)
+    {
+        if (desc->wide16 & (1u << i))
+        {
+            dst[i] = src[i + 1];
+            dst[i + 1] = src[i];
+        }
+        else if (desc->wide32 & (1u << i))
+        {
+            for (uint8_t k = 0; k < 4; k++)
+                dst[i + k] = src[i + 3 - k];
+        }
+    }
+#endif
+}
+
+size_t rphub75_encode(uint8_t *dst, size_t cap, uint8_t type, uint8_t cmd, const void *args)
+{
+    const rphub75_cmd_desc_t *desc = rphub75_cmd_desc(type, cmd);
+    if (desc == NULL || cap < 2u + desc->size || (desc->size > 0 && args == NULL))
+        return 0;
+    dst[0] = type;
+    dst[1] = cmd;
+    swap_fields(&dst[2], args, desc);
+    return 2u + desc->size;
+}
+
+size_t rphub75_encode_entry(uint8_t *dst, size_t cap, uint8_t type, uint8_t cmd, const void *args,
+                            uint32_t payload_len)
+{
+    const rphub75_cmd_desc_t *desc = rphub75_cmd_desc(type, cmd);
+    if (desc == NULL || cap < (size_t)RPHUB75_ENTRY_HEADER_SIZE + desc->size || (desc->size > 0 && args == NULL) ||
+        desc->size + payload_len > UINT16_MAX)
+        return 0;
+    dst[0] = type;
+    dst[1] = cmd;
+    rphub75_put_u16le(&dst[2], (uint16_t)(desc->size + payload_len));
+    swap_fields(&dst[RPHUB75_ENTRY_HEADER_SIZE], args, desc);
+    return RPHUB75_ENTRY_HEADER_SIZE + desc->size;
+}
+
+void rphub75_encode_list_header(uint8_t *dst, uint16_t len)
+{
+    dst[0] = rphub75_ctype_batch;
+    rphub75_put_u16le(&dst[1], len);
+}
+
+// Decoder
+
+enum
+{
+    DEC_TYPE,
+    DEC_CMD,
+    DEC_LIST_LEN,
+    DEC_ENTRY_LEN,
+    DEC_ARGS,
+    DEC_PAYLOAD,
+    DEC_SKIP,
+    DEC_END,       // payload done, END goes out on the next call
+    DEC_TRUNCATED, // a list ended inside a command, the error goes out next
+};
+
+void rphub75_decoder_init(rphub75_decoder_t *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->state = DEC_TYPE;
+}
+
+void rphub75_decoder_end_transaction(rphub75_decoder_t *d)
+{
+    if (d->state == DEC_SKIP && d->skip_left == SIZE_MAX)
+        d->state = DEC_TYPE;
+}
+
+bool rphub75_decoder_idle(const rphub75_decoder_t *d)
+{
+    return d->state == DEC_TYPE && !d->in_list;
+}
+
+static void dec_error(rphub75_decoder_t *d, rphub75_decoded_t *out, rphub75_dec_error_t error)
+{
+    out->event = RPHUB75_DEC_ERROR;
+    out->error = error;
+    out->type = d->type;
+    out->cmd = d->cmd;
+    out->entry_len = d->entry_len;
+}
+
+static void dec_args_done(rphub75_decoder_t *d, rphub75_decoded_t *out)
+{
+    const rphub75_cmd_desc_t *desc = d->desc;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint8_t wire[RPHUB75_ARGS_MAX];
+    memcpy(wire, d->args.bytes, desc->size);
+    swap_fields(d->args.bytes, wire, desc);
+#endif
+    d->payload_size = rphub75_payload_size(desc, d->args.bytes);
+    d->payload_left = d->payload_size;
+
+    if (d->in_list && desc->size + (size_t)d->payload_size != d->entry_len)
+    {
+        out->payload_size = d->payload_size;
+        dec_error(d, out, RPHUB75_DEC_ENTRY_LENGTH);
+        d->skip_left = d->entry_len > desc->size ? d->entry_len - desc->size : 0;
+        d->state = DEC_SKIP;
+        return;
+    }
+
+    out->type = d->type;
+    out->cmd = d->cmd;
+    out->args = d->args.bytes;
+    out->payload_size = d->payload_size;
+    if (d->payload_size == 0)
+    {
+        out->event = RPHUB75_DEC_END;
+        d->state = DEC_TYPE;
+    }
+    else
+    {
+        out->event = RPHUB75_DEC_COMMAND;
+        d->state = DEC_PAYLOAD;
+    }
+}
+
+static void dec_command_start(rphub75_decoder_t *d, rphub75_decoded_t *out)
+{
+    d->desc = rphub75_cmd_desc(d->type, d->cmd);
+    if (d->desc == NULL)
+    {
+        dec_error(d, out, RPHUB75_DEC_UNKNOWN_COMMAND);
+        /* inside a list the entry length allows skipping just this entry */
+        d->skip_left = d->in_list ? d->entry_len : SIZE_MAX;
+        d->state = DEC_SKIP;
+        return;
+    }
+    d->args_got = 0;
+    if (d->desc->size == 0)
+        dec_args_done(d, out);
+    else
+        d->state = DEC_ARGS;
+}
+
+/* One step on at most `len` (>= 1) bytes; returns how many were used. */
+static size_t dec_step(rphub75_decoder_t *d, const uint8_t *p, size_t len, rphub75_decoded_t *out)
+{
+    switch (d->state)
+    {
+    case DEC_TYPE:
+        d->type = p[0];
+        d->len_got = 0;
+        if (p[0] == rphub75_ctype_usb && !d->in_list)
+        {
+            out->event = RPHUB75_DEC_REQUEST;
+            out->type = p[0];
+        }
+        else if (p[0] == rphub75_ctype_batch && !d->in_list)
+            d->state = DEC_LIST_LEN;
+        else
+            d->state = DEC_CMD;
+        return 1;
+
+    case DEC_CMD:
+        d->cmd = p[0];
+        if (d->in_list)
+            d->state = DEC_ENTRY_LEN;
+        else
+            dec_command_start(d, out);
+        return 1;
+
+    case DEC_LIST_LEN:
+    case DEC_ENTRY_LEN:
+        d->len_buf[d->len_got++] = p[0];
+        if (d->len_got < 2)
+            return 1;
+        if (d->state == DEC_LIST_LEN)
+        {
+            /* the two length bytes are not part of the list body */
+            d->list_left = rphub75_get_u16le(d->len_buf);
+            d->in_list = d->list_left > 0;
+            d->state = DEC_TYPE;
+            out->event = RPHUB75_DEC_LIST;
+            out->payload_size = (uint32_t)d->list_left;
+        }
+        else
+        {
+            d->entry_len = rphub75_get_u16le(d->len_buf);
+            dec_command_start(d, out);
+        }
+        return 1;
+
+    case DEC_ARGS:
+    {
+        size_t n = d->desc->size - d->args_got;
+        if (n > len)
+            n = len;
+        memcpy(&d->args.bytes[d->args_got], p, n);
+        d->args_got += (uint8_t)n;
+        if (d->args_got == d->desc->size)
+            dec_args_done(d, out);
+        return n;
+    }
+
+    case DEC_PAYLOAD:
+    {
+        size_t n = d->payload_left < len ? d->payload_left : len;
+        out->event = RPHUB75_DEC_PAYLOAD;
+        out->type = d->type;
+        out->cmd = d->cmd;
+        out->args = d->args.bytes;
+        out->payload_size = d->payload_size;
+        out->data = p;
+        out->len = n;
+        out->offset = d->payload_size - d->payload_left;
+        d->payload_left -= (uint32_t)n;
+        if (d->payload_left == 0)
+            d->state = DEC_END;
+        return n;
+    }
+
+    case DEC_SKIP:
+    {
+        if (d->skip_left == 0)
+        {
+            d->state = DEC_TYPE;
+            return 0;
+        }
+        size_t n = d->skip_left < len ? d->skip_left : len;
+        if (d->skip_left != SIZE_MAX)
+            d->skip_left -= n;
+        if (d->skip_left == 0)
+            d->state = DEC_TYPE;
+        return n;
+    }
+    }
+    return len;
+}
+
+size_t rphub75_decode(rphub75_decoder_t *d, const uint8_t *p, size_t len, rphub75_decoded_t *out)
+{
+    *out = (rphub75_decoded_t){.event = RPHUB75_DEC_NONE};
+
+    /* events that had to wait for the previous one to be handled */
+    if (d->state == DEC_END)
+    {
+        out->event = RPHUB75_DEC_END;
+        out->type = d->type;
+        out->cmd = d->cmd;
+        out->args = d->args.bytes;
+        out->payload_size = d->payload_size;
+        d->state = DEC_TYPE;
+        return 0;
+    }
+    if (d->state == DEC_TRUNCATED)
+    {
+        dec_error(d, out, RPHUB75_DEC_LIST_TRUNCATED);
+        d->state = DEC_TYPE;
+        return 0;
+    }
+
+    size_t used = 0;
+    while (used < len && out->event == RPHUB75_DEC_NONE)
+    {
+        bool in_list = d->in_list;
+        size_t n = len - used;
+        if (in_list && n > d->list_left)
+            n = d->list_left;
+
+        n = dec_step(d, p + used, n, out);
+        used += n;
+
+        if (in_list)
+        {
+            d->list_left -= n;
+            if (d->list_left == 0)
+            {
+                d->in_list = false;
+                if (d->state == DEC_SKIP && d->skip_left == 0)
+                    d->state = DEC_TYPE;
+                else if (d->state != DEC_TYPE && d->state != DEC_END)
+                    d->state = DEC_TRUNCATED;
+                if (d->state == DEC_TRUNCATED && out->event == RPHUB75_DEC_NONE)
+                {
+                    dec_error(d, out, RPHUB75_DEC_LIST_TRUNCATED);
+                    d->state = DEC_TYPE;
+                }
+            }
+        }
+    }
+    return used;
+}
@@ -0,0 +1,158 @@
+// rphub75_codec.h
+// Wire format of every command, shared by the host library, the simulated
+// board and the firmware. A command is
+//   [byte: ctype] [byte: cmd] [struct] [payload]
+// with the struct's multi-byte fields little endian whatever the CPU, and a
+// payload whose size follows from the struct. Inside a command list each
+// entry also carries its length, see rphub75_proto.h.
+//
+// The encoder writes straight into a caller-supplied (DMA) buffer. The
+// decoder is fed the stream in chunks of any size and hands the payload back
+// as pointers into those chunks; only the struct, at most
+// RPHUB75_ARGS_MAX bytes, is gathered so it can be read in host order.
+//
+//   rphub75_decoder_t dec;
+//   rphub75_decoder_init(&dec);
+//   rphub75_decoded_t ev;
+//   for (;;)
+//   {
+//       size_t n = rphub75_decode(&dec, p, len, &ev);
+//       p += n;
+//       len -= n;
+//       if (ev.event == RPHUB75_DEC_NONE)
+//           break;               // everything consumed, wait for the next chunk
+//       ...                      // COMMAND, PAYLOAD..., END per command
+//   }
+
+#ifndef RPHUB75_CODEC_H
+#define RPHUB75_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+#include "rphub75_proto.h"
+
+#define RPHUB75_ARGS_MAX 16 // Largest command struct
+
+typedef enum
+{
+    RPHUB75_PAYLOAD_NONE = 0,
+    RPHUB75_PAYLOAD_PIXELS, // w * h pixels of `unit` bytes
+    RPHUB75_PAYLOAD_SIZED,  // a 16 or 32-bit size field of the struct
+} rphub75_payload_kind_t;
+
+// Layout of one command's struct. Bit i of wide16 / wide32 marks a 16 / 32-bit
+// field at byte offset i; every other byte goes over as it is.
+typedef struct
+{
+    uint8_t type;
+    uint8_t cmd;
+    uint8_t size;     // struct bytes following type and cmd
+    uint8_t payload;  // rphub75_payload_kind_t
+    uint8_t unit;     // bytes per pixel
+    uint8_t at;       // offset of w (h follows at at + 2) or of the size field
+    uint16_t wide16;
+    uint16_t wide32;
+} rphub75_cmd_desc_t;
+
+// Layout of a command, NULL for commands the codec does not know.
+const rphub75_cmd_desc_t *rphub75_cmd_desc(uint8_t type, uint8_t cmd);
+
+// Payload bytes following a struct in host order.
+uint32_t rphub75_payload_size(const rphub75_cmd_desc_t *desc, const void *args);
+
+// Writes [type] [cmd] [args] and returns the bytes written, 0 for an unknown
+// command or when it does not fit into `cap`. `args` is the command's struct
+// in host order (NULL for commands without one); the payload goes right after.
+size_t rphub75_encode(uint8_t *dst, size_t cap, uint8_t type, uint8_t cmd, const void *args);
+
+// The same as a command list entry, [type] [cmd] [uint16: length] [args],
+// for `payload_len` bytes of payload the caller appends.
+size_t rphub75_encode_entry(uint8_t *dst, size_t cap, uint8_t type, uint8_t cmd, const void *args,
+                            uint32_t payload_len);
+
+// [rphub75_ctype_batch] [uint16: len], the start of a command list.
+void rphub75_encode_list_header(uint8_t *dst, uint16_t len);
+
+static inline void rphub75_put_u16le(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline uint16_t rphub75_get_u16le(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+typedef enum
+{
+    RPHUB75_DEC_NONE = 0, // the chunk is used up
+    RPHUB75_DEC_REQUEST,  // single byte request `type` (rphub75_ctype_usb)
+    RPHUB75_DEC_LIST,     // a command list of `payload_size` bytes starts
+    RPHUB75_DEC_COMMAND,  // struct complete, `payload_size` bytes of payload follow
+    RPHUB75_DEC_PAYLOAD,  // `len` bytes at `data`, `offset` bytes into the payload
+    RPHUB75_DEC_END,      // command complete; `args` is valid until the next call
+    RPHUB75_DEC_ERROR,    // `error` is set; the decoder resynchronises on its own
+} rphub75_dec_event_t;
+
+typedef enum
+{
+    RPHUB75_DEC_UNKNOWN_COMMAND, // skipped: the list entry, or the rest of the transaction
+    RPHUB75_DEC_ENTRY_LENGTH,    // a list entry's length does not match its command, skipped
+    RPHUB75_DEC_LIST_TRUNCATED,  // a command list ends inside a command
+} rphub75_dec_error_t;
+
+typedef struct
+{
+    rphub75_dec_event_t event;
+    rphub75_dec_error_t error;
+    uint8_t type;
+    uint8_t cmd;
+    const void *args;       // the command's struct in host order
+    uint32_t payload_size;
+    const uint8_t *data;    // PAYLOAD: points into the chunk passed in
+    size_t len;
+    uint32_t offset;
+    size_t entry_len;       // ENTRY_LENGTH: what the entry declared
+} rphub75_decoded_t;
+
+typedef struct
+{
+    uint8_t state;
+    uint8_t type;
+    uint8_t cmd;
+    uint8_t len_got;
+    uint8_t len_buf[2];
+    uint8_t args_got;
+    const rphub75_cmd_desc_t *desc;
+    union
+    {
+        uint8_t bytes[RPHUB75_ARGS_MAX];
+        uint32_t align;
+    } args;
+    uint32_t payload_size;
+    uint32_t payload_left;
+    bool in_list;
+    size_t list_left;
+    size_t entry_len;
+    size_t skip_left;  // SIZE_MAX: until the end of the transaction
+} rphub75_decoder_t;
+
+void rphub75_decoder_init(rphub75_decoder_t *d);
+
+// Consumes bytes up to the next event and returns how many. RPHUB75_DEC_NONE
+// means all `len` bytes were used; call again (with len 0 if need be) until
+// it comes back, since an event may still be pending.
+size_t rphub75_decode(rphub75_decoder_t *d, const uint8_t *p, size_t len, rphub75_decoded_t *out);
+
+// Chip select went high. A device drops the rest of a transaction after an
+// unknown command here, since it cannot know how long that command was.
+void rphub75_decoder_end_transaction(rphub75_decoder_t *d);
+
+// True between commands, outside of a command list.
+bool rphub75_decoder_idle(const rphub75_decoder_t *d);
+
+#endif // RPHUB75_CODEC_H
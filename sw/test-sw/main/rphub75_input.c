@@ -0,0 +1,273 @@
+// rphub75_input.c
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "rphub75.h"
+#include "rphub75_input.h"
+
+static const char *TAG = "RPHUB75_INPUT";
+
+typedef enum
+{
+    IN_IDLE,    // zero fill between packets
+    IN_LEN,     // uint16 packet length
+    IN_DEVICE,
+    IN_COUNT,
+    IN_REPORT,
+    IN_SKIP,    // rest of a packet that is not decoded
+} input_state_t;
+
+/* Decoder state. It is only fed from inside transfers, so the SPI lock
+ * serialises it; the queue is shared with the reading task. */
+static struct
+{
+    input_state_t state;
+    uint8_t len_buf[2];
+    uint8_t len_got;
+    uint16_t left;        // packet bytes after the length field not seen yet
+    uint8_t device;
+    uint8_t report_size;
+    uint8_t report[8];
+    uint8_t report_len;
+} s_dec;
+
+static volatile bool s_enabled = false;
+static int64_t s_last_window_us = 0;
+
+static portMUX_TYPE s_input_mux = portMUX_INITIALIZER_UNLOCKED;
+static rphub75_input_event_t s_queue[RP_INPUT_QUEUE_SIZE];
+static uint32_t s_head = 0; // next write
+static uint32_t s_tail = 0; // next read
+static rphub75_input_stats_t s_stats;
+
+/* The answer to an explicit request, read like any other response so it
+ * also arrives on a dual or quad link, where no windows are captured. */
+DMA_ATTR static uint8_t s_poll_rx[RPHUB75_MISO_WINDOW];
+
+_Static_assert((RP_INPUT_QUEUE_SIZE & (RP_INPUT_QUEUE_SIZE - 1)) == 0, "RP_INPUT_QUEUE_SIZE must be a power of two");
+
+void rphub75_input_enable(bool enable)
+{
+    s_enabled = false;
+    portENTER_CRITICAL(&s_input_mux);
+    s_head = s_tail = 0;
+    portEXIT_CRITICAL(&s_input_mux);
+    memset(&s_dec, 0, sizeof(s_dec));
+    s_enabled = enable;
+}
+
+bool rphub75_input_next(rphub75_input_event_t *out)
+{
+    bool found = false;
+    portENTER_CRITICAL(&s_input_mux);
+    if (s_tail != s_head)
+    {
+        *out = s_queue[s_tail % RP_INPUT_QUEUE_SIZE];
+        s_tail++;
+        found = true;
+    }
+    portEXIT_CRITICAL(&s_input_mux);
+    return found;
+}
+
+void rphub75_input_get_stats(rphub75_input_stats_t *out)
+{
+    portENTER_CRITICAL(&s_input_mux);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_input_mux);
+}
+
+/* A full queue keeps the newest events: the oldest one is overwritten. */
+static void input_push(const rphub75_input_event_t *ev)
+{
+    portENTER_CRITICAL(&s_input_mux);
+    if (s_head - s_tail == RP_INPUT_QUEUE_SIZE)
+    {
+        s_tail++;
+        s_stats.dropped++;
+    }
+    s_queue[s_head % RP_INPUT_QUEUE_SIZE] = *ev;
+    s_head++;
+    s_stats.events++;
+    portEXIT_CRITICAL(&s_input_mux);
+}
+
+static void input_emit(uint8_t device, const uint8_t *r, int64_t now)
+{
+    rphub75_input_event_t ev = {
+        .type = device,
+        .time_us = now,
+    };
+    switch (device)
+    {
+    case rphub75_usb_keyboard:
+        ev.keyboard.modifiers = r[0];
+        memcpy(ev.keyboard.keys, &r[2], sizeof(ev.keyboard.keys)); // r[1] is reserved
+        break;
+    case rphub75_usb_mouse:
+        ev.mouse.buttons = r[0];
+        ev.mouse.dx = (int8_t)r[1];
+        ev.mouse.dy = (int8_t)r[2];
+        ev.mouse.wheel = (int8_t)r[3];
+        break;
+    case rphub75_usb_gamepad:
+        ev.gamepad.buttons = r[0];
+        ev.gamepad.lt = r[1];
+        ev.gamepad.rt = r[2];
+        ev.gamepad.lx = r[3];
+        ev.gamepad.ly = r[4];
+        ev.gamepad.rx = r[5];
+        ev.gamepad.ry = r[6];
+        break;
+    default:
+        return;
+    }
+    input_push(&ev);
+}
+
+static void input_stat(uint32_t *counter)
+{
+    portENTER_CRITICAL(&s_input_mux);
+    (*counter)++;
+    portEXIT_CRITICAL(&s_input_mux);
+}
+
+static void input_packet_end(void)
+{
+    input_stat(&s_stats.packets);
+    s_dec.state = IN_IDLE;
+}
+
+/* The USB device is read from the default board only. */
+uint32_t rphub75_input_window(uint32_t len)
+{
+    if (!s_enabled || rphub75_bound() != rphub75_default_dev())
+        return 0;
+    return rphub75_miso_window(len);
+}
+
+/* Packets may be split over any number of windows, so this is a byte at a
+ * time state machine. Windows are at most RPHUB75_MISO_WINDOW bytes. */
+void rphub75_input_feed(const uint8_t *miso, uint32_t len)
+{
+    if (!s_enabled)
+        return;
+
+    int64_t now = esp_timer_get_time();
+    s_last_window_us = now;
+    input_stat(&s_stats.windows);
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint8_t b = miso[i];
+        switch (s_dec.state)
+        {
+        case IN_IDLE:
+            if (b == rphub75_ctype_usb)
+            {
+                s_dec.len_got = 0;
+                s_dec.state = IN_LEN;
+            }
+            else if (b != 0)
+            {
+                input_stat(&s_stats.errors);
+            }
+            break;
+
+        case IN_LEN:
+            s_dec.len_buf[s_dec.len_got++] = b;
+            if (s_dec.len_got < 2)
+                break;
+            s_dec.left = (uint16_t)(s_dec.len_buf[0] | (s_dec.len_buf[1] << 8));
+            if (s_dec.left < 2)
+            {
+                input_stat(&s_stats.errors);
+                s_dec.state = s_dec.left ? IN_SKIP : IN_IDLE;
+                break;
+            }
+            s_dec.state = IN_DEVICE;
+            break;
+
+        case IN_DEVICE:
+            s_dec.device = b;
+            s_dec.report_size = (uint8_t)rphub75_usb_report_size(b);
+            s_dec.left--;
+            s_dec.state = IN_COUNT;
+            break;
+
+        case IN_COUNT:
+            s_dec.left--;
+            s_dec.report_len = 0;
+            if (b == 0 && s_dec.left == 0)
+            {
+                input_packet_end(); // nothing queued, or no device
+            }
+            else if (s_dec.report_size == 0)
+            {
+                s_dec.state = s_dec.left ? IN_SKIP : IN_IDLE; // e.g. mass storage
+            }
+            else if (s_dec.left != (uint32_t)b * s_dec.report_size)
+            {
+                ESP_LOGW(TAG, "packet of %u reports from device %u has %u bytes",
+                         (unsigned)b, (unsigned)s_dec.device, (unsigned)s_dec.left);
+                input_stat(&s_stats.errors);
+                s_dec.state = s_dec.left ? IN_SKIP : IN_IDLE;
+            }
+            else
+            {
+                s_dec.state = IN_REPORT;
+            }
+            break;
+
+        case IN_REPORT:
+            s_dec.report[s_dec.report_len++] = b;
+            s_dec.left--;
+            if (s_dec.report_len == s_dec.report_size)
+            {
+                input_emit(s_dec.device, s_dec.report, now);
+                s_dec.report_len = 0;
+            }
+            if (s_dec.left == 0)
+                input_packet_end();
+            break;
+
+        case IN_SKIP:
+            if (--s_dec.left == 0)
+                s_dec.state = IN_IDLE;
+            break;
+        }
+    }
+}
+
+esp_err_t rphub75_input_poll(int64_t max_age_us)
+{
+    if (!s_enabled)
+        return ESP_ERR_INVALID_STATE;
+    if (max_age_us > 0 && esp_timer_get_time() - s_last_window_us < max_age_us)
+        return ESP_OK;
+
+    /* the request byte, then a read-only transaction that carries the
+     * answer; the lock keeps other commands from landing while the device
+     * answers. The request is too short to have a window of its own. */
+    static const uint8_t request = rphub75_ctype_usb;
+    rphub75_dev_t *prev = rphub75_bind(NULL);
+    rphub75_lock();
+    esp_err_t ret = spi_send_and_receive(&request, sizeof(request), NULL, 0);
+    if (ret == ESP_OK)
+        ret = spi_send_and_receive(NULL, 0, s_poll_rx, sizeof(s_poll_rx));
+    if (ret == ESP_OK)
+        rphub75_input_feed(s_poll_rx, sizeof(s_poll_rx));
+    rphub75_unlock();
+    rphub75_bind(prev);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "rphub75_input_poll: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    input_stat(&s_stats.polls);
+    return ESP_OK;
+}
@@ -0,0 +1,106 @@
+// rphub75_input.h
+// USB input from the keyboard, mouse or gamepad attached to the board. Queued
+// reports come back on MISO during the transfers the host makes anyway (see
+// docs/protocol/usb.md), so reading input costs no extra round-trips while
+// frames are being sent. They are decoded into a queue of typed events.
+// Only the default board's USB port is read. Windows need a single-line link
+// (rphub75_link.h); with more lines only rphub75_input_poll brings reports.
+//
+//   rphub75_input_enable(true);
+//   ...
+//   rphub75_input_poll(20000);   // only talks to the board if nothing was sent
+//   rphub75_input_event_t ev;
+//   while (rphub75_input_next(&ev))
+//       handle(&ev);
+
+#ifndef RPHUB75_INPUT_H
+#define RPHUB75_INPUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+
+#include "rphub75_proto.h"
+
+#define RP_INPUT_QUEUE_SIZE 32 // Events kept until read, a power of two
+
+typedef enum
+{
+    RPHUB75_INPUT_KEYBOARD = rphub75_usb_keyboard,
+    RPHUB75_INPUT_MOUSE = rphub75_usb_mouse,
+    RPHUB75_INPUT_GAMEPAD = rphub75_usb_gamepad,
+} rphub75_input_type_t;
+
+// Bits of rphub75_input_event_t.gamepad.buttons
+#define RPHUB75_PAD_A      (1 << 0)
+#define RPHUB75_PAD_B      (1 << 1)
+#define RPHUB75_PAD_X      (1 << 2)
+#define RPHUB75_PAD_Y      (1 << 3)
+#define RPHUB75_PAD_LB     (1 << 4)
+#define RPHUB75_PAD_RB     (1 << 5)
+#define RPHUB75_PAD_BACK   (1 << 6)
+#define RPHUB75_PAD_START  (1 << 7)
+
+// One report as the device sent it
+typedef struct
+{
+    uint8_t type;      // rphub75_input_type_t
+    int64_t time_us;   // esp_timer time it was decoded
+    union
+    {
+        struct
+        {
+            uint8_t modifiers; // bit 0 left ctrl ... bit 7 right GUI
+            uint8_t keys[6];   // HID usage codes of the pressed keys, 0 if unused
+        } keyboard;
+        struct
+        {
+            uint8_t buttons;   // bit 0 left, bit 1 right, bit 2 middle
+            int8_t dx;
+            int8_t dy;
+            int8_t wheel;
+        } mouse;
+        struct
+        {
+            uint8_t buttons;   // RPHUB75_PAD_*
+            uint8_t lt;        // triggers
+            uint8_t rt;
+            uint8_t lx;        // sticks
+            uint8_t ly;
+            uint8_t rx;
+            uint8_t ry;
+        } gamepad;
+    };
+} rphub75_input_event_t;
+
+typedef struct
+{
+    uint32_t windows;   // MISO windows decoded
+    uint32_t polls;     // explicit requests, when nothing else was sent
+    uint32_t packets;
+    uint32_t events;
+    uint32_t dropped;   // events overwritten because the queue was full
+    uint32_t errors;    // malformed packets and stray bytes
+} rphub75_input_stats_t;
+
+// Starts or stops capturing MISO. Stopping drops queued events; while
+// stopped the reports the device sends are lost.
+void rphub75_input_enable(bool enable);
+
+// Takes the oldest event, false when there is none.
+bool rphub75_input_next(rphub75_input_event_t *out);
+
+// Asks the device for its queued reports, unless a transfer already brought
+// back a window within the last `max_age_us` (0 always asks). Call it once a
+// frame so input keeps flowing while nothing is drawn.
+esp_err_t rphub75_input_poll(int64_t max_age_us);
+
+void rphub75_input_get_stats(rphub75_input_stats_t *out);
+
+// For transports: bytes of MISO to capture at the start of a `len` byte
+// transaction the caller reads nothing from, 0 while input is stopped.
+uint32_t rphub75_input_window(uint32_t len);
+// For transports: hands over a captured window, in transaction order.
+void rphub75_input_feed(const uint8_t *miso, uint32_t len);
+
+#endif // RPHUB75_INPUT_H
@@ -0,0 +1,246 @@
+// rphub75_link.c
+
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "rphub75_link.h"
+#include "rphub75_codec.h"
+
+static const char *TAG = "RPHUB75_LINK";
+
+const rphub75_link_config_t rphub75_link_candidates[] = {
+    {.lines = 1, .clock_hz = RP_LINK_CLOCK_26M},
+    {.lines = 2, .clock_hz = 20 * 1000 * 1000},
+    {.lines = 1, .clock_hz = 40 * 1000 * 1000},
+    {.lines = 2, .clock_hz = RP_LINK_CLOCK_26M},
+    {.lines = 4, .clock_hz = 20 * 1000 * 1000},
+    {.lines = 2, .clock_hz = 40 * 1000 * 1000},
+    {.lines = 4, .clock_hz = RP_LINK_CLOCK_26M},
+    {.lines = 4, .clock_hz = 40 * 1000 * 1000},
+};
+const uint8_t rphub75_link_candidate_count =
+    sizeof(rphub75_link_candidates) / sizeof(rphub75_link_candidates[0]);
+
+/* Sequence number of the next test frame */
+static uint16_t s_seq;
+
+/* Half-byte table for the reflected 0xEDB88320 polynomial: 64 bytes of
+ * table for two lookups per byte. */
+static const uint32_t s_crc_nibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+uint32_t rphub75_crc32(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ s_crc_nibble[crc & 0x0F];
+        crc = (crc >> 4) ^ s_crc_nibble[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+static inline uint64_t throughput(const rphub75_link_config_t *link)
+{
+    return (uint64_t)link->lines * link->clock_hz;
+}
+
+/* Test frame payloads, cycling through patterns that stress the link
+ * differently: random data, long runs of one level, a toggle on every bit
+ * and a single one walking across each line. */
+static void fill_pattern(uint8_t *p, uint16_t size, uint16_t seq)
+{
+    uint32_t x = 0x9E3779B9u ^ seq;
+    for (uint16_t i = 0; i < size; i++)
+    {
+        switch (seq % 4)
+        {
+        case 0:
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            p[i] = (uint8_t)x;
+            break;
+        case 1:
+            p[i] = (i / 64) & 1 ? 0xFF : 0x00;
+            break;
+        case 2:
+            p[i] = i & 1 ? 0xAA : 0x55;
+            break;
+        default:
+            p[i] = (uint8_t)(1u << (i % 8));
+            break;
+        }
+    }
+}
+
+static esp_err_t send_cmd(uint8_t cmd, const void *args)
+{
+    uint8_t buffer[2 + sizeof(rphub75_link_mode_t)];
+    size_t n = rphub75_encode(buffer, sizeof(buffer), rphub75_ctype_link, cmd, args);
+    return spi_send_data(buffer, (uint32_t)n);
+}
+
+/* Requests the status and reads it in the following transaction. False when
+ * it did not arrive intact. */
+static bool read_status(rphub75_link_status_t *out)
+{
+    if (send_cmd(rphub75_link_status_cmd, NULL) != ESP_OK)
+        return false;
+    uint8_t rx[sizeof(rphub75_link_status_t)];
+    if (spi_send_and_receive(NULL, 0, rx, sizeof(rx)) != ESP_OK)
+        return false;
+    memcpy(out, rx, sizeof(*out));
+    return out->type == rphub75_ctype_link &&
+           out->crc == rphub75_crc32(0, rx, offsetof(rphub75_link_status_t, crc));
+}
+
+esp_err_t rphub75_link_check(uint8_t lines, uint8_t frames, uint16_t size)
+{
+    uint8_t *frame = rphub75_dma_alloc(2 + sizeof(rphub75_link_test_t) + size);
+    if (frame == NULL)
+        return ESP_ERR_NO_MEM;
+
+    rphub75_lock();
+    rphub75_link_status_t st;
+    read_status(&st); // clears what earlier traffic left in the counters
+
+    esp_err_t ret = ESP_OK;
+    uint16_t seq = 0;
+    for (uint8_t i = 0; i < frames && ret == ESP_OK; i++)
+    {
+        seq = s_seq++;
+        rphub75_link_test_t test = {
+            .seq = seq,
+            .size = size,
+        };
+        uint8_t *payload = frame + 2 + sizeof(test);
+        fill_pattern(payload, size, seq);
+        test.crc = rphub75_crc32(0, payload, size);
+        rphub75_encode(frame, 2 + sizeof(test), rphub75_ctype_link, rphub75_link_test_cmd, &test);
+        ret = spi_send_data(frame, (uint32_t)(2 + sizeof(test) + size));
+    }
+    if (ret == ESP_OK)
+    {
+        if (!read_status(&st) || st.lines != lines)
+            ret = ESP_ERR_INVALID_RESPONSE;
+        else if (st.passed != frames || st.failed != 0 || (frames > 0 && st.seq != seq))
+            ret = ESP_ERR_INVALID_CRC;
+    }
+    rphub75_unlock();
+    rphub75_dma_free(frame);
+    return ret;
+}
+
+/* Moves both ends to `to`, tests it and commits it. The board is still in
+ * `from` when this fails; the host is put back there. */
+static esp_err_t try_candidate(const rphub75_link_train_config_t *config,
+                               const rphub75_link_config_t *from, const rphub75_link_config_t *to)
+{
+    rphub75_link_mode_t mode = {
+        .lines = to->lines,
+        .timeout_ms = config->timeout_ms,
+        .clock_hz = to->clock_hz,
+    };
+    esp_err_t ret = send_cmd(rphub75_link_mode_cmd, &mode);
+    if (ret == ESP_OK)
+        ret = rphub75_configure_link(to);
+    if (ret == ESP_OK)
+        ret = rphub75_link_check(to->lines, config->frames, config->frame_size);
+    if (ret == ESP_OK)
+        ret = send_cmd(rphub75_link_commit_cmd, NULL);
+    if (ret == ESP_OK)
+    {
+        /* a commit lost on the way would revert the board behind our back */
+        rphub75_link_status_t st;
+        if (!read_status(&st) || !st.committed || st.lines != to->lines)
+            ret = ESP_ERR_INVALID_RESPONSE;
+    }
+    if (ret == ESP_OK)
+        return ESP_OK;
+
+    /* the board reverts once the timeout passes without a commit */
+    rphub75_configure_link(from);
+    vTaskDelay(pdMS_TO_TICKS(config->timeout_ms) + 2);
+    return ret;
+}
+
+esp_err_t rphub75_link_train(const rphub75_link_train_config_t *config, rphub75_link_result_t *out)
+{
+    if (config == NULL || (config->count > 0 && config->candidates == NULL) ||
+        config->count > RP_LINK_MAX_CANDIDATES || config->frames == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    rphub75_link_result_t result = {.link = config->base};
+    rphub75_lock();
+
+    /* the transport only switches modes it can drive; a quick probe of each
+     * candidate leaves it on the base mode again */
+    bool supported[RP_LINK_MAX_CANDIDATES];
+    esp_err_t ret = rphub75_configure_link(&config->base);
+    for (uint8_t i = 0; i < config->count; i++)
+        supported[i] = ret == ESP_OK && rphub75_configure_link(&config->candidates[i]) == ESP_OK;
+    if (ret == ESP_OK)
+        rphub75_configure_link(&config->base);
+
+    ret = rphub75_link_check(config->base.lines, config->frames, config->frame_size);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Board does not answer test frames (%s), keeping the link as it is",
+                 esp_err_to_name(ret));
+        rphub75_unlock();
+        if (out != NULL)
+            *out = result;
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    bool failed[RP_LINK_MAX_CANDIDATES] = {0};
+    for (uint8_t i = 0; i < config->count && ret == ESP_OK; i++)
+    {
+        const rphub75_link_config_t *c = &config->candidates[i];
+        if (throughput(c) <= throughput(&result.link))
+            continue;
+
+        /* anything at least as wide and as fast as a failed mode fails too */
+        bool ruled_out = !supported[i];
+        for (uint8_t j = 0; j < i && !ruled_out; j++)
+            ruled_out = failed[j] && c->lines >= config->candidates[j].lines &&
+                        c->clock_hz >= config->candidates[j].clock_hz;
+        if (ruled_out)
+        {
+            result.skipped++;
+            continue;
+        }
+
+        result.tried++;
+        if (try_candidate(config, &result.link, c) == ESP_OK)
+        {
+            ESP_LOGI(TAG, "%u lines at %lu Hz: ok", (unsigned)c->lines, (unsigned long)c->clock_hz);
+            result.link = *c;
+            continue;
+        }
+
+        ESP_LOGI(TAG, "%u lines at %lu Hz: failed, back to %u lines at %lu Hz", (unsigned)c->lines,
+                 (unsigned long)c->clock_hz, (unsigned)result.link.lines, (unsigned long)result.link.clock_hz);
+        failed[i] = true;
+        result.fallbacks++;
+        ret = rphub75_link_check(result.link.lines, 1, config->frame_size);
+        if (ret != ESP_OK)
+            ESP_LOGE(TAG, "Board did not come back to %u lines at %lu Hz: %s", (unsigned)result.link.lines,
+                     (unsigned long)result.link.clock_hz, esp_err_to_name(ret));
+    }
+
+    rphub75_unlock();
+    ESP_LOGI(TAG, "Link at %u lines, %lu Hz (%u tried, %u fallbacks)", (unsigned)result.link.lines,
+             (unsigned long)result.link.clock_hz, (unsigned)result.tried, (unsigned)result.fallbacks);
+    if (out != NULL)
+        *out = result;
+    return ret;
+}
@@ -0,0 +1,69 @@
+// rphub75_link.h
+// Link training. Starting from a mode both ends are known to work in, the
+// link is stepped through faster candidates (more data lines, higher clock).
+// Each one is checked with CRC-tagged test frames that the board verifies and
+// reports back; a candidate that passes is committed on both ends, one that
+// fails is abandoned and the board reverts on its own after a timeout, so the
+// link settles on the fastest mode that carried every test frame intact.
+// The protocol is in docs/protocol/link.md.
+//
+//   rphub75_link_train_config_t config = RPHUB75_LINK_TRAIN_CONFIG_DEFAULT();
+//   rphub75_link_result_t result;
+//   rphub75_link_train(&config, &result); // stays on config.base on failure
+
+#ifndef RPHUB75_LINK_H
+#define RPHUB75_LINK_H
+
+#include <stdint.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+#include "rphub75_proto.h"
+
+#define RP_LINK_MAX_CANDIDATES 16
+#define RP_LINK_CLOCK_26M      (80 * 1000 * 1000 / 3) // SPI clocks divide the 80 MHz APB clock
+
+typedef struct
+{
+    rphub75_link_config_t base;               // mode the link is in now, and falls back to
+    const rphub75_link_config_t *candidates;  // tried in this order, slowest first
+    uint8_t count;
+    uint8_t frames;      // test frames per candidate
+    uint16_t frame_size; // bytes per test frame
+    uint16_t timeout_ms; // the board reverts after this without a commit
+} rphub75_link_train_config_t;
+
+// Every mode the ESP32-S3 can drive from the GPIO matrix, by throughput.
+// Quad modes are skipped unless the transport has the extra pins.
+extern const rphub75_link_config_t rphub75_link_candidates[];
+extern const uint8_t rphub75_link_candidate_count;
+
+#define RPHUB75_LINK_TRAIN_CONFIG_DEFAULT()                       \
+    {                                                             \
+        .base = {.lines = 1, .clock_hz = RP_SPI_CLOCK_HZ},        \
+        .candidates = rphub75_link_candidates,                    \
+        .count = rphub75_link_candidate_count,                    \
+        .frames = 4,                                              \
+        .frame_size = 4096,                                       \
+        .timeout_ms = 20,                                         \
+    }
+
+typedef struct
+{
+    rphub75_link_config_t link; // mode the link was left in
+    uint8_t tried;              // candidates switched to
+    uint8_t skipped;            // not supported by the transport, or ruled out by a failure
+    uint8_t fallbacks;          // candidates that failed
+} rphub75_link_result_t;
+
+// Trains the calling task's link, see above. ESP_ERR_NOT_SUPPORTED when the
+// board does not answer test frames in the base mode; the link is then left
+// untouched. `out` may be NULL.
+esp_err_t rphub75_link_train(const rphub75_link_train_config_t *config, rphub75_link_result_t *out);
+
+// Sends `frames` test frames of `size` bytes in the current mode and checks
+// that the board received all of them intact. ESP_ERR_INVALID_CRC if not,
+// ESP_ERR_INVALID_RESPONSE when the status itself did not arrive intact.
+esp_err_t rphub75_link_check(uint8_t lines, uint8_t frames, uint16_t size);
+
+#endif // RPHUB75_LINK_H
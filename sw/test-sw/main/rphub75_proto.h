@@ -0,0 +1,154 @@
+// rphub75_proto.h
+// Framebuffer commands the host library uses on top of the ones in rpio.h.
+// Their codes are taken from the top of the rpio_ctype_fb command space so
+// they cannot collide with the commands rpio itself defines. Multi-byte
+// payload fields are little endian.
+
+#ifndef RPHUB75_PROTO_H
+#define RPHUB75_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <rpio.h>
+
+// Command list container, see rphub75_cmdlist.h:
+// [byte: rphub75_ctype_batch] [uint16: length]
+//     { [byte: ctype] [byte: cmd] [uint16: length] [length bytes: payload] } ...
+// The payload of each entry is what follows [ctype] [cmd] when the command is
+// sent on its own.
+typedef enum
+{
+    // [byte: rphub75_ctype_usb], see docs/protocol/usb.md. The response is
+    // clocked out in the window of the next transaction.
+    rphub75_ctype_usb = 0x20,
+    // Link training, see docs/protocol/link.md and rphub75_link.h:
+    // [byte: rphub75_ctype_link] [byte: rphub75_link_cmd_t] [struct] [payload]
+    rphub75_ctype_link = 0x30,
+    rphub75_ctype_batch = 0xB0,
+} rphub75_ctype_t;
+
+#define RPHUB75_BATCH_HEADER_SIZE 3
+#define RPHUB75_ENTRY_HEADER_SIZE 4
+
+typedef enum
+{
+    // [rpio_fb_draw_t] [w * h * uint16 RGB565]
+    rphub75_fb_draw565_cmd = 0x80,
+    // [rphub75_fb_draw_packed_t] [size bytes of rows encoded by fbcodec.h]
+    rphub75_fb_draw_packed_cmd = 0x81,
+    // [rphub75_fb_draw_planes_t] [size bytes of bit planes laid out by bitplane.h]
+    rphub75_fb_draw_planes_cmd = 0x82,
+} rphub75_fb_cmd_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint8_t fb;
+    uint8_t ref_fb; // XOR and SAME rows read the same rectangle of this framebuffer
+    uint32_t size;  // encoded bytes following this header
+} rphub75_fb_draw_packed_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t width;  // geometry the planes were packed for; the board drops
+    uint16_t height; // them unless it matches its own
+    uint16_t addr;   // first row address
+    uint16_t count;  // row addresses
+    uint8_t fb;
+    uint8_t depth;   // planes per row address
+    uint32_t size;   // count * depth * width bytes following this header
+} rphub75_fb_draw_planes_t;
+
+// USB input, see docs/protocol/usb.md:
+// [byte: rphub75_ctype_usb] [uint16: length] [byte: device type] [byte: report count] [reports...]
+// The device shifts pending packets out on MISO in the first bytes of every
+// transaction that the host does not read a response from, continuing a
+// packet in the next transaction when the window is too short. The rest of
+// the window is zero.
+typedef enum
+{
+    rphub75_usb_none = 0x00,
+    rphub75_usb_keyboard = 0x01,
+    rphub75_usb_mouse = 0x02,
+    rphub75_usb_gamepad = 0x03,
+    rphub75_usb_storage = 0x04,
+} rphub75_usb_device_t;
+
+#define RPHUB75_USB_HEADER_SIZE 5  // type byte, length, device type, report count
+#define RPHUB75_MISO_WINDOW     64 // Largest window of a transaction, in bytes
+
+// Size of one report of `device`, 0 for devices without reports.
+static inline uint32_t rphub75_usb_report_size(uint8_t device)
+{
+    switch (device)
+    {
+    case rphub75_usb_keyboard:
+        return 8;
+    case rphub75_usb_mouse:
+        return 4;
+    case rphub75_usb_gamepad:
+        return 7;
+    default:
+        return 0;
+    }
+}
+
+// Window of a `len` byte transaction: whole 32-bit words so the host can
+// receive it with DMA straight into place, at most RPHUB75_MISO_WINDOW bytes.
+static inline uint32_t rphub75_miso_window(uint32_t len)
+{
+    len &= ~(uint32_t)3;
+    return len < RPHUB75_MISO_WINDOW ? len : RPHUB75_MISO_WINDOW;
+}
+
+// Link training. A mode change is tentative: the device goes back to the last
+// committed mode, and resets its parser, unless a commit arrives in the new
+// mode within the timeout. Test frames are counted until the status is read.
+typedef enum
+{
+    // [rphub75_link_mode_t], takes effect from the next transaction
+    rphub75_link_mode_cmd = 0x01,
+    // [rphub75_link_test_t] [size bytes]
+    rphub75_link_test_cmd = 0x02,
+    // The next transaction reads an rphub75_link_status_t; the device ignores
+    // MOSI during it. Reading clears the counters.
+    rphub75_link_status_cmd = 0x03,
+    // Keeps the current mode
+    rphub75_link_commit_cmd = 0x04,
+} rphub75_link_cmd_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t lines;       // data lines used in both directions: 1, 2 or 4
+    uint8_t reserved;
+    uint16_t timeout_ms; // without a commit the device reverts after this
+    uint32_t clock_hz;   // SCLK the host is about to use
+} rphub75_link_mode_t;
+
+typedef struct __attribute__((packed))
+{
+    uint16_t seq;
+    uint16_t size;       // bytes following this header
+    uint32_t crc;        // rphub75_crc32 of those bytes
+} rphub75_link_test_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t type;        // rphub75_ctype_link
+    uint8_t lines;       // mode the device is in
+    uint8_t committed;   // 1 once that mode is committed
+    uint8_t reserved;
+    uint16_t seq;        // of the last test frame
+    uint16_t passed;     // test frames whose CRC matched
+    uint16_t failed;
+    uint16_t reserved2;
+    uint32_t crc;        // rphub75_crc32 of the fields above
+} rphub75_link_status_t;
+
+// CRC-32 (IEEE 802.3, reflected, as zlib's crc32). Start with 0.
+uint32_t rphub75_crc32(uint32_t crc, const void *data, size_t len);
+
+#endif // RPHUB75_PROTO_H
@@ -0,0 +1,202 @@
+// rphub75_scene.c
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "rphub75_scene.h"
+
+static const char *TAG = "RPHUB75_SCENE";
+
+esp_err_t scene_init(scene_t *s, const atlas_t *atlas, uint16_t width, uint16_t height,
+                     const uint8_t *fbs, uint8_t fb_count, rpio_rgb_t background)
+{
+    if (s == NULL || atlas == NULL || fbs == NULL || fb_count == 0 || fb_count > RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(s, 0, sizeof(*s));
+    for (uint8_t i = 0; i < fb_count; i++)
+    {
+        if (fbs[i] >= RP_FB_COUNT || fbs[i] == atlas->fb)
+        {
+            ESP_LOGE(TAG, "scene_init: fb %u is out of range or holds the atlas", (unsigned)fbs[i]);
+            return ESP_ERR_INVALID_ARG;
+        }
+        s->fbs[i] = fbs[i];
+    }
+    s->atlas = atlas;
+    s->width = width;
+    s->height = height;
+    s->fb_count = fb_count;
+    s->background = background;
+    s->dirty = true;
+    return cmdlist_init(&s->cl, RP_SCENE_CMDLIST_SIZE);
+}
+
+void scene_deinit(scene_t *s)
+{
+    if (s == NULL)
+        return;
+    cmdlist_deinit(&s->cl);
+    s->count = 0;
+}
+
+static scene_node_t *scene_node(scene_t *s, uint16_t node)
+{
+    if (node >= s->count || !s->nodes[node].used)
+        return NULL;
+    return &s->nodes[node];
+}
+
+esp_err_t scene_add(scene_t *s, uint16_t sprite, int16_t x, int16_t y, uint8_t layer, uint16_t *out_node)
+{
+    if (atlas_sprite(s->atlas, sprite) == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    uint16_t id = 0;
+    while (id < RP_SCENE_MAX_NODES && s->nodes[id].used)
+        id++;
+    if (id == RP_SCENE_MAX_NODES)
+        return ESP_ERR_NO_MEM;
+
+    s->nodes[id] = (scene_node_t){
+        .x = x,
+        .y = y,
+        .sprite = sprite,
+        .layer = layer,
+        .used = true,
+        .visible = true,
+    };
+    if (id >= s->count)
+        s->count = id + 1;
+    s->dirty = true;
+    if (out_node)
+        *out_node = id;
+    return ESP_OK;
+}
+
+void scene_remove(scene_t *s, uint16_t node)
+{
+    scene_node_t *n = scene_node(s, node);
+    if (n == NULL)
+        return;
+    n->used = false;
+    while (s->count > 0 && !s->nodes[s->count - 1].used)
+        s->count--;
+    s->dirty = true;
+}
+
+void scene_move(scene_t *s, uint16_t node, int16_t x, int16_t y)
+{
+    scene_node_t *n = scene_node(s, node);
+    if (n == NULL || (n->x == x && n->y == y))
+        return;
+    n->x = x;
+    n->y = y;
+    s->dirty = true;
+}
+
+void scene_set_sprite(scene_t *s, uint16_t node, uint16_t sprite)
+{
+    scene_node_t *n = scene_node(s, node);
+    if (n == NULL || n->sprite == sprite || atlas_sprite(s->atlas, sprite) == NULL)
+        return;
+    n->sprite = sprite;
+    s->dirty = true;
+}
+
+void scene_set_visible(scene_t *s, uint16_t node, bool visible)
+{
+    scene_node_t *n = scene_node(s, node);
+    if (n == NULL || n->visible == visible)
+        return;
+    n->visible = visible;
+    s->dirty = true;
+}
+
+void scene_set_background(scene_t *s, rpio_rgb_t background)
+{
+    if (memcmp(&s->background, &background, sizeof(background)) == 0)
+        return;
+    s->background = background;
+    s->dirty = true;
+}
+
+/* Visible nodes sorted by layer; equal layers keep insertion order. */
+static uint16_t scene_sort(scene_t *s)
+{
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < s->count; i++)
+    {
+        const scene_node_t *node = &s->nodes[i];
+        if (!node->used || !node->visible)
+            continue;
+        uint16_t j = n++;
+        while (j > 0 && s->nodes[s->order[j - 1]].layer > node->layer)
+        {
+            s->order[j] = s->order[j - 1];
+            j--;
+        }
+        s->order[j] = (uint8_t)i;
+    }
+    return n;
+}
+
+static esp_err_t scene_blit(scene_t *s, uint8_t dst_fb, const scene_node_t *node)
+{
+    const rphub75_rect_t *src = atlas_sprite(s->atlas, node->sprite);
+    if (src == NULL)
+        return ESP_OK;
+
+    /* fb_blit takes unsigned coordinates, so the clipping happens here */
+    int x = node->x, y = node->y;
+    int sx = src->x, sy = src->y;
+    int w = src->w, h = src->h;
+    if (x < 0)
+    {
+        sx -= x;
+        w += x;
+        x = 0;
+    }
+    if (y < 0)
+    {
+        sy -= y;
+        h += y;
+        y = 0;
+    }
+    if (w > s->width - x)
+        w = s->width - x;
+    if (h > s->height - y)
+        h = s->height - y;
+    if (w <= 0 || h <= 0)
+        return ESP_OK;
+
+    return cmdlist_blit(&s->cl, s->atlas->fb, dst_fb, sx, sy, x, y, w, h);
+}
+
+esp_err_t scene_present(scene_t *s)
+{
+    if (!s->dirty)
+        return ESP_OK;
+
+    /* every framebuffer of the swap chain is rebuilt from scratch, so none of
+     * them needs to remember what the others showed */
+    uint8_t fb = s->fbs[s->back];
+    esp_err_t ret = cmdlist_clear(&s->cl, fb, s->background);
+    uint16_t n = scene_sort(s);
+    for (uint16_t i = 0; i < n && ret == ESP_OK; i++)
+        ret = scene_blit(s, fb, &s->nodes[s->order[i]]);
+    if (ret == ESP_OK)
+        ret = cmdlist_flip(&s->cl, fb);
+    if (ret == ESP_OK)
+        ret = cmdlist_flush(&s->cl);
+    if (ret != ESP_OK)
+    {
+        cmdlist_reset(&s->cl);
+        ESP_LOGE(TAG, "scene_present: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    s->back = (s->back + 1) % s->fb_count;
+    s->dirty = false;
+    return ESP_OK;
+}
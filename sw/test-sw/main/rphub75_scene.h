@@ -0,0 +1,63 @@
+// rphub75_scene.h
+// Retained scene of atlas sprites. The host keeps sprite positions and layers;
+// presenting a changed scene sends one command list that clears the back
+// framebuffer, blits every visible sprite out of the atlas in layer order and
+// flips. Moving a sprite costs a blit command instead of its pixels.
+
+#ifndef RPHUB75_SCENE_H
+#define RPHUB75_SCENE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+#include "rphub75_atlas.h"
+#include "rphub75_cmdlist.h"
+
+#define RP_SCENE_MAX_NODES   64
+#define RP_SCENE_CMDLIST_SIZE 2048 // Holds a clear, a flip and ~100 blits
+
+typedef struct
+{
+    int16_t x;       // screen position, may be partly off screen
+    int16_t y;
+    uint16_t sprite; // atlas id
+    uint8_t layer;   // lower layers are drawn first
+    bool used;
+    bool visible;
+} scene_node_t;
+
+typedef struct
+{
+    const atlas_t *atlas;
+    uint16_t width;
+    uint16_t height;
+    rpio_rgb_t background;
+    uint8_t fb_count;
+    uint8_t fbs[RP_FB_COUNT];
+    uint8_t back;
+    bool dirty;
+    uint16_t count;  // highest used node + 1
+    scene_node_t nodes[RP_SCENE_MAX_NODES];
+    uint8_t order[RP_SCENE_MAX_NODES];
+    cmdlist_t cl;
+} scene_t;
+
+// `fbs` is the swap chain drawn into, it must not contain the atlas framebuffer.
+esp_err_t scene_init(scene_t *s, const atlas_t *atlas, uint16_t width, uint16_t height,
+                     const uint8_t *fbs, uint8_t fb_count, rpio_rgb_t background);
+void scene_deinit(scene_t *s);
+
+esp_err_t scene_add(scene_t *s, uint16_t sprite, int16_t x, int16_t y, uint8_t layer, uint16_t *out_node);
+void scene_remove(scene_t *s, uint16_t node);
+void scene_move(scene_t *s, uint16_t node, int16_t x, int16_t y);
+void scene_set_sprite(scene_t *s, uint16_t node, uint16_t sprite);
+void scene_set_visible(scene_t *s, uint16_t node, bool visible);
+void scene_set_background(scene_t *s, rpio_rgb_t background);
+
+// Sends the scene if anything changed since the last present.
+esp_err_t scene_present(scene_t *s);
+
+#endif // RPHUB75_SCENE_H
@@ -0,0 +1,315 @@
+// rphub75_shadow.c
+// Dirty-rectangle diffing against per-framebuffer shadows, see rphub75_shadow.h
+
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+
+#include "rphub75_shadow.h"
+#include "rphub75_proto.h"
+#include "fbcodec.h"
+
+static const char *TAG = "RPHUB75_SHADOW";
+
+#define DRAW_HEADER_SIZE   (2 + sizeof(rpio_fb_draw_t))
+#define PACKED_HEADER_SIZE (2 + sizeof(rphub75_fb_draw_packed_t))
+#define FLIP_SIZE          (2 + sizeof(rpio_hub75_flip_t))
+
+esp_err_t shadowfb_init(shadowfb_t *s, uint16_t width, uint16_t height,
+                        const uint8_t *fbs, uint8_t fb_count)
+{
+    if (s == NULL || fbs == NULL || fb_count == 0 || fb_count > RP_FB_COUNT || width == 0 || height == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(s, 0, sizeof(*s));
+    s->width = width;
+    s->height = height;
+    s->fb_count = fb_count;
+
+    size_t frame_size = (size_t)width * height * sizeof(rpio_rgb_t);
+    size_t tiles = (size_t)((width + RP_SHADOW_TILE - 1) / RP_SHADOW_TILE) *
+                   ((height + RP_SHADOW_TILE - 1) / RP_SHADOW_TILE);
+
+    for (uint8_t i = 0; i < fb_count; i++)
+    {
+        if (fbs[i] >= RP_FB_COUNT)
+        {
+            ESP_LOGE(TAG, "shadowfb_init: fb %u out of range (max %u)", (unsigned)fbs[i], (unsigned)RP_FB_COUNT);
+            shadowfb_deinit(s);
+            return ESP_ERR_INVALID_ARG;
+        }
+        s->fbs[i] = fbs[i];
+        s->shadow[i] = heap_caps_malloc(frame_size, MALLOC_CAP_8BIT);
+        if (s->shadow[i] == NULL)
+            goto no_mem;
+    }
+
+    s->scratch = rphub75_dma_alloc(frame_size);
+    s->dirty = heap_caps_calloc(tiles, 1, MALLOC_CAP_8BIT);
+    if (s->scratch == NULL || s->dirty == NULL)
+        goto no_mem;
+
+    return ESP_OK;
+
+no_mem:
+    ESP_LOGE(TAG, "shadowfb_init: allocation failed");
+    shadowfb_deinit(s);
+    return ESP_ERR_NO_MEM;
+}
+
+void shadowfb_deinit(shadowfb_t *s)
+{
+    if (s == NULL)
+        return;
+
+    for (uint8_t i = 0; i < RP_FB_COUNT; i++)
+    {
+        heap_caps_free(s->shadow[i]);
+        s->shadow[i] = NULL;
+        s->valid[i] = false;
+    }
+    rphub75_dma_free(s->scratch);
+    heap_caps_free(s->dirty);
+    rphub75_dma_free(s->packed);
+    s->scratch = NULL;
+    s->dirty = NULL;
+    s->packed = NULL;
+}
+
+esp_err_t shadowfb_set_compression(shadowfb_t *s, bool enable)
+{
+    if (!enable)
+    {
+        rphub75_dma_free(s->packed);
+        s->packed = NULL;
+        return ESP_OK;
+    }
+    if (s->packed != NULL)
+        return ESP_OK;
+
+    s->packed = rphub75_dma_alloc(FBCODEC_MAX_SIZE(s->width, s->height));
+    if (s->packed == NULL)
+    {
+        ESP_LOGE(TAG, "shadowfb_set_compression: allocation failed");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void shadowfb_invalidate(shadowfb_t *s)
+{
+    for (uint8_t i = 0; i < RP_FB_COUNT; i++)
+        s->valid[i] = false;
+}
+
+/* Marks every tile in which `frame` differs from `shadow`. Returns the
+ * number of dirty tiles. */
+static size_t shadow_diff(shadowfb_t *s, const rpio_rgb_t *frame, const rpio_rgb_t *shadow,
+                          uint16_t tiles_x, uint16_t tiles_y)
+{
+    size_t count = 0;
+    memset(s->dirty, 0, (size_t)tiles_x * tiles_y);
+
+    for (uint16_t ty = 0; ty < tiles_y; ty++)
+    {
+        uint8_t *dirty = &s->dirty[(size_t)ty * tiles_x];
+        uint16_t y_end = (ty + 1) * RP_SHADOW_TILE;
+        if (y_end > s->height)
+            y_end = s->height;
+
+        for (uint16_t y = ty * RP_SHADOW_TILE; y < y_end; y++)
+        {
+            const rpio_rgb_t *a = frame + (size_t)y * s->width;
+            const rpio_rgb_t *b = shadow + (size_t)y * s->width;
+            for (uint16_t tx = 0; tx < tiles_x; tx++)
+            {
+                if (dirty[tx])
+                    continue;
+                uint16_t x = tx * RP_SHADOW_TILE;
+                uint16_t w = s->width - x < RP_SHADOW_TILE ? s->width - x : RP_SHADOW_TILE;
+                if (memcmp(a + x, b + x, w * sizeof(rpio_rgb_t)) != 0)
+                {
+                    dirty[tx] = 1;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/* Merges horizontal runs of dirty tiles into spans and stacks spans of equal
+ * extent on consecutive tile rows into rectangles. Returns the number of
+ * rectangles or -1 when more than RP_SHADOW_MAX_RECTS would be needed. */
+static int shadow_collect_rects(shadowfb_t *s, uint16_t tiles_x, uint16_t tiles_y)
+{
+    int count = 0;
+
+    for (uint16_t ty = 0; ty < tiles_y; ty++)
+    {
+        const uint8_t *dirty = &s->dirty[(size_t)ty * tiles_x];
+        uint16_t y = ty * RP_SHADOW_TILE;
+        uint16_t h = s->height - y < RP_SHADOW_TILE ? s->height - y : RP_SHADOW_TILE;
+
+        uint16_t tx = 0;
+        while (tx < tiles_x)
+        {
+            if (!dirty[tx])
+            {
+                tx++;
+                continue;
+            }
+            uint16_t start = tx;
+            while (tx < tiles_x && dirty[tx])
+                tx++;
+
+            uint16_t x = start * RP_SHADOW_TILE;
+            uint16_t x_end = tx * RP_SHADOW_TILE;
+            if (x_end > s->width)
+                x_end = s->width;
+            uint16_t w = x_end - x;
+
+            bool merged = false;
+            for (int i = 0; i < count; i++)
+            {
+                rphub75_rect_t *r = &s->rects[i];
+                if (r->x == x && r->w == w && r->y + r->h == y)
+                {
+                    r->h += h;
+                    merged = true;
+                    break;
+                }
+            }
+            if (merged)
+                continue;
+
+            if (count == RP_SHADOW_MAX_RECTS)
+                return -1;
+            s->rects[count++] = (rphub75_rect_t){.x = x, .y = y, .w = w, .h = h};
+        }
+    }
+    return count;
+}
+
+/* Sends one rectangle and updates the shadow. `valid` tells whether the
+ * shadow matches the device, which allows XOR rows. Adds the bytes sent to
+ * `bytes`. */
+static esp_err_t shadow_send_rect(shadowfb_t *s, uint8_t fb, const rpio_rgb_t *frame,
+                                  rpio_rgb_t *shadow, bool valid, const rphub75_rect_t *r, uint32_t *bytes)
+{
+    const rpio_rgb_t *bitmap;
+    size_t row_size = (size_t)r->w * sizeof(rpio_rgb_t);
+    size_t first = (size_t)r->y * s->width + r->x;
+    uint32_t raw_bytes = DRAW_HEADER_SIZE + (uint32_t)(row_size * r->h);
+
+    if (s->packed)
+    {
+        size_t size = fbcodec_encode(s->packed, FBCODEC_MAX_SIZE(s->width, s->height),
+                                     frame + first, s->width,
+                                     valid ? shadow + first : NULL, s->width,
+                                     r->w, r->h);
+        if (size > 0 && PACKED_HEADER_SIZE + size < raw_bytes)
+        {
+            esp_err_t ret = fb_draw_packed(fb, fb, r->x, r->y, r->w, r->h, s->packed, (uint32_t)size);
+            for (uint16_t row = 0; row < r->h; row++)
+            {
+                size_t offset = first + (size_t)row * s->width;
+                memcpy(shadow + offset, frame + offset, row_size);
+            }
+            *bytes += PACKED_HEADER_SIZE + (uint32_t)size;
+            return ret;
+        }
+    }
+
+    if (r->x == 0 && r->w == s->width)
+    {
+        /* full rows are already contiguous in the frame */
+        bitmap = frame + first;
+        memcpy(shadow + first, bitmap, row_size * r->h);
+    }
+    else
+    {
+        for (uint16_t row = 0; row < r->h; row++)
+        {
+            size_t offset = first + (size_t)row * s->width;
+            memcpy(s->scratch + (size_t)row * r->w, frame + offset, row_size);
+            memcpy(shadow + offset, frame + offset, row_size);
+        }
+        bitmap = s->scratch;
+    }
+
+    *bytes += raw_bytes;
+    return fb_draw(fb, r->x, r->y, bitmap, r->w, r->h);
+}
+
+esp_err_t shadowfb_present(shadowfb_t *s, const rpio_rgb_t *frame, shadowfb_stats_t *stats)
+{
+    if (s == NULL || frame == NULL || s->scratch == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t slot = s->back;
+    uint8_t fb = s->fbs[slot];
+    rpio_rgb_t *shadow = s->shadow[slot];
+    uint16_t tiles_x = (s->width + RP_SHADOW_TILE - 1) / RP_SHADOW_TILE;
+    uint16_t tiles_y = (s->height + RP_SHADOW_TILE - 1) / RP_SHADOW_TILE;
+    size_t full_bytes = DRAW_HEADER_SIZE + (size_t)s->width * s->height * sizeof(rpio_rgb_t);
+
+    shadowfb_stats_t st = {0};
+    int rect_count = -1;
+
+    if (s->valid[slot])
+    {
+        shadow_diff(s, frame, shadow, tiles_x, tiles_y);
+        rect_count = shadow_collect_rects(s, tiles_x, tiles_y);
+    }
+
+    if (rect_count >= 0)
+    {
+        size_t bytes = 0;
+        for (int i = 0; i < rect_count; i++)
+            bytes += DRAW_HEADER_SIZE + (size_t)s->rects[i].w * s->rects[i].h * sizeof(rpio_rgb_t);
+        if (bytes >= full_bytes)
+            rect_count = -1; // a single draw is cheaper than many overlapping headers
+    }
+
+    if (rect_count < 0)
+    {
+        s->rects[0] = (rphub75_rect_t){.x = 0, .y = 0, .w = s->width, .h = s->height};
+        rect_count = 1;
+        st.full = true;
+    }
+
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < rect_count && ret == ESP_OK; i++)
+    {
+        const rphub75_rect_t *r = &s->rects[i];
+        ret = shadow_send_rect(s, fb, frame, shadow, s->valid[slot], r, &st.bytes);
+        st.rects++;
+        st.pixels += (uint32_t)r->w * r->h;
+    }
+    /* the shadow already holds the new frame, which the board may not: the
+     * slot is redrawn in full next time, and stays the back buffer */
+    if (ret != ESP_OK)
+    {
+        s->valid[slot] = false;
+        if (stats)
+            *stats = st;
+        return ret;
+    }
+    s->valid[slot] = true;
+
+    ret = display_flip(fb);
+    st.bytes += FLIP_SIZE;
+    if (ret != ESP_OK)
+    {
+        if (stats)
+            *stats = st;
+        return ret;
+    }
+
+    s->back = (slot + 1) % s->fb_count;
+    if (stats)
+        *stats = st;
+    return ESP_OK;
+}
@@ -0,0 +1,62 @@
+// rphub75_shadow.h
+// Host-side shadow framebuffer. Each presented frame is compared with what the
+// target device framebuffer already holds and only the changed tiles, merged
+// into a few rectangles, are sent with fb_draw before display_flip.
+
+#ifndef RPHUB75_SHADOW_H
+#define RPHUB75_SHADOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#include "rphub75.h"
+
+#define RP_SHADOW_TILE      8  // Dirty tracking granularity in pixels
+#define RP_SHADOW_MAX_RECTS 16 // More dirty rectangles than this sends the whole frame
+
+typedef struct
+{
+    uint32_t rects;  // fb_draw commands sent
+    uint32_t pixels; // pixels sent
+    uint32_t bytes;  // bytes sent including command headers and the flip
+    bool full;       // whole frame was sent
+} shadowfb_stats_t;
+
+typedef struct
+{
+    uint16_t width;
+    uint16_t height;
+    uint8_t fb_count;                 // device framebuffers in the swap chain
+    uint8_t fbs[RP_FB_COUNT];         // their indices, drawn in this order
+    uint8_t back;                     // position in `fbs` drawn next
+    rpio_rgb_t *shadow[RP_FB_COUNT];  // what each device framebuffer holds
+    bool valid[RP_FB_COUNT];          // false until the shadow matches the device
+    rpio_rgb_t *scratch;              // gather buffer for sub-rectangles
+    uint8_t *dirty;                   // one byte per tile
+    uint8_t *packed;                  // fbcodec output, NULL while compression is off
+    rphub75_rect_t rects[RP_SHADOW_MAX_RECTS];
+} shadowfb_t;
+
+// `fbs` lists the device framebuffers to cycle through, e.g. {0, 1} for
+// double buffering. A single entry draws straight into the shown framebuffer.
+esp_err_t shadowfb_init(shadowfb_t *s, uint16_t width, uint16_t height,
+                        const uint8_t *fbs, uint8_t fb_count);
+void shadowfb_deinit(shadowfb_t *s);
+
+// Forget what the device holds, e.g. after other code wrote to the framebuffers.
+// The next present of each framebuffer sends the whole frame.
+void shadowfb_invalidate(shadowfb_t *s);
+
+// Encodes every rectangle with fbcodec (RLE or XOR against what the device
+// holds) and sends it with fb_draw_packed whenever that is smaller.
+esp_err_t shadowfb_set_compression(shadowfb_t *s, bool enable);
+
+// Sends the difference between `frame` and the back framebuffer, flips to it
+// and advances the swap chain. `stats` may be NULL. When a send fails the
+// error is returned, nothing is flipped and the back framebuffer is redrawn
+// in full by the next call.
+esp_err_t shadowfb_present(shadowfb_t *s, const rpio_rgb_t *frame, shadowfb_stats_t *stats);
+
+#endif // RPHUB75_SHADOW_H
@@ -0,0 +1,390 @@
+// rphub75_spi.c
+// ESP32 SPI master transport for rphub75.c, one link per board. spi_init
+// opens the default board with the pin definitions from rphub75.h
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "soc/soc_caps.h"
+#include "esp_err.h"
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+
+#include "rphub75.h"
+#include "rphub75_stats.h"
+#include "rphub75_input.h"
+
+static const char *TAG = "RPHUB75";
+
+/* Zeros clocked out on MOSI while only receiving. Lives in internal RAM so the
+ * SPI DMA can read it directly, and is shared since it is never written. */
+DMA_ATTR static uint8_t s_tx_zero[RP_SPI_ZERO_TX];
+
+/* Command headers up to this size that do not sit in DMA-capable memory
+ * (usually the caller's stack) are copied into a per-slot buffer here instead
+ * of letting the driver allocate a bounce buffer for them. */
+#define RP_SPI_SMALL_TX 64
+
+/* One open board. Its transaction descriptors and small-copy slots (one per
+ * queued transaction) are only used with that board's lock held, so a
+ * transfer never touches the heap and links on different hosts run at the
+ * same time. */
+typedef struct
+{
+    spi_device_handle_t spi;
+    int host;
+    rphub75_dev_t *dev; // NULL for the default board
+    rphub75_spi_config_t config;
+    rphub75_link_config_t link; // lines and clock the device is added with
+    spi_transaction_t trans_pool[RP_SPI_QUEUE_SIZE];
+} spi_link_t;
+
+static spi_link_t s_links[RP_SPI_MAX_LINKS];
+DMA_ATTR static uint8_t s_small_tx[RP_SPI_MAX_LINKS][RP_SPI_QUEUE_SIZE][RP_SPI_SMALL_TX];
+
+/* MISO windows of transactions the caller reads nothing from; queued USB
+ * reports arrive here (see rphub75_input.h). */
+DMA_ATTR static uint8_t s_miso[RP_SPI_MAX_LINKS][RP_SPI_QUEUE_SIZE][RPHUB75_MISO_WINDOW];
+
+/* Boards open on each host; the bus is freed with the last one. */
+static uint8_t s_bus_users[SOC_SPI_PERIPH_NUM];
+
+/* Bulk full-duplex transfer. The buffers are split into chunks of at most
+ * RP_SPI_MAX_TRANSFER bytes and up to RP_SPI_QUEUE_SIZE DMA transactions are
+ * kept queued, so the bus never idles between chunks. While the hardware is
+ * busy the calling task blocks inside the driver, which lets lower priority
+ * tasks (including IDLE) run. Called by spi_send_and_receive with the SPI
+ * lock held. */
+static esp_err_t spi_bulk_transfer(void *ctx, const uint8_t *tx, uint32_t tx_len, uint8_t *rx, uint32_t rx_len)
+{
+    spi_link_t *link = ctx;
+    size_t li = link - s_links;
+    if (link->spi == NULL)
+        return ESP_ERR_INVALID_STATE; // a failed mode switch could not restore the device
+    bool half_duplex = link->link.lines > 1;
+    if (half_duplex && tx != NULL && rx != NULL)
+    {
+        /* the data lines carry one direction at a time: write, then read */
+        esp_err_t ret = spi_bulk_transfer(ctx, tx, tx_len, NULL, 0);
+        return ret == ESP_OK ? spi_bulk_transfer(ctx, NULL, 0, rx, rx_len) : ret;
+    }
+    uint32_t total = tx_len > rx_len ? tx_len : rx_len;
+    uint32_t offset = 0;
+    unsigned in_flight = 0;
+    unsigned next = 0;
+    esp_err_t ret = ESP_OK;
+
+    while (in_flight > 0 || (offset < total && ret == ESP_OK))
+    {
+        if (offset < total && ret == ESP_OK && in_flight < RP_SPI_QUEUE_SIZE)
+        {
+            spi_transaction_t *t = &link->trans_pool[next];
+            uint32_t len = spi_chunk_len(tx != NULL, tx_len, rx != NULL, rx_len, offset, half_duplex);
+
+            memset(t, 0, sizeof(*t));
+            if (tx != NULL && offset < tx_len)
+            {
+                const uint8_t *src = tx + offset;
+                if (len <= RP_SPI_SMALL_TX && !rphub75_is_dma_buffer(src))
+                {
+                    memcpy(s_small_tx[li][next], src, len);
+                    src = s_small_tx[li][next];
+                }
+                t->tx_buffer = src;
+            }
+            else if (!half_duplex)
+            {
+                /* past the end of tx (or read only): clock out zeros */
+                t->tx_buffer = s_tx_zero;
+            }
+            if (rx != NULL && offset < rx_len)
+            {
+                t->rx_buffer = rx + offset;
+                t->rxlength = len * 8;
+            }
+            else if (rx == NULL && !half_duplex)
+            {
+                /* full duplex for free: the window is read into the slot */
+                uint32_t window = rphub75_input_window(len);
+                if (window > 0)
+                {
+                    t->rx_buffer = s_miso[li][next];
+                    t->rxlength = window * 8;
+                }
+            }
+            t->length = t->tx_buffer != NULL ? len * 8 : 0; // bits
+            if (half_duplex)
+                t->flags |= link->link.lines == 4 ? SPI_TRANS_MODE_QIO : SPI_TRANS_MODE_DIO;
+
+            /* Buffers from rphub75_dma_alloc are handed to the DMA as they are;
+             * anything else costs the driver an allocation and a copy. */
+            bool tx_ready = t->tx_buffer == NULL || rphub75_is_dma_buffer(t->tx_buffer);
+            bool rx_ready = t->rx_buffer == NULL ||
+                            (rphub75_is_dma_buffer(t->rx_buffer) && (t->rxlength / 8) % 4 == 0);
+            if (tx_ready && rx_ready)
+            {
+#ifdef SPI_TRANS_DMA_BUFFER_ALIGN_MANUAL
+                t->flags |= SPI_TRANS_DMA_BUFFER_ALIGN_MANUAL;
+#endif
+            }
+            else
+            {
+                rphub75_stats_bounce();
+            }
+
+            ret = spi_device_queue_trans(link->spi, t, portMAX_DELAY);
+            if (ret != ESP_OK)
+            {
+                ESP_LOGE(TAG, "spi_send_and_receive: queueing %lu bytes at offset %lu failed: %s",
+                         (unsigned long)len, (unsigned long)offset, esp_err_to_name(ret));
+                continue; // reap what is already in flight, then bail out
+            }
+            next = (next + 1) % RP_SPI_QUEUE_SIZE;
+            in_flight++;
+            offset += len;
+            continue;
+        }
+
+        spi_transaction_t *done = NULL;
+        esp_err_t res = spi_device_get_trans_result(link->spi, &done, portMAX_DELAY);
+        if (res != ESP_OK)
+        {
+            ESP_LOGE(TAG, "spi_send_and_receive: collecting result failed: %s", esp_err_to_name(res));
+            return res;
+        }
+        in_flight--;
+        /* results come back in queue order, so windows are decoded in the
+         * order the device sent them */
+        if (rx == NULL && done->rx_buffer != NULL)
+            rphub75_input_feed(done->rx_buffer, done->rxlength / 8);
+    }
+
+    return ret;
+}
+
+/* (Re)adds the link's device in `mode`. More than one data line needs a half
+ * duplex device, since MISO then carries data too. */
+static esp_err_t spi_link_add_device(spi_link_t *link, const rphub75_link_config_t *mode)
+{
+    spi_device_interface_config_t devcfg = {
+        .command_bits = 0,
+        .address_bits = 0,
+        .dummy_bits = 0,
+        .mode = 0, // SPI mode 0
+        .duty_cycle_pos = 0,
+        .cs_ena_pretrans = 0,
+        .cs_ena_posttrans = 0,
+        .clock_speed_hz = (int)mode->clock_hz,
+        .input_delay_ns = 0,
+        .spics_io_num = link->config.pin_cs,
+        .flags = mode->lines > 1 ? SPI_DEVICE_HALFDUPLEX : 0,
+        .queue_size = RP_SPI_QUEUE_SIZE,
+        .pre_cb = NULL,
+        .post_cb = NULL};
+
+    esp_err_t ret = spi_bus_add_device(link->host, &devcfg, &link->spi);
+    if (ret != ESP_OK)
+    {
+        link->spi = NULL;
+        return ret;
+    }
+    link->link = *mode;
+    return ESP_OK;
+}
+
+/* Switches lines and clock between transfers (rphub75_transport_t.configure);
+ * the SPI lock keeps anything from being in flight. */
+static esp_err_t spi_configure(void *ctx, const rphub75_link_config_t *mode)
+{
+    spi_link_t *link = ctx;
+    if (mode->clock_hz == 0 || (mode->lines != 1 && mode->lines != 2 && mode->lines != 4))
+        return ESP_ERR_INVALID_ARG;
+    if (mode->lines == 4 && (link->config.pin_wp < 0 || link->config.pin_hd < 0))
+        return ESP_ERR_NOT_SUPPORTED;
+    if (mode->lines == link->link.lines && mode->clock_hz == link->link.clock_hz)
+        return ESP_OK;
+
+    rphub75_link_config_t old = link->link;
+    spi_bus_remove_device(link->spi);
+    esp_err_t ret = spi_link_add_device(link, mode);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to switch to %u lines at %lu Hz: %s", (unsigned)mode->lines,
+                 (unsigned long)mode->clock_hz, esp_err_to_name(ret));
+        spi_link_add_device(link, &old);
+        return ret;
+    }
+    ESP_LOGI(TAG, "Link switched to %u lines at %lu Hz", (unsigned)mode->lines, (unsigned long)mode->clock_hz);
+    return ESP_OK;
+}
+
+/* Whether `config` wires the bus the way the boards already open on its host
+ * do. The bus is set up by the first of them, so other pins would be
+ * silently ignored. */
+static bool spi_bus_pins_match(const rphub75_spi_config_t *config)
+{
+    for (int i = 0; i < RP_SPI_MAX_LINKS; i++)
+    {
+        const rphub75_spi_config_t *open = &s_links[i].config;
+        if (s_links[i].spi == NULL || s_links[i].host != config->host)
+            continue;
+        return open->pin_miso == config->pin_miso && open->pin_mosi == config->pin_mosi &&
+               open->pin_sclk == config->pin_sclk && open->pin_wp == config->pin_wp &&
+               open->pin_hd == config->pin_hd;
+    }
+    return true;
+}
+
+/* Adds a board to `config->host`, initialising the bus for the first one. */
+static esp_err_t spi_link_open(spi_link_t *link, const rphub75_spi_config_t *config)
+{
+    if (config->host < 0 || config->host >= SOC_SPI_PERIPH_NUM)
+        return ESP_ERR_INVALID_ARG;
+    if (s_bus_users[config->host] > 0 && !spi_bus_pins_match(config))
+    {
+        ESP_LOGE(TAG, "SPI bus %d is already wired to other pins", config->host);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret;
+    if (s_bus_users[config->host] == 0)
+    {
+        spi_bus_config_t buscfg = {
+            .miso_io_num = config->pin_miso,
+            .mosi_io_num = config->pin_mosi,
+            .sclk_io_num = config->pin_sclk,
+            .quadwp_io_num = config->pin_wp,
+            .quadhd_io_num = config->pin_hd,
+
+            .max_transfer_sz = RP_SPI_MAX_TRANSFER,
+            .flags = 0,
+            .intr_flags = 0};
+
+        // Initialize SPI bus
+        ret = spi_bus_initialize(config->host, &buscfg, SPI_DMA_CH_AUTO);
+        if (ret != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to initialize SPI bus %d: 0x%x", config->host, ret);
+            return ret;
+        }
+        ESP_LOGI(TAG, "SPI bus %d initialized successfully", config->host);
+    }
+
+    ESP_LOGI(TAG, "Adding SPI device (CS %d)...", config->pin_cs);
+
+    link->config = *config;
+    link->host = config->host;
+    rphub75_link_config_t mode = {.lines = 1, .clock_hz = (uint32_t)config->clock_hz};
+    ret = spi_link_add_device(link, &mode);
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to add SPI device: 0x%x", ret);
+        if (s_bus_users[config->host] == 0)
+            spi_bus_free(config->host);
+        return ret;
+    }
+    s_bus_users[config->host]++;
+    return ESP_OK;
+}
+
+static void spi_link_close(spi_link_t *link)
+{
+    if (link->spi == NULL)
+        return;
+    spi_bus_remove_device(link->spi);
+    link->spi = NULL;
+    link->dev = NULL;
+    if (--s_bus_users[link->host] == 0)
+        spi_bus_free(link->host);
+}
+
+esp_err_t rphub75_spi_open(const rphub75_spi_config_t *config, rphub75_dev_t **out_dev)
+{
+    if (config == NULL || out_dev == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    /* link 0 is kept for the default board */
+    spi_link_t *link = NULL;
+    for (int i = 1; i < RP_SPI_MAX_LINKS && link == NULL; i++)
+    {
+        if (s_links[i].spi == NULL)
+            link = &s_links[i];
+    }
+    if (link == NULL)
+        return ESP_ERR_NO_MEM;
+
+    esp_err_t ret = spi_link_open(link, config);
+    if (ret != ESP_OK)
+        return ret;
+
+    rphub75_transport_t transport = {
+        .transfer = spi_bulk_transfer,
+        .ctx = link,
+        .configure = spi_configure,
+    };
+    link->dev = rphub75_dev_create(&transport);
+    if (link->dev == NULL)
+    {
+        spi_link_close(link);
+        return ESP_ERR_NO_MEM;
+    }
+    *out_dev = link->dev;
+    return ESP_OK;
+}
+
+void rphub75_spi_close(rphub75_dev_t *dev)
+{
+    for (int i = 1; i < RP_SPI_MAX_LINKS; i++)
+    {
+        if (s_links[i].spi != NULL && s_links[i].dev == dev)
+        {
+            spi_link_close(&s_links[i]);
+            rphub75_dev_destroy(dev);
+            return;
+        }
+    }
+}
+
+esp_err_t spi_init(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    rphub75_spi_config_t config = RPHUB75_SPI_CONFIG_DEFAULT();
+    spi_link_t *link = &s_links[0];
+    esp_err_t ret = spi_link_open(link, &config);
+    if (ret != ESP_OK)
+        return ret;
+
+    rphub75_transport_t transport = {
+        .transfer = spi_bulk_transfer,
+        .ctx = link,
+        .configure = spi_configure,
+    };
+    rphub75_dev_t *prev = rphub75_bind(NULL);
+    ret = rphub75_set_transport(&transport);
+    rphub75_bind(prev);
+    if (ret != ESP_OK)
+    {
+        spi_link_close(link);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "SPI device added successfully");
+    return ESP_OK;
+}
+
+void spi_deinit(void)
+{
+    esp_log_level_set(TAG, ESP_LOG_INFO);
+
+    rphub75_dev_t *prev = rphub75_bind(NULL);
+    rphub75_set_transport(NULL);
+    rphub75_bind(prev);
+
+    spi_link_close(&s_links[0]);
+
+    ESP_LOGI(TAG, "SPI deinitialized");
+}
@@ -0,0 +1,163 @@
+// rphub75_stats.c
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "rphub75.h"
+#include "rphub75_stats.h"
+
+static const char *TAG = "RPHUB75_STATS";
+
+static const char *const s_op_names[RPHUB75_OP_COUNT] = {"clear", "blit", "draw", "flip"};
+
+#if RP_STATS_ENABLE
+static portMUX_TYPE s_stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static rphub75_stats_t s_stats;
+static int64_t s_stats_since = 0;
+
+static inline uint32_t clamp_us(int64_t us)
+{
+    if (us < 0)
+        return 0;
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+static inline uint32_t bucket_of(uint32_t us)
+{
+    uint32_t bucket = us ? 32 - (uint32_t)__builtin_clz(us) : 0;
+    return bucket < RP_STATS_BUCKETS ? bucket : RP_STATS_BUCKETS - 1;
+}
+
+int64_t rphub75_stats_now(void)
+{
+    return esp_timer_get_time();
+}
+
+void rphub75_stats_transfer(uint32_t transactions, uint32_t tx_len, uint32_t rx_len, int64_t busy_us, esp_err_t ret)
+{
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.tx_bytes += tx_len;
+    s_stats.rx_bytes += rx_len;
+    s_stats.calls++;
+    s_stats.transactions += transactions;
+    s_stats.busy_us += clamp_us(busy_us);
+    if (ret != ESP_OK)
+        s_stats.errors++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+void rphub75_stats_lock_wait(int64_t wait_us)
+{
+    uint32_t us = clamp_us(wait_us);
+
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.lock_contended++;
+    s_stats.lock_wait_us += us;
+    if (us > s_stats.lock_wait_max_us)
+        s_stats.lock_wait_max_us = us;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+void rphub75_stats_bounce(void)
+{
+    portENTER_CRITICAL(&s_stats_mux);
+    s_stats.bounced++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+void rphub75_stats_op(rphub75_op_t op, int64_t start_us)
+{
+    uint32_t us = clamp_us(esp_timer_get_time() - start_us);
+    uint32_t bucket = bucket_of(us);
+    rphub75_op_stats_t *o = &s_stats.ops[op];
+
+    portENTER_CRITICAL(&s_stats_mux);
+    o->count++;
+    o->total_us += us;
+    if (us > o->max_us)
+        o->max_us = us;
+    o->hist[bucket]++;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+void rphub75_stats_get(rphub75_stats_t *out)
+{
+    if (out == NULL)
+        return;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_mux);
+    *out = s_stats;
+    out->elapsed_us = (uint64_t)(now - s_stats_since);
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+void rphub75_stats_reset(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_stats_mux);
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats_since = now;
+    portEXIT_CRITICAL(&s_stats_mux);
+}
+
+#else
+
+void rphub75_stats_get(rphub75_stats_t *out)
+{
+    if (out)
+        memset(out, 0, sizeof(*out));
+}
+
+void rphub75_stats_reset(void)
+{
+}
+
+#endif // RP_STATS_ENABLE
+
+uint32_t rphub75_stats_percentile_us(const rphub75_op_stats_t *op, uint32_t percent)
+{
+    if (op == NULL || op->count == 0)
+        return 0;
+
+    uint64_t rank = ((uint64_t)op->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < RP_STATS_BUCKETS; b++)
+    {
+        seen += op->hist[b];
+        if (seen >= rank && seen > 0)
+        {
+            // The open last bucket is bounded by the largest sample
+            return b == RP_STATS_BUCKETS - 1 ? op->max_us : (1u << b);
+        }
+    }
+    return op->max_us;
+}
+
+void rphub75_stats_print(void)
+{
+    rphub75_stats_t st;
+    rphub75_stats_get(&st);
+
+    uint32_t util_permille = st.elapsed_us ? (uint32_t)(st.busy_us * 1000 / st.elapsed_us) : 0;
+    ESP_LOGI(TAG, "link: %llu B tx, %llu B rx, %lu calls, %lu transactions (%lu bounced), %lu errors, busy %lu.%lu%%",
+             (unsigned long long)st.tx_bytes, (unsigned long long)st.rx_bytes,
+             (unsigned long)st.calls, (unsigned long)st.transactions, (unsigned long)st.bounced,
+             (unsigned long)st.errors,
+             (unsigned long)(util_permille / 10), (unsigned long)(util_permille % 10));
+    ESP_LOGI(TAG, "lock: contended %lu times, waited %llu us (max %lu us)",
+             (unsigned long)st.lock_contended, (unsigned long long)st.lock_wait_us,
+             (unsigned long)st.lock_wait_max_us);
+    for (int i = 0; i < RPHUB75_OP_COUNT; i++)
+    {
+        const rphub75_op_stats_t *op = &st.ops[i];
+        if (op->count == 0)
+            continue;
+        ESP_LOGI(TAG, "%s: %lu calls, avg %llu us, p50 <%lu us, p99 <%lu us, max %lu us",
+                 s_op_names[i], (unsigned long)op->count,
+                 (unsigned long long)(op->total_us / op->count),
+                 (unsigned long)rphub75_stats_percentile_us(op, 50),
+                 (unsigned long)rphub75_stats_percentile_us(op, 99),
+                 (unsigned long)op->max_us);
+    }
+}
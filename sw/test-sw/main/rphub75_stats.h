@@ -0,0 +1,90 @@
+// rphub75_stats.h
+// Link counters and per-command latency histograms, cheap enough to leave on
+// in the field. Build with -DRP_STATS_ENABLE=0 to compile them out and with
+// -DRP_HOT_LOG=1 to get the per-transfer log lines back.
+
+#ifndef RPHUB75_STATS_H
+#define RPHUB75_STATS_H
+
+#include <stdint.h>
+#include <esp_err.h>
+#include "esp_log.h"
+
+#ifndef RP_STATS_ENABLE
+#define RP_STATS_ENABLE 1
+#endif
+
+#ifndef RP_HOT_LOG
+#define RP_HOT_LOG 0
+#endif
+
+// Logging on paths that run for every transfer
+#if RP_HOT_LOG
+#define RP_LOG_HOT(tag, format, ...) ESP_LOGI(tag, format, ##__VA_ARGS__)
+#else
+#define RP_LOG_HOT(tag, format, ...) do { } while (0)
+#endif
+
+// Bucket 0 counts calls under 1 us, bucket b counts [2^(b-1), 2^b) us and the
+// last one everything from 2^(RP_STATS_BUCKETS-2) us up.
+#define RP_STATS_BUCKETS 16
+
+typedef enum
+{
+    RPHUB75_OP_CLEAR,
+    RPHUB75_OP_BLIT,
+    RPHUB75_OP_DRAW,  // fb_draw and its RGB565 and packed variants
+    RPHUB75_OP_FLIP,
+    RPHUB75_OP_COUNT,
+} rphub75_op_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t hist[RP_STATS_BUCKETS];
+} rphub75_op_stats_t;
+
+typedef struct
+{
+    uint64_t elapsed_us;      // since the last reset
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+    uint32_t calls;           // spi_send_and_receive calls
+    uint32_t transactions;    // DMA transactions those split into
+    uint32_t errors;          // failed transfers
+    uint32_t bounced;         // transactions the SPI driver copied to DMA memory
+    uint64_t busy_us;         // time spent inside the transport
+    uint32_t lock_contended;  // times s_spi_lock was held by another task
+    uint64_t lock_wait_us;    // total time waiting for it
+    uint32_t lock_wait_max_us;
+    rphub75_op_stats_t ops[RPHUB75_OP_COUNT];
+} rphub75_stats_t;
+
+// Copies the counters. Safe to call from any task while transfers run.
+void rphub75_stats_get(rphub75_stats_t *out);
+void rphub75_stats_reset(void);
+
+// Upper bound in us of the bucket holding the given percentile (0-100).
+uint32_t rphub75_stats_percentile_us(const rphub75_op_stats_t *op, uint32_t percent);
+
+// Logs a one-line summary per counter group.
+void rphub75_stats_print(void);
+
+// Recording hooks used by rphub75.c and the transports
+#if RP_STATS_ENABLE
+int64_t rphub75_stats_now(void);
+void rphub75_stats_transfer(uint32_t transactions, uint32_t tx_len, uint32_t rx_len, int64_t busy_us, esp_err_t ret);
+void rphub75_stats_lock_wait(int64_t wait_us);
+void rphub75_stats_bounce(void);
+void rphub75_stats_op(rphub75_op_t op, int64_t start_us);
+#else
+static inline int64_t rphub75_stats_now(void) { return 0; }
+static inline void rphub75_stats_transfer(uint32_t transactions, uint32_t tx_len, uint32_t rx_len, int64_t busy_us, esp_err_t ret) {}
+static inline void rphub75_stats_lock_wait(int64_t wait_us) {}
+static inline void rphub75_stats_bounce(void) {}
+static inline void rphub75_stats_op(rphub75_op_t op, int64_t start_us) {}
+#endif
+
+#endif // RPHUB75_STATS_H
@@ -0,0 +1,169 @@
+// rphub75_wall.c
+
+#include <string.h>
+#include "esp_log.h"
+
+#include "rphub75_wall.h"
+
+static const char *TAG = "RPHUB75_WALL";
+
+/* Sends the regions of the lane's panels, each to its own board, and keeps
+ * the first error in the lane. A failed panel does not stop the others. */
+static void wall_lane_draw(wall_t *w, uint8_t lane)
+{
+    rphub75_dev_t *prev = rphub75_bound();
+    esp_err_t result = ESP_OK;
+    for (uint8_t i = 0; i < w->count; i++)
+    {
+        const wall_panel_t *p = &w->panels[i];
+        if (p->lane != lane)
+            continue;
+        rphub75_bind(p->dev);
+        esp_err_t ret = fb_draw_region(w->fb, 0, 0, w->canvas + (size_t)p->y * w->width + p->x, w->width,
+                                       p->w, p->h);
+        if (result == ESP_OK)
+            result = ret;
+    }
+    rphub75_bind(prev);
+    w->lanes[lane].result = result;
+}
+
+static void wall_lane_task(void *param)
+{
+    wall_lane_t *lane = param;
+    wall_t *w = lane->wall;
+    for (;;)
+    {
+        xSemaphoreTake(lane->go, portMAX_DELAY);
+        if (w->stop)
+            break;
+        wall_lane_draw(w, lane->index);
+        xSemaphoreGive(w->done);
+    }
+    xSemaphoreGive(w->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t wall_init(wall_t *w, uint16_t width, uint16_t height)
+{
+    if (w == NULL || width == 0 || height == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(w, 0, sizeof(*w));
+    w->width = width;
+    w->height = height;
+    w->done = xSemaphoreCreateCounting(RP_WALL_MAX_LANES, 0);
+    if (w->done == NULL)
+        return ESP_ERR_NO_MEM;
+    for (uint8_t i = 0; i < RP_WALL_MAX_LANES; i++)
+    {
+        w->lanes[i].wall = w;
+        w->lanes[i].index = i;
+    }
+    return ESP_OK;
+}
+
+void wall_deinit(wall_t *w)
+{
+    if (w == NULL || w->done == NULL)
+        return;
+
+    w->stop = true;
+    for (uint8_t i = 1; i < RP_WALL_MAX_LANES; i++)
+    {
+        wall_lane_t *lane = &w->lanes[i];
+        if (lane->task == NULL)
+            continue;
+        xSemaphoreGive(lane->go);
+        xSemaphoreTake(w->done, portMAX_DELAY);
+        vSemaphoreDelete(lane->go);
+        lane->task = NULL;
+        lane->go = NULL;
+    }
+    vSemaphoreDelete(w->done);
+    w->done = NULL;
+    w->count = 0;
+}
+
+esp_err_t wall_add_panel(wall_t *w, rphub75_dev_t *dev, uint16_t x, uint16_t y,
+                         uint16_t pw, uint16_t ph, uint8_t lane)
+{
+    if (dev == NULL || lane >= RP_WALL_MAX_LANES || pw == 0 || ph == 0 ||
+        (uint32_t)x + pw > w->width || (uint32_t)y + ph > w->height)
+        return ESP_ERR_INVALID_ARG;
+    if (w->count == RP_WALL_MAX_PANELS)
+        return ESP_ERR_NO_MEM;
+
+    wall_lane_t *l = &w->lanes[lane];
+    if (lane > 0 && l->task == NULL)
+    {
+        l->go = xSemaphoreCreateBinary();
+        if (l->go == NULL)
+            return ESP_ERR_NO_MEM;
+        if (xTaskCreatePinnedToCore(wall_lane_task, "rphub75_wall", RP_WALL_TASK_STACK, l,
+                                    RP_WALL_TASK_PRIO, &l->task, tskNO_AFFINITY) != pdPASS)
+        {
+            ESP_LOGE(TAG, "Failed to create lane %u task", (unsigned)lane);
+            vSemaphoreDelete(l->go);
+            l->go = NULL;
+            l->task = NULL;
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    w->panels[w->count++] = (wall_panel_t){
+        .dev = dev,
+        .x = x,
+        .y = y,
+        .w = pw,
+        .h = ph,
+        .lane = lane,
+    };
+    return ESP_OK;
+}
+
+esp_err_t wall_present(wall_t *w, const rpio_rgb_t *canvas, uint8_t fb)
+{
+    if (canvas == NULL || fb >= RP_FB_COUNT)
+        return ESP_ERR_INVALID_ARG;
+
+    w->canvas = canvas;
+    w->fb = fb;
+
+    /* the other lanes run in their tasks while this one sends lane 0 */
+    uint8_t started = 0;
+    for (uint8_t i = 1; i < RP_WALL_MAX_LANES; i++)
+    {
+        if (w->lanes[i].task == NULL)
+            continue;
+        xSemaphoreGive(w->lanes[i].go);
+        started++;
+    }
+    wall_lane_draw(w, 0);
+    while (started-- > 0)
+        xSemaphoreTake(w->done, portMAX_DELAY);
+
+    /* a panel left showing the old frame is better than a torn wall */
+    for (uint8_t i = 0; i < RP_WALL_MAX_LANES; i++)
+    {
+        if (w->lanes[i].result != ESP_OK)
+        {
+            ESP_LOGE(TAG, "wall_present: lane %u failed: %s", (unsigned)i, esp_err_to_name(w->lanes[i].result));
+            return w->lanes[i].result;
+        }
+    }
+
+    /* flips are a few bytes each, sent back to back so the panels change
+     * as close together as the links allow */
+    rphub75_dev_t *prev = rphub75_bound();
+    esp_err_t result = ESP_OK;
+    for (uint8_t i = 0; i < w->count; i++)
+    {
+        rphub75_bind(w->panels[i].dev);
+        esp_err_t ret = display_flip(fb);
+        if (result == ESP_OK)
+            result = ret;
+    }
+    rphub75_bind(prev);
+    return result;
+}
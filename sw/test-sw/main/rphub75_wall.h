@@ -0,0 +1,85 @@
+// rphub75_wall.h
+// Video wall of several RP-HUB75 boards showing one virtual canvas. Every
+// panel shows a region of the canvas. Panels are grouped into lanes, usually
+// one per SPI host: lanes send their regions at the same time, each from its
+// own task, so adding a host's worth of panels does not slow the wall down.
+// Once every region is on its board, all panels flip together.
+//
+//   rphub75_dev_t *right;
+//   rphub75_spi_config_t spi3 = RPHUB75_SPI_CONFIG_DEFAULT();
+//   spi3.host = SPI3_HOST; ...
+//   rphub75_spi_open(&spi3, &right);
+//
+//   wall_t wall;
+//   wall_init(&wall, 128, 64);
+//   wall_add_panel(&wall, rphub75_default_dev(), 0, 0, 64, 64, 0);
+//   wall_add_panel(&wall, right, 64, 0, 64, 64, 1);
+//   wall_present(&wall, canvas, fb);
+
+#ifndef RPHUB75_WALL_H
+#define RPHUB75_WALL_H
+
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "rphub75.h"
+
+#define RP_WALL_MAX_PANELS 8
+#define RP_WALL_MAX_LANES  2   // Lanes beyond the first get a task each
+#define RP_WALL_TASK_PRIO  5
+#define RP_WALL_TASK_STACK 4096
+
+typedef struct
+{
+    rphub75_dev_t *dev;
+    uint16_t x;      // region of the canvas the panel shows
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint8_t lane;
+} wall_panel_t;
+
+typedef struct wall wall_t;
+
+typedef struct
+{
+    wall_t *wall;
+    uint8_t index;
+    TaskHandle_t task;     // NULL for lane 0, which runs on the presenting task
+    SemaphoreHandle_t go;
+    esp_err_t result;      // first failed draw of the last present
+} wall_lane_t;
+
+struct wall
+{
+    uint16_t width;
+    uint16_t height;
+    uint8_t count;
+    wall_panel_t panels[RP_WALL_MAX_PANELS];
+    wall_lane_t lanes[RP_WALL_MAX_LANES];
+    SemaphoreHandle_t done; // given by each lane task after its regions are sent
+
+    /* frame being presented */
+    const rpio_rgb_t *canvas;
+    uint8_t fb;
+    bool stop;
+};
+
+esp_err_t wall_init(wall_t *w, uint16_t width, uint16_t height);
+void wall_deinit(wall_t *w);
+
+// The region must lie inside the canvas. `lane` < RP_WALL_MAX_LANES; put
+// panels on the same SPI host into the same lane.
+esp_err_t wall_add_panel(wall_t *w, rphub75_dev_t *dev, uint16_t x, uint16_t y,
+                         uint16_t pw, uint16_t ph, uint8_t lane);
+
+// Draws every panel's region of `canvas` (width x height, row-major) into
+// framebuffer `fb` of its board, then flips all panels to it. If a draw fails
+// no panel is flipped; the first error, in lane order, is returned.
+esp_err_t wall_present(wall_t *w, const rpio_rgb_t *canvas, uint8_t fb);
+
+#endif // RPHUB75_WALL_H
@@ -0,0 +1,272 @@
+// tilemap.c
+// Tile grid, collision and dirty tile rendering, see tilemap.h
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tilemap.h"
+
+esp_err_t tilemap_init(tilemap_t *map, uint16_t cols, uint16_t rows, uint8_t shift,
+                       const tile_def_t *defs, uint16_t def_count)
+{
+    if (map == NULL || cols == 0 || rows == 0 || shift > 6 || defs == NULL || def_count == 0)
+        return ESP_ERR_INVALID_ARG;
+
+    memset(map, 0, sizeof(*map));
+    map->cols = cols;
+    map->rows = rows;
+    map->shift = shift;
+    map->defs = defs;
+    map->def_count = def_count;
+    map->dirty_words = (uint16_t)((cols + 31) / 32);
+    map->tiles = calloc((size_t)cols * rows, 1);
+    map->dirty = calloc((size_t)map->dirty_words * rows, sizeof(uint32_t));
+    if (map->tiles == NULL || map->dirty == NULL)
+    {
+        tilemap_deinit(map);
+        return ESP_ERR_NO_MEM;
+    }
+    tilemap_mark_all(map);
+    return ESP_OK;
+}
+
+void tilemap_deinit(tilemap_t *map)
+{
+    free(map->tiles);
+    free(map->dirty);
+    map->tiles = NULL;
+    map->dirty = NULL;
+}
+
+static inline void mark_tile(tilemap_t *map, int col, int row)
+{
+    map->dirty[row * map->dirty_words + col / 32] |= 1u << (col % 32);
+}
+
+static inline bool tile_dirty(const tilemap_t *map, int col, int row)
+{
+    return (map->dirty[row * map->dirty_words + col / 32] >> (col % 32)) & 1u;
+}
+
+uint8_t tilemap_get(const tilemap_t *map, int col, int row)
+{
+    if (col < 0 || row < 0 || col >= map->cols || row >= map->rows)
+        return 0;
+    return map->tiles[row * map->cols + col];
+}
+
+void tilemap_set(tilemap_t *map, int col, int row, uint8_t id)
+{
+    if (col < 0 || row < 0 || col >= map->cols || row >= map->rows || id >= map->def_count)
+        return;
+    map->tiles[row * map->cols + col] = id;
+    mark_tile(map, col, row);
+}
+
+/* Tiles touched by a pixel rectangle, clipped to the map. False when none. */
+static bool tile_range(const tilemap_t *map, int x, int y, int w, int h,
+                       int *c0, int *r0, int *c1, int *r1)
+{
+    if (w <= 0 || h <= 0)
+        return false;
+    *c0 = x >> map->shift;
+    *r0 = y >> map->shift;
+    *c1 = (x + w - 1) >> map->shift;
+    *r1 = (y + h - 1) >> map->shift;
+    if (*c0 < 0)
+        *c0 = 0;
+    if (*r0 < 0)
+        *r0 = 0;
+    if (*c1 >= map->cols)
+        *c1 = map->cols - 1;
+    if (*r1 >= map->rows)
+        *r1 = map->rows - 1;
+    return *c0 <= *c1 && *r0 <= *r1;
+}
+
+void tilemap_fill(tilemap_t *map, int x, int y, int w, int h, uint8_t id)
+{
+    int c0, r0, c1, r1;
+    if (!tile_range(map, x, y, w, h, &c0, &r0, &c1, &r1))
+        return;
+    for (int row = r0; row <= r1; row++)
+    {
+        for (int col = c0; col <= c1; col++)
+            tilemap_set(map, col, row, id);
+    }
+}
+
+static inline uint8_t tile_flags(const tilemap_t *map, int col, int row)
+{
+    return map->defs[tilemap_get(map, col, row)].flags;
+}
+
+bool tilemap_overlaps(const tilemap_t *map, int x, int y, int w, int h, uint8_t flags)
+{
+    int c0, r0, c1, r1;
+    if (!tile_range(map, x, y, w, h, &c0, &r0, &c1, &r1))
+        return false;
+    for (int row = r0; row <= r1; row++)
+    {
+        for (int col = c0; col <= c1; col++)
+        {
+            if (tile_flags(map, col, row) & flags)
+                return true;
+        }
+    }
+    return false;
+}
+
+/* The first column from `from` to `to` in direction `step` holding a tile
+ * with `flags` in rows [r0, r1], or INT32_MIN. None when `to` is behind. */
+static int32_t first_col(const tilemap_t *map, int from, int to, int step, int r0, int r1, uint8_t flags)
+{
+    for (int col = from; step > 0 ? col <= to : col >= to; col += step)
+    {
+        for (int row = r0; row <= r1; row++)
+        {
+            if (tile_flags(map, col, row) & flags)
+                return col;
+        }
+    }
+    return INT32_MIN;
+}
+
+static int32_t first_row(const tilemap_t *map, int from, int to, int step, int c0, int c1, uint8_t flags)
+{
+    for (int row = from; step > 0 ? row <= to : row >= to; row += step)
+    {
+        for (int col = c0; col <= c1; col++)
+        {
+            if (tile_flags(map, col, row) & flags)
+                return row;
+        }
+    }
+    return INT32_MIN;
+}
+
+/* The body covers pixels [x, x + w) in continuous coordinates: the last
+ * pixel column it touches is the one just before its right edge. */
+static inline int first_px(fix16_t v)
+{
+    return fix16_to_int(v);
+}
+
+static inline int last_px(fix16_t v, int16_t size)
+{
+    return fix16_to_int(v + fix16_from_int(size) - 1);
+}
+
+uint8_t tilemap_move(const tilemap_t *map, tilemap_body_t *body, fix16_t dx, fix16_t dy)
+{
+    uint8_t hit = 0;
+    int s = map->shift;
+
+    /* one-way tiles never block sideways */
+    if (dx != 0)
+    {
+        int r0 = first_px(body->y) >> s;
+        int r1 = last_px(body->y, body->h) >> s;
+        fix16_t x = body->x + dx;
+        if (dx > 0)
+        {
+            int32_t col = first_col(map, (last_px(body->x, body->w) >> s) + 1, last_px(x, body->w) >> s, 1,
+                                    r0, r1, TILE_SOLID);
+            if (col != INT32_MIN)
+            {
+                x = fix16_from_int((col << s) - body->w);
+                hit |= TILEMAP_HIT_RIGHT;
+            }
+        }
+        else
+        {
+            int32_t col = first_col(map, (first_px(body->x) >> s) - 1, first_px(x) >> s, -1,
+                                    r0, r1, TILE_SOLID);
+            if (col != INT32_MIN)
+            {
+                x = fix16_from_int((col + 1) << s);
+                hit |= TILEMAP_HIT_LEFT;
+            }
+        }
+        body->x = x;
+    }
+
+    int c0 = first_px(body->x) >> s;
+    int c1 = last_px(body->x, body->w) >> s;
+    fix16_t y = body->y + dy;
+    if (dy >= 0)
+    {
+        /* the row the bottom edge ends up on counts even when the edge only
+         * touches it, so a resting body keeps hitting the floor under it;
+         * every row searched starts at or below the old bottom edge, which
+         * is what lets one-way tiles catch a falling body */
+        int32_t row = first_row(map, (last_px(body->y, body->h) >> s) + 1,
+                                fix16_to_int(y + fix16_from_int(body->h)) >> s, 1,
+                                c0, c1, TILE_SOLID | TILE_ONE_WAY);
+        if (row != INT32_MIN)
+        {
+            y = fix16_from_int((row << s) - body->h);
+            hit |= TILEMAP_HIT_BOTTOM;
+        }
+    }
+    else
+    {
+        int32_t row = first_row(map, (first_px(body->y) >> s) - 1, first_px(y) >> s, -1, c0, c1, TILE_SOLID);
+        if (row != INT32_MIN)
+        {
+            y = fix16_from_int((row + 1) << s);
+            hit |= TILEMAP_HIT_TOP;
+        }
+    }
+    body->y = y;
+    return hit;
+}
+
+void tilemap_mark(tilemap_t *map, int x, int y, int w, int h)
+{
+    int c0, r0, c1, r1;
+    if (!tile_range(map, x, y, w, h, &c0, &r0, &c1, &r1))
+        return;
+    for (int row = r0; row <= r1; row++)
+    {
+        for (int col = c0; col <= c1; col++)
+            mark_tile(map, col, row);
+    }
+}
+
+void tilemap_mark_all(tilemap_t *map)
+{
+    tilemap_mark(map, 0, 0, map->cols << map->shift, map->rows << map->shift);
+}
+
+void tilemap_clear_dirty(tilemap_t *map)
+{
+    memset(map->dirty, 0, (size_t)map->dirty_words * map->rows * sizeof(uint32_t));
+}
+
+int tilemap_render(const tilemap_t *map, raster_t *r, int x0, int y0, bool dirty_only)
+{
+    int c0, r0, c1, r1;
+    if (!tile_range(map, x0, y0, r->width, r->height, &c0, &r0, &c1, &r1))
+        return 0;
+
+    int size = 1 << map->shift;
+    int drawn = 0;
+    for (int row = r0; row <= r1; row++)
+    {
+        for (int col = c0; col <= c1; col++)
+        {
+            if (dirty_only && !tile_dirty(map, col, row))
+                continue;
+            const tile_def_t *def = &map->defs[map->tiles[row * map->cols + col]];
+            int x = (col << map->shift) - x0;
+            int y = (row << map->shift) - y0;
+            if (def->pixels != NULL)
+                raster_blit(r, x, y, def->pixels, size, size, size);
+            else
+                raster_fill_rect(r, x, y, size, size, def->color);
+            drawn++;
+        }
+    }
+    return drawn;
+}
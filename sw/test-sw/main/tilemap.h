@@ -0,0 +1,131 @@
+// tilemap.h
+// Tile maps for the games: a grid of square tiles that is at the same time
+// the level's collision index and its background. A collision query or a move
+// only looks at the tiles under and in front of a body, and rendering can be
+// limited to the tiles something moved over since the last frame, so the
+// cost of a frame does not grow with the size of the level.
+//
+// Positions and speeds are Q16.16 fixed point (fix16_t), so the physics is
+// the same on every target and does not need the FPU.
+//
+//   static const tile_def_t defs[] = {
+//       {0, NULL, {0, 0, 0}},
+//       {TILE_ONE_WAY, NULL, {128, 128, 128}},
+//   };
+//   tilemap_t map;
+//   tilemap_init(&map, 256 / 4, 64 / 4, 2, defs, 2);   // 4x4 pixel tiles
+//   tilemap_fill(&map, 0, 56, 256, 8, 1);
+//   ...
+//   tilemap_body_t body = {.x = FIX16(10), .y = FIX16(20), .w = 8, .h = 8};
+//   uint8_t hit = tilemap_move(&map, &body, dx, dy);
+//   ...
+//   tilemap_mark(&map, old_x, old_y, 8, 8);              // what moved
+//   tilemap_render(&map, &frame, 0, 0, true);
+//   tilemap_clear_dirty(&map);
+
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <rpio.h>
+#include <esp_err.h>
+
+#include "raster.h"
+
+typedef int32_t fix16_t;
+
+#define FIX16_ONE (1 << 16)
+#define FIX16(v)  ((fix16_t)((v) * 65536.0f + ((v) < 0 ? -0.5f : 0.5f))) // for constants
+
+static inline fix16_t fix16_from_int(int v)
+{
+    return (fix16_t)((uint32_t)v << 16);
+}
+
+// Rounds towards minus infinity.
+static inline int fix16_to_int(fix16_t v)
+{
+    return v >> 16;
+}
+
+static inline fix16_t fix16_from_float(float v)
+{
+    return FIX16(v);
+}
+
+static inline fix16_t fix16_mul(fix16_t a, fix16_t b)
+{
+    return (fix16_t)(((int64_t)a * b) >> 16);
+}
+
+// Tile flags
+#define TILE_SOLID   0x01 // blocks bodies from every side
+#define TILE_ONE_WAY 0x02 // only stops bodies falling onto it from above
+
+typedef struct
+{
+    uint8_t flags;
+    const rpio_rgb_t *pixels; // size x size image, NULL to fill with `color`
+    rpio_rgb_t color;
+} tile_def_t;
+
+typedef struct
+{
+    uint8_t *tiles;           // row-major tile ids
+    uint32_t *dirty;          // one bit per tile
+    uint16_t cols;
+    uint16_t rows;
+    uint16_t dirty_words;     // per row of tiles
+    uint8_t shift;            // tiles are 1 << shift pixels square
+    const tile_def_t *defs;
+    uint16_t def_count;
+} tilemap_t;
+
+// A cols x rows map of empty tiles (id 0), all of them dirty. `defs` must
+// outlive the map.
+esp_err_t tilemap_init(tilemap_t *map, uint16_t cols, uint16_t rows, uint8_t shift,
+                       const tile_def_t *defs, uint16_t def_count);
+void tilemap_deinit(tilemap_t *map);
+
+// 0 outside the map.
+uint8_t tilemap_get(const tilemap_t *map, int col, int row);
+void tilemap_set(tilemap_t *map, int col, int row, uint8_t id);
+// Sets every tile the pixel rectangle touches.
+void tilemap_fill(tilemap_t *map, int x, int y, int w, int h, uint8_t id);
+
+// True when a tile with any of `flags` overlaps the pixel rectangle.
+bool tilemap_overlaps(const tilemap_t *map, int x, int y, int w, int h, uint8_t flags);
+
+typedef struct
+{
+    fix16_t x;  // top left corner
+    fix16_t y;
+    int16_t w;  // pixels
+    int16_t h;
+} tilemap_body_t;
+
+#define TILEMAP_HIT_LEFT   0x01
+#define TILEMAP_HIT_RIGHT  0x02
+#define TILEMAP_HIT_TOP    0x04
+#define TILEMAP_HIT_BOTTOM 0x08
+
+// Moves `body` by dx, then by dy, stopping it against the first blocking
+// column or row of tiles in its way, and returns the TILEMAP_HIT_* sides that
+// were stopped. The tiles crossed are all checked, so fast bodies do not
+// tunnel. With dy >= 0 a body resting on a tile also counts as hitting it.
+uint8_t tilemap_move(const tilemap_t *map, tilemap_body_t *body, fix16_t dx, fix16_t dy);
+
+// Marks the tiles under a pixel rectangle to be drawn again.
+void tilemap_mark(tilemap_t *map, int x, int y, int w, int h);
+void tilemap_mark_all(tilemap_t *map);
+void tilemap_clear_dirty(tilemap_t *map);
+
+// Draws the tiles that fall into `r`, whose top left pixel is map pixel
+// (x0, y0) - a camera position, or the first row of a band. With `dirty_only`
+// only tiles marked since the last tilemap_clear_dirty are drawn. Returns the
+// number of tiles drawn. Does not change the map, so bands of one frame can
+// be drawn from several tasks.
+int tilemap_render(const tilemap_t *map, raster_t *r, int x0, int y0, bool dirty_only);
+
+#endif // TILEMAP_H